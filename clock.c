@@ -0,0 +1,121 @@
+//*****************************************************************************
+//
+// clock.c - System clock configuration and derived timing constants
+//
+//*****************************************************************************
+
+#include <inttypes.h>
+
+#include "inc/hw_nvic.h"
+#include "inc/hw_types.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/rom.h"
+#include "driverlib/sysctl.h"
+
+#include "FreeRTOS.h"
+
+#include "console.h"
+#include "stepper.h"
+#include "shell_task.h"
+#include "clock.h"
+
+#ifndef CLOCK_XTAL
+#define CLOCK_XTAL              SYSCTL_XTAL_16MHZ
+#endif
+
+typedef struct {
+    const char   *name;
+    unsigned long config;       // for SysCtlClockSet()
+} clock_profile_info_t;
+
+static const clock_profile_info_t g_clock_profiles[CLOCK_PROFILE_MAX] =
+{
+    { "run", SYSCTL_SYSDIV_3 | SYSCTL_USE_PLL | CLOCK_XTAL | SYSCTL_OSC_MAIN },
+    { "low", SYSCTL_SYSDIV_1 | SYSCTL_USE_OSC | CLOCK_XTAL | SYSCTL_OSC_MAIN },
+};
+
+clock_info_t g_clock;
+
+static void clock_apply(uint8_t profile)
+{
+    ROM_SysCtlClockSet(g_clock_profiles[profile].config);
+
+    // decode RCC once here, everyone else reads g_clock
+    g_clock.hz = ROM_SysCtlClockGet();
+    g_clock.hz_f = (float)g_clock.hz;
+    g_clock.inv_hz_f = 1.0f / g_clock.hz_f;
+    g_clock.per_us = g_clock.hz / 1000000;
+    g_clock.per_ms = g_clock.hz / 1000;
+    g_clock.profile = profile;
+}
+
+void clock_init(void)
+{
+    clock_apply(CLOCK_RUN);
+}
+
+// configCPU_CLOCK_HZ, read by the port when it starts the SysTick
+unsigned long clock_hz(void)
+{
+    return(g_clock.hz);
+}
+
+int8_t clock_set(uint8_t profile)
+{
+    uint32_t old_hz = g_clock.hz;
+    tBoolean masked;
+
+    if (profile >= CLOCK_PROFILE_MAX)
+    {
+        return(-1);
+    }
+
+    if (profile == g_clock.profile)
+    {
+        return(0);
+    }
+
+    // let the byte on the wire finish at the old baud rate, the rest of the
+    // ring waits for the new one
+    console_tx_hold();
+
+    masked = ROM_IntMasterDisable();
+
+    // nothing refilled the FIFO since, this only re-checks it is idle
+    console_tx_hold();
+
+    clock_apply(profile);
+
+    // keep the tick rate, the current tick restarts
+    HWREG(NVIC_ST_RELOAD) = (g_clock.hz / configTICK_RATE_HZ) - 1;
+    HWREG(NVIC_ST_CURRENT) = 0;
+
+    console_reclock();
+    console_tx_release();
+    stepper_reclock(old_hz);
+
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+
+    return(0);
+}
+
+//*****************************************************************************
+//
+// Shell commands.
+//
+//*****************************************************************************
+static void clock_cmd(const shell_arg_t *arg)
+{
+    if (clock_set(arg[0].i) != 0)
+    {
+        console_printf("clk: no profile %i\n", arg[0].i);
+        return;
+    }
+
+    console_printf("clk: %s, %u Hz\n", g_clock_profiles[g_clock.profile].name, g_clock.hz);
+}
+
+SHELL_COMMAND(clk, "clk", "i", "<0 run|1 low> (system clock profile)", clock_cmd);
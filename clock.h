@@ -0,0 +1,45 @@
+//*****************************************************************************
+//
+// clock.h - System clock configuration and derived timing constants
+//
+// The clock module is the only place that sets the system clock. g_clock
+// holds the frequency plus the constants derived from it, so the step ISRs
+// read a float instead of decoding RCC through ROM_SysCtlClockGet() every
+// step. clock_set() switches profile at run time and rescales the SysTick,
+// the console baud rate and the step timers so motion keeps its speed.
+//
+//*****************************************************************************
+
+#ifndef __CLOCK_H__
+#define __CLOCK_H__
+
+typedef enum
+{
+  CLOCK_RUN,            // 66.67 MHz from the PLL
+  CLOCK_LOW,            // straight from the 16 MHz crystal, PLL off
+  CLOCK_PROFILE_MAX
+} clock_profile_t;
+
+typedef struct
+{
+  uint32_t hz;
+  float    hz_f;        // hz as a float
+  float    inv_hz_f;    // seconds per cycle
+  uint32_t per_us;      // cycles per microsecond
+  uint32_t per_ms;      // cycles per millisecond
+  uint8_t  profile;
+} clock_info_t;
+
+// read only outside clock.c
+extern clock_info_t g_clock;
+
+//*****************************************************************************
+//
+// Prototypes for the CLOCK
+//
+//*****************************************************************************
+void clock_init(void);
+int8_t clock_set(uint8_t profile);
+unsigned long clock_hz(void);
+
+#endif // __CLOCK_H__
@@ -0,0 +1,577 @@
+//*****************************************************************************
+//
+// console.c - Interrupt driven, ring buffered UART0 console
+//
+// Output is copied into a TX ring and drained by the UART TX interrupt, so
+// printing no longer busy-waits on the 16 byte hardware FIFO. The same ISR
+// hands received characters to the registered RX handler (the shell).
+//
+//*****************************************************************************
+
+#include <string.h>
+
+#include <inttypes.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "inc/hw_ints.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+#include "driverlib/gpio.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/pin_map.h"
+#include "driverlib/rom.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/uart.h"
+#include "console.h"
+#include "numio.h"
+#include "cpuload.h"
+#include "shell_task.h"
+#include "clock.h"
+
+//*****************************************************************************
+//
+// TX ring size (power of 2) and the printf staging buffer size.
+//
+//*****************************************************************************
+#ifndef CONSOLE_TX_BUFFER_SIZE
+#define CONSOLE_TX_BUFFER_SIZE  1024
+#endif
+
+#define CONSOLE_PRINTF_BUFSIZE  64
+
+//*****************************************************************************
+//
+// The UART interrupt must be maskable by the kernel, see console_write().
+//
+//*****************************************************************************
+#define CONSOLE_INT_PRIORITY    (6 << 5)
+
+typedef struct {
+    volatile uint32_t head;             // next byte to write
+    volatile uint32_t tail;             // next byte to send
+    uint32_t          tx_bytes;         // bytes queued
+    uint32_t          tx_dropped;       // bytes lost to a full ring
+    uint32_t          tx_waits;         // writers that had to wait for room
+    uint32_t          tx_peak;          // ring high-water mark
+    uint32_t          rx_overruns;      // hardware RX FIFO overruns
+    volatile uint8_t  tx_hold;          // ring is not fed to the FIFO, see console_tx_hold()
+    unsigned long     baud;
+    console_rx_handler_t rx_handler;
+    char              tx[CONSOLE_TX_BUFFER_SIZE];
+} console_t;
+
+static console_t g_console;
+
+#define TX_USED()   (g_console.head - g_console.tail)
+#define TX_FREE()   (CONSOLE_TX_BUFFER_SIZE - TX_USED())
+
+// move bytes from the ring into the hardware FIFO, caller holds the lock
+static void console_prime(void)
+{
+    if (g_console.tx_hold)
+    {
+        ROM_UARTIntDisable(UART0_BASE, UART_INT_TX);
+        return;
+    }
+
+    while ((g_console.tail != g_console.head)
+        && ROM_UARTSpaceAvail(UART0_BASE))
+    {
+        ROM_UARTCharPutNonBlocking(UART0_BASE, g_console.tx[g_console.tail & (CONSOLE_TX_BUFFER_SIZE - 1)]);
+        g_console.tail++;
+    }
+
+    if (g_console.tail == g_console.head)
+    {
+        ROM_UARTIntDisable(UART0_BASE, UART_INT_TX);
+    }
+    else
+    {
+        ROM_UARTIntEnable(UART0_BASE, UART_INT_TX);
+    }
+}
+
+// queue one byte, caller holds the lock and checked for room
+static inline void console_put(char chr)
+{
+    g_console.tx[g_console.head & (CONSOLE_TX_BUFFER_SIZE - 1)] = chr;
+    g_console.head++;
+    g_console.tx_bytes++;
+}
+
+// queue bytes, text gets '\n' => "\r\n", returns the number of source bytes taken
+static unsigned long console_put_buf(const char *buf, unsigned long len, uint8_t raw)
+{
+    unsigned long i;
+
+    for (i=0; i<len; i++)
+    {
+        uint8_t crlf = (!raw && (buf[i] == '\n'));
+
+        if (TX_FREE() < (crlf ? 2 : 1))
+        {
+            break;
+        }
+
+        if (crlf)
+        {
+            console_put('\r');
+        }
+
+        console_put(buf[i]);
+    }
+
+    if (TX_USED() > g_console.tx_peak)
+    {
+        g_console.tx_peak = TX_USED();
+    }
+
+    return(i);
+}
+
+//*****************************************************************************
+//
+// The UART interrupt handler.
+//
+//*****************************************************************************
+void
+UARTIntHandler(void)
+{
+    unsigned long ulStatus;
+    unsigned long mask;
+
+    CPULOAD_ISR_ENTER(CPULOAD_ISR_UART);
+
+    //
+    // Get and clear the interrupt status.
+    //
+    ulStatus = ROM_UARTIntStatus(UART0_BASE, true);
+    ROM_UARTIntClear(UART0_BASE, ulStatus);
+
+    if (ulStatus & UART_INT_OE)
+    {
+        g_console.rx_overruns++;
+    }
+
+    //
+    // Hand received characters to the RX handler, it may echo.
+    //
+    while(ROM_UARTCharsAvail(UART0_BASE))
+    {
+        char chr = ROM_UARTCharGetNonBlocking(UART0_BASE);
+
+        if (g_console.rx_handler != NULL)
+        {
+            g_console.rx_handler(chr);
+        }
+    }
+
+    //
+    // Refill the TX FIFO.
+    //
+    mask = portSET_INTERRUPT_MASK_FROM_ISR();
+    console_prime();
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+
+    CPULOAD_ISR_EXIT(CPULOAD_ISR_UART);
+}
+
+void console_init(unsigned long baud)
+{
+    //
+    // Set GPIO A0 and A1 as UART pins.
+    //
+    ROM_SysCtlPeripheralEnable(SYSCTL_PERIPH_UART0);
+    ROM_SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOA);
+#ifdef GPIO_PA0_U0RX
+    // parts without a pin mux (e.g. the QEMU LM3S6965) have them fixed
+    GPIOPinConfigure(GPIO_PA0_U0RX);
+    GPIOPinConfigure(GPIO_PA1_U0TX);
+#endif
+    ROM_GPIOPinTypeUART(GPIO_PORTA_BASE, GPIO_PIN_0 | GPIO_PIN_1);
+
+    //
+    // Configure the UART for baud, 8-N-1 operation.
+    //
+    g_console.baud = baud;
+    console_reclock();
+
+    //
+    // TX interrupt when the FIFO runs low, RX on half full or timeout.
+    //
+    ROM_UARTFIFOLevelSet(UART0_BASE, UART_FIFO_TX1_8, UART_FIFO_RX4_8);
+    ROM_UARTFIFOEnable(UART0_BASE);
+
+    //
+    // Enable the UART interrupt.
+    //
+    ROM_IntPrioritySet(INT_UART0, CONSOLE_INT_PRIORITY);
+    ROM_IntEnable(INT_UART0);
+    ROM_UARTIntEnable(UART0_BASE, UART_INT_RX | UART_INT_RT | UART_INT_OE);
+}
+
+// (re)derive the baud rate divisors from the system clock
+void console_reclock(void)
+{
+    ROM_UARTConfigSetExpClk(UART0_BASE, g_clock.hz, g_console.baud,
+                            (UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE |
+                             UART_CONFIG_PAR_NONE));
+}
+
+//*****************************************************************************
+//
+// Stop feeding the hardware FIFO and wait until the byte on the wire is out,
+// so the baud rate can change. Writers keep queueing into the ring meanwhile,
+// console_tx_release() sends that at the new rate. Waits for at most a FIFO
+// full, however fast the ring is refilled.
+//
+//*****************************************************************************
+void console_tx_hold(void)
+{
+    unsigned long mask;
+
+    mask = portSET_INTERRUPT_MASK_FROM_ISR();
+    g_console.tx_hold = 1;
+    ROM_UARTIntDisable(UART0_BASE, UART_INT_TX);
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+
+    while (ROM_UARTBusy(UART0_BASE))
+    {
+    }
+}
+
+// feed the FIFO again, from what queued up while held
+void console_tx_release(void)
+{
+    unsigned long mask;
+
+    mask = portSET_INTERRUPT_MASK_FROM_ISR();
+    g_console.tx_hold = 0;
+    console_prime();
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+}
+
+// returns the handler it replaces
+console_rx_handler_t console_set_rx_handler(console_rx_handler_t handler)
+{
+    console_rx_handler_t previous = g_console.rx_handler;
+
+    g_console.rx_handler = handler;
+
+    return(previous);
+}
+
+//*****************************************************************************
+//
+// Queue output from task context. The ring is guarded by masking the
+// kernel-level interrupts (the UART included), so the step timers keep
+// running; never call this from an interrupt above
+// configMAX_SYSCALL_INTERRUPT_PRIORITY.
+//
+//*****************************************************************************
+static int console_write_buf(const char *buf, unsigned long len, uint8_t raw)
+{
+    unsigned long done = 0;
+    unsigned long mask;
+
+    while (1)
+    {
+        mask = portSET_INTERRUPT_MASK_FROM_ISR();
+        done += console_put_buf(buf + done, len - done, raw);
+        console_prime();
+        portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+
+        if (done == len)
+        {
+            break;
+        }
+
+#if CONSOLE_TX_POLICY == CONSOLE_TX_BLOCK
+        g_console.tx_waits++;
+
+        if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+        {
+            vTaskDelay(1);
+        }
+        else
+        {
+            // no scheduler (or interrupts off) yet, drain by polling
+            while (!ROM_UARTSpaceAvail(UART0_BASE))
+            {
+            }
+
+            mask = portSET_INTERRUPT_MASK_FROM_ISR();
+            console_prime();
+            portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+        }
+#else
+        g_console.tx_dropped += len - done;
+        break;
+#endif
+    }
+
+    return(done);
+}
+
+// text output
+int console_write(const char *buf, unsigned long len)
+{
+    return(console_write_buf(buf, len, 0));
+}
+
+// binary output, no newline translation
+int console_write_raw(const char *buf, unsigned long len)
+{
+    return(console_write_buf(buf, len, 1));
+}
+
+// room left in the TX ring, lets periodic writers skip instead of waiting
+unsigned long console_tx_free(void)
+{
+    return(TX_FREE());
+}
+
+//*****************************************************************************
+//
+// Queue one character from the UART ISR (echo), never waits.
+//
+//*****************************************************************************
+void console_putc_isr(char chr)
+{
+    unsigned long mask;
+
+    mask = portSET_INTERRUPT_MASK_FROM_ISR();
+    if (console_put_buf(&chr, 1, 0) == 0)
+    {
+        g_console.tx_dropped++;
+    }
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+}
+
+//*****************************************************************************
+//
+// A small printf: %c %d %i %f %p %s %u %x %X %%, with optional '+', '0' and
+// (%s only) '-' flags, field width and (%f only) precision, formatted through
+// a stack buffer. %f defaults to 4 decimals and never touches double
+// arithmetic beyond the float-to-double promotion of the argument.
+//
+//*****************************************************************************
+typedef struct {
+    char          buf[CONSOLE_PRINTF_BUFSIZE];
+    unsigned long len;
+} console_fmt_t;
+
+static void console_fmt_putc(console_fmt_t *out, char chr)
+{
+    if (out->len == sizeof(out->buf))
+    {
+        console_write(out->buf, out->len);
+        out->len = 0;
+    }
+
+    out->buf[out->len++] = chr;
+}
+
+static void console_fmt_num(console_fmt_t *out, uint32_t value, uint8_t base,
+                            uint8_t neg, uint8_t width, char pad, uint8_t upper)
+{
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char tmp[11];
+    uint8_t n = 0;
+
+    do
+    {
+        tmp[n++] = digits[value % base];
+        value /= base;
+    } while (value != 0);
+
+    if (neg)
+    {
+        if (pad == '0')
+        {
+            console_fmt_putc(out, '-');
+
+            if (width != 0)
+            {
+                width--;
+            }
+        }
+        else
+        {
+            tmp[n++] = '-';
+        }
+    }
+
+    while (width > n)
+    {
+        console_fmt_putc(out, pad);
+        width--;
+    }
+
+    while (n != 0)
+    {
+        console_fmt_putc(out, tmp[--n]);
+    }
+}
+
+void console_vprintf(const char *fmt, va_list args)
+{
+    console_fmt_t out;
+    char num[NUMIO_BUFSIZE];
+    const char *str;
+    uint8_t width, precision, flags, left;
+    int32_t value;
+    char pad;
+
+    out.len = 0;
+
+    while (*fmt != '\0')
+    {
+        if (*fmt != '%')
+        {
+            console_fmt_putc(&out, *fmt++);
+            continue;
+        }
+
+        fmt++;
+        pad = ' ';
+        width = 0;
+        precision = 4;
+        flags = 0;
+        left = 0;
+
+        if (*fmt == '-')
+        {
+            left = 1;
+            fmt++;
+        }
+
+        if (*fmt == '+')
+        {
+            flags |= NUMIO_PLUS;
+            fmt++;
+        }
+
+        if (*fmt == '0')
+        {
+            pad = '0';
+            fmt++;
+        }
+
+        while ((*fmt >= '0') && (*fmt <= '9'))
+        {
+            width = (width * 10) + (*fmt++ - '0');
+        }
+
+        if (*fmt == '.')
+        {
+            for (precision = 0, fmt++; (*fmt >= '0') && (*fmt <= '9'); fmt++)
+            {
+                precision = (precision * 10) + (*fmt - '0');
+            }
+        }
+
+        switch (*fmt)
+        {
+            case 'c':
+                console_fmt_putc(&out, (char)va_arg(args, int));
+                break;
+
+            case 'd':
+            case 'i':
+                value = va_arg(args, int32_t);
+                console_fmt_num(&out, (value < 0) ? (0 - (uint32_t)value) : (uint32_t)value,
+                                10, value < 0, width, pad, 0);
+                break;
+
+            case 'u':
+                console_fmt_num(&out, va_arg(args, uint32_t), 10, 0, width, pad, 0);
+                break;
+
+            case 'f':
+                value = numio_ftoa(num, (float)va_arg(args, double), precision, flags);
+                str = num;
+                if ((pad == '0') && ((*str == '-') || (*str == '+')))
+                {
+                    console_fmt_putc(&out, *str++);
+                    width = (width != 0) ? (width - 1) : 0;
+                    value--;
+                }
+                for ( ; width > value; width--)
+                {
+                    console_fmt_putc(&out, pad);
+                }
+                while (*str != '\0')
+                {
+                    console_fmt_putc(&out, *str++);
+                }
+                break;
+
+            case 'p':
+            case 'x':
+            case 'X':
+                console_fmt_num(&out, va_arg(args, uint32_t), 16, 0, width, pad, *fmt == 'X');
+                break;
+
+            case 's':
+                str = va_arg(args, const char *);
+                value = strlen(str);
+                for ( ; !left && (width > value); width--)
+                {
+                    console_fmt_putc(&out, ' ');
+                }
+                while (*str != '\0')
+                {
+                    console_fmt_putc(&out, *str++);
+                }
+                for ( ; width > value; width--)
+                {
+                    console_fmt_putc(&out, ' ');
+                }
+                break;
+
+            case '%':
+                console_fmt_putc(&out, '%');
+                break;
+
+            case '\0':
+                continue;
+
+            default:
+                console_fmt_putc(&out, '?');
+                break;
+        }
+
+        fmt++;
+    }
+
+    if (out.len != 0)
+    {
+        console_write(out.buf, out.len);
+    }
+}
+
+void console_printf(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    console_vprintf(fmt, args);
+    va_end(args);
+}
+
+void console_status(void)
+{
+    console_printf("console_status: tx_bytes %u, tx_dropped %u, tx_waits %u, tx_peak %u/%u, rx_overruns %u\n",
+                   g_console.tx_bytes, g_console.tx_dropped, g_console.tx_waits,
+                   g_console.tx_peak, CONSOLE_TX_BUFFER_SIZE, g_console.rx_overruns);
+}
+
+static void console_cmd_status(const shell_arg_t *arg)
+{
+    console_status();
+}
+
+SHELL_COMMAND(cst, "cst", "", "(console status)", console_cmd_status);
@@ -0,0 +1,46 @@
+//*****************************************************************************
+//
+// console.h - Prototypes for the buffered UART console
+//
+//*****************************************************************************
+
+#ifndef __CONSOLE_H__
+#define __CONSOLE_H__
+
+#include <stdarg.h>
+
+//*****************************************************************************
+//
+// What console_write() does when the TX ring is full: drop the bytes that
+// do not fit, or wait for the TX interrupt to make room (task context only,
+// interrupts always drop).
+//
+//*****************************************************************************
+#define CONSOLE_TX_DROP         0
+#define CONSOLE_TX_BLOCK        1
+
+#ifndef CONSOLE_TX_POLICY
+#define CONSOLE_TX_POLICY       CONSOLE_TX_BLOCK
+#endif
+
+typedef void (*console_rx_handler_t)(char chr);
+
+//*****************************************************************************
+//
+// Prototypes for the CONSOLE
+//
+//*****************************************************************************
+void console_init(unsigned long baud);
+void console_reclock(void);
+void console_tx_hold(void);
+void console_tx_release(void);
+console_rx_handler_t console_set_rx_handler(console_rx_handler_t handler);
+int console_write(const char *buf, unsigned long len);
+int console_write_raw(const char *buf, unsigned long len);
+unsigned long console_tx_free(void);
+void console_putc_isr(char chr);
+void console_printf(const char *fmt, ...);
+void console_vprintf(const char *fmt, va_list args);
+void console_status(void);
+
+#endif // __CONSOLE_H__
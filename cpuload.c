@@ -0,0 +1,320 @@
+//*****************************************************************************
+//
+// cpuload.c - Per-task and per-ISR CPU time accounting
+//
+//*****************************************************************************
+
+#include <string.h>
+
+#include <inttypes.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "inc/hw_types.h"
+#include "driverlib/rom.h"
+#include "driverlib/sysctl.h"
+#include "console.h"
+#include "shell_task.h"
+#include "cpuload.h"
+#include "clock.h"
+#include "event.h"
+
+//*****************************************************************************
+//
+// DWT cycle counter.
+//
+//*****************************************************************************
+#define DEMCR                   0xE000EDFC
+#define DEMCR_TRCENA            0x01000000
+#define DWT_CTRL                0xE0001000
+#define DWT_CTRL_CYCCNTENA      0x00000001
+#define DWT_CYCCNT              0xE0001004
+
+#define CPULOAD_NONE            0xff
+#define CPULOAD_MAX_NESTING     4
+
+typedef struct {
+    void       *task;               // task handle (TCB)
+    const char *name;
+    uint32_t    cycles;
+} cpuload_task_t;
+
+typedef struct {
+    uint32_t    cycles;
+    uint32_t    count;
+    uint32_t    max;                // longest single run, cycles
+    uint32_t    entry;
+} cpuload_irq_t;
+
+typedef struct {
+    cpuload_task_t tasks[CPULOAD_MAX_TASKS];
+    cpuload_irq_t  isrs[CPULOAD_ISR_MAX];
+    uint8_t        ntasks;
+    uint8_t        current;         // running task, index into tasks
+    uint8_t        stack[CPULOAD_MAX_NESTING];
+    uint8_t        depth;           // nested instrumented ISRs
+    uint32_t       mark;            // CYCCNT at the last charge
+} cpuload_t;
+
+static cpuload_t g_cpuload;
+
+static const char * const g_isr_name[CPULOAD_ISR_MAX] =
+{
+    "isr step0", "isr step1", "isr step2", "isr step3", "isr uart",
+    "isr buttons", "isr debounce", "isr encoder"
+};
+
+// charge cycles since the last mark to whatever ran, interrupts masked
+static void cpuload_charge(void)
+{
+    uint32_t now = HWREG(DWT_CYCCNT);
+    uint32_t delta = now - g_cpuload.mark;
+
+    g_cpuload.mark = now;
+
+    if (g_cpuload.depth != 0)
+    {
+        g_cpuload.isrs[g_cpuload.stack[g_cpuload.depth - 1]].cycles += delta;
+    }
+    else if (g_cpuload.current != CPULOAD_NONE)
+    {
+        g_cpuload.tasks[g_cpuload.current].cycles += delta;
+    }
+}
+
+void cpuload_init(void)
+{
+    memset(&g_cpuload, 0, sizeof(g_cpuload));
+    g_cpuload.current = CPULOAD_NONE;
+
+#if CPULOAD_ENABLE
+    HWREG(DEMCR) |= DEMCR_TRCENA;
+    HWREG(DWT_CYCCNT) = 0;
+    HWREG(DWT_CTRL) |= DWT_CTRL_CYCCNTENA;
+#endif
+}
+
+// free running cycle count, for ad hoc benchmarks
+uint32_t cpuload_cycles(void)
+{
+#if CPULOAD_ENABLE
+    return(HWREG(DWT_CYCCNT));
+#else
+    return(0);
+#endif
+}
+
+void cpuload_task_created(void *task, const char *name)
+{
+    if (g_cpuload.ntasks < CPULOAD_MAX_TASKS)
+    {
+        g_cpuload.tasks[g_cpuload.ntasks].task = task;
+        g_cpuload.tasks[g_cpuload.ntasks].name = name;
+        g_cpuload.ntasks++;
+    }
+}
+
+// from vTaskSwitchContext(), the step ISRs are above the kernel mask
+void cpuload_task_switched_in(void *task)
+{
+    tBoolean masked;
+    uint8_t i;
+
+    masked = ROM_IntMasterDisable();
+
+    cpuload_charge();
+
+    g_cpuload.current = CPULOAD_NONE;
+    for (i=0; i<g_cpuload.ntasks; i++)
+    {
+        if (g_cpuload.tasks[i].task == task)
+        {
+            g_cpuload.current = i;
+            break;
+        }
+    }
+
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+}
+
+void cpuload_isr_enter(uint8_t id)
+{
+    tBoolean masked;
+
+    masked = ROM_IntMasterDisable();
+
+    cpuload_charge();
+
+    if (g_cpuload.depth < CPULOAD_MAX_NESTING)
+    {
+        g_cpuload.stack[g_cpuload.depth++] = id;
+        g_cpuload.isrs[id].entry = g_cpuload.mark;
+    }
+
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+}
+
+void cpuload_isr_exit(uint8_t id)
+{
+    cpuload_irq_t *isr = &g_cpuload.isrs[id];
+    tBoolean masked;
+
+    masked = ROM_IntMasterDisable();
+
+    cpuload_charge();
+
+    if ((g_cpuload.depth != 0) && (g_cpuload.stack[g_cpuload.depth - 1] == id))
+    {
+        g_cpuload.depth--;
+
+        isr->count++;
+        if ((g_cpuload.mark - isr->entry) > isr->max)
+        {
+            isr->max = g_cpuload.mark - isr->entry;
+        }
+    }
+
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+}
+
+//*****************************************************************************
+//
+// Shell commands.
+//
+//*****************************************************************************
+typedef struct {
+    uint32_t tasks[CPULOAD_MAX_TASKS];
+    uint32_t isrs[CPULOAD_ISR_MAX];
+    uint32_t counts[CPULOAD_ISR_MAX];
+} cpuload_sample_t;
+
+static void cpuload_sample(cpuload_sample_t *sample)
+{
+    tBoolean masked;
+    uint8_t i;
+
+    masked = ROM_IntMasterDisable();
+
+    cpuload_charge();
+
+    for (i=0; i<CPULOAD_MAX_TASKS; i++)
+    {
+        sample->tasks[i] = g_cpuload.tasks[i].cycles;
+    }
+
+    for (i=0; i<CPULOAD_ISR_MAX; i++)
+    {
+        sample->isrs[i] = g_cpuload.isrs[i].cycles;
+        sample->counts[i] = g_cpuload.isrs[i].count;
+    }
+
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+}
+
+// "top" refreshes from an event timer, the EVENT task runs the commands
+typedef struct {
+    cpuload_sample_t before;
+    int32_t          count;         // refreshes left
+} cpuload_top_t;
+
+static cpuload_top_t g_top;
+
+static void cpuload_top(void)
+{
+    cpuload_sample_t after;
+    uint32_t total = 0;
+    uint32_t mhz = g_clock.per_us;
+    uint8_t i;
+
+    cpuload_sample(&after);
+
+    for (i=0; i<CPULOAD_MAX_TASKS; i++)
+    {
+        after.tasks[i] -= g_top.before.tasks[i];
+        total += after.tasks[i];
+    }
+
+    for (i=0; i<CPULOAD_ISR_MAX; i++)
+    {
+        after.isrs[i] -= g_top.before.isrs[i];
+        after.counts[i] -= g_top.before.counts[i];
+        total += after.isrs[i];
+    }
+
+    if (total == 0)
+    {
+        return;
+    }
+
+    console_printf("\033[2J\033[H%-12s %6s %10s %8s\n", "name", "cpu%", "cycles", "stack");
+
+    for (i=0; i<g_cpuload.ntasks; i++)
+    {
+        console_printf("%-12s %6.1f %10u %8u\n", g_cpuload.tasks[i].name,
+                       (100.0f * after.tasks[i]) / total, after.tasks[i],
+                       (uint32_t)uxTaskGetStackHighWaterMark((xTaskHandle)g_cpuload.tasks[i].task));
+    }
+
+    console_printf("%-12s %6s %10s %8s %8s\n", "", "", "", "count", "max us");
+
+    for (i=0; i<CPULOAD_ISR_MAX; i++)
+    {
+        console_printf("%-12s %6.1f %10u %8u %8u\n", g_isr_name[i],
+                       (100.0f * after.isrs[i]) / total, after.isrs[i],
+                       after.counts[i], g_cpuload.isrs[i].max / mhz);
+    }
+}
+
+static void cpuload_top_timer(const event_t *event)
+{
+    if (event->arg != EVENT_TIMER_TOP)
+    {
+        return;
+    }
+
+    cpuload_top();
+    cpuload_sample(&g_top.before);
+
+    if (--g_top.count <= 0)
+    {
+        event_timer_stop(EVENT_TIMER_TOP);
+    }
+}
+
+// after eventTaskInit()
+int8_t cpuload_top_init(void)
+{
+    return(event_register(EVENT_TIMER, cpuload_top_timer));
+}
+
+// a new "top" replaces the one running, "top 0 -1" stops it
+static void cpuload_cmd_top(const shell_arg_t *arg)
+{
+    uint32_t interval = arg[0].i ? arg[0].i : 1000;
+
+    g_top.count = arg[1].i ? arg[1].i : 1;
+
+    if (g_top.count <= 0)
+    {
+        event_timer_stop(EVENT_TIMER_TOP);
+        return;
+    }
+
+    cpuload_sample(&g_top.before);
+    event_timer_start(EVENT_TIMER_TOP, interval, 1);
+}
+
+SHELL_COMMAND(top, "top", "|ii", "(cpu load) interval_ms, refreshes (< 0 stop); stack in words", cpuload_cmd_top);
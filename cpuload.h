@@ -0,0 +1,58 @@
+//*****************************************************************************
+//
+// cpuload.h - Per-task and per-ISR CPU time accounting
+//
+// Time is measured with the DWT cycle counter. The kernel's task switch
+// hook charges the elapsed cycles to the task being switched out, and
+// instrumented interrupt handlers charge their own time to an ISR slot
+// instead of the task they interrupted. Handlers not instrumented (SysTick,
+// PendSV) count towards the interrupted task.
+//
+//*****************************************************************************
+
+#ifndef __CPULOAD_H__
+#define __CPULOAD_H__
+
+#ifndef CPULOAD_ENABLE
+#define CPULOAD_ENABLE          1
+#endif
+
+#define CPULOAD_MAX_TASKS       12
+
+typedef enum
+{
+  CPULOAD_ISR_STEP0,
+  CPULOAD_ISR_STEP1,
+  CPULOAD_ISR_STEP2,
+  CPULOAD_ISR_STEP3,
+  CPULOAD_ISR_UART,
+  CPULOAD_ISR_BUTTONS,
+  CPULOAD_ISR_DEBOUNCE,
+  CPULOAD_ISR_ENCODER,
+  CPULOAD_ISR_MAX
+} cpuload_isr_t;
+
+#if CPULOAD_ENABLE
+#define CPULOAD_ISR_ENTER(id)   cpuload_isr_enter(id)
+#define CPULOAD_ISR_EXIT(id)    cpuload_isr_exit(id)
+#else
+#define CPULOAD_ISR_ENTER(id)
+#define CPULOAD_ISR_EXIT(id)
+#endif
+
+//*****************************************************************************
+//
+// Prototypes for the CPULOAD
+//
+//*****************************************************************************
+void cpuload_init(void);
+uint32_t cpuload_cycles(void);
+int8_t cpuload_top_init(void);
+void cpuload_isr_enter(uint8_t id);
+void cpuload_isr_exit(uint8_t id);
+
+// kernel hooks, see FreeRTOSConfig.h
+void cpuload_task_created(void *task, const char *name);
+void cpuload_task_switched_in(void *task);
+
+#endif // __CPULOAD_H__
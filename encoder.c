@@ -0,0 +1,287 @@
+//*****************************************************************************
+//
+// encoder.c - Quadrature encoders for stepper feedback
+//
+// An axis reads its encoder either from QEI0 (PD6/PD7, so one axis at a
+// time) or from a pair of port B pins whose edges the port B interrupt
+// counts itself, x4 decoded through a state table: PB0 (A) and PB1 (B) for
+// axis 0 up to PB4/PB5 for axis 2. Axis 3 has no GPIO encoder: R9/R10 on the
+// EK-LM4F120XL tie PB6/PB7 to PD0/PD1, axis 1's coils. Counts are signed and
+// wrap at 32 bits; stepper.c turns them into steps, see stepper_feedback().
+//
+//*****************************************************************************
+
+#include <inttypes.h>
+
+#include "inc/hw_gpio.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+#include "driverlib/gpio.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/pin_map.h"
+#include "driverlib/qei.h"
+#include "driverlib/rom.h"
+#include "driverlib/sysctl.h"
+#include "console.h"
+#include "shell_task.h"
+#include "cpuload.h"
+#include "ramfunc.h"
+#include "stepper.h"
+#include "encoder.h"
+
+// below the step timers, no kernel calls
+#define ENCODER_INT_PRIORITY    (1 << 5)
+
+#define ENCODER_PINS(axis)      (3 << (2 * (axis)))
+
+// axes with a pair of port B pins, PB6/PB7 are shorted to PD0/PD1
+#define ENCODER_GPIO_AXES       3
+#define ENCODER_GPIO_PINS       ((1 << (2 * ENCODER_GPIO_AXES)) - 1)
+
+typedef struct
+{
+    uint8_t          source[STEPPER_MAX];
+    uint8_t          gpio_mask;             // port B pins counted
+    uint8_t          state;                 // port B pins at the last edge
+    uint8_t          qei;                   // QEI0 set up
+    volatile int32_t count[STEPPER_MAX];    // ENCODER_GPIO counts
+    uint32_t         errors;                // both phases changed at once
+} encoder_t;
+
+static encoder_t g_encoder;
+
+static const char * const g_source_name[ENCODER_SOURCE_MAX] = { "none", "qei", "gpio" };
+
+// count change by (old << 2) | new, A in bit 0 and B in bit 1; A leading
+// B counts up
+static const int8_t g_quad[16] FASTDATA = {
+     0, +1, -1,  0,
+    -1,  0,  0, +1,
+    +1,  0,  0, -1,
+     0, -1, +1,  0
+};
+
+//*****************************************************************************
+//
+// Port B edge interrupt. No kernel calls allowed at this priority.
+//
+//*****************************************************************************
+void
+EncoderIntHandler(void)
+{
+    uint8_t pins, old, now, i;
+
+    CPULOAD_ISR_ENTER(CPULOAD_ISR_ENCODER);
+
+    // cleared before the read, an edge in between interrupts again
+    ROM_GPIOPinIntClear(GPIO_PORTB_BASE, ROM_GPIOPinIntStatus(GPIO_PORTB_BASE, true));
+
+    pins = ROM_GPIOPinRead(GPIO_PORTB_BASE, g_encoder.gpio_mask);
+
+    for (i=0; i<ENCODER_GPIO_AXES; i++)
+    {
+        if ((g_encoder.gpio_mask & ENCODER_PINS(i)) == 0)
+        {
+            continue;
+        }
+
+        old = (g_encoder.state >> (2 * i)) & 3;
+        now = (pins >> (2 * i)) & 3;
+
+        // an edge went by unseen, the direction is unknown
+        if ((old ^ now) == 3)
+        {
+            g_encoder.errors++;
+        }
+
+        g_encoder.count[i] += g_quad[(old << 2) | now];
+    }
+
+    g_encoder.state = pins;
+
+    CPULOAD_ISR_EXIT(CPULOAD_ISR_ENCODER);
+}
+
+// QEI0 in x4 mode, counting over the full 32 bits
+static void encoder_qei_init(void)
+{
+    ROM_SysCtlPeripheralEnable(SYSCTL_PERIPH_QEI0);
+    ROM_SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOD);
+
+    //
+    // PD7 is NMI after reset, unlock it.
+    //
+    HWREG(GPIO_PORTD_BASE + GPIO_O_LOCK) = GPIO_LOCK_KEY_DD;
+    HWREG(GPIO_PORTD_BASE + GPIO_O_CR) |= GPIO_PIN_7;
+    HWREG(GPIO_PORTD_BASE + GPIO_O_LOCK) = 0;
+
+#ifdef GPIO_PD6_PHA0
+    GPIOPinConfigure(GPIO_PD6_PHA0);
+    GPIOPinConfigure(GPIO_PD7_PHB0);
+#endif
+    ROM_GPIOPinTypeQEI(GPIO_PORTD_BASE, GPIO_PIN_6 | GPIO_PIN_7);
+
+    ROM_QEIConfigure(QEI0_BASE, QEI_CONFIG_CAPTURE_A_B | QEI_CONFIG_NO_RESET |
+                     QEI_CONFIG_QUADRATURE | QEI_CONFIG_NO_SWAP, 0xffffffff);
+    ROM_QEIEnable(QEI0_BASE);
+
+    g_encoder.qei = 1;
+}
+
+void encoder_init(void)
+{
+    //
+    // Port B inputs, pulled up for open collector encoders, interrupting
+    // on both edges once an axis is attached. PB6/PB7 are left alone, they
+    // follow axis 1's coils.
+    //
+    ROM_SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOB);
+    ROM_GPIOPinTypeGPIOInput(GPIO_PORTB_BASE, ENCODER_GPIO_PINS);
+    ROM_GPIOPadConfigSet(GPIO_PORTB_BASE, ENCODER_GPIO_PINS, GPIO_STRENGTH_2MA, GPIO_PIN_TYPE_STD_WPU);
+    ROM_GPIOPinIntDisable(GPIO_PORTB_BASE, ENCODER_GPIO_PINS);
+    ROM_GPIOIntTypeSet(GPIO_PORTB_BASE, ENCODER_GPIO_PINS, GPIO_BOTH_EDGES);
+    ROM_GPIOPinIntClear(GPIO_PORTB_BASE, ENCODER_GPIO_PINS);
+    ROM_IntPrioritySet(INT_GPIOB, ENCODER_INT_PRIORITY);
+    ROM_IntEnable(INT_GPIOB);
+
+    console_printf("Encoder initialized\n");
+}
+
+// read the encoder of axis from source, ENCODER_NONE detaches it
+int8_t encoder_attach(uint8_t axis, uint8_t source)
+{
+    tBoolean masked;
+    uint8_t pins;
+    uint8_t i;
+
+    if ((axis >= STEPPER_MAX) || (source >= ENCODER_SOURCE_MAX))
+    {
+        return(ENCODER_ERROR);
+    }
+
+    if ((source == ENCODER_GPIO) && (axis >= ENCODER_GPIO_AXES))
+    {
+        return(ENCODER_ERROR);
+    }
+
+    // one QEI to go round
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        if ((source == ENCODER_QEI) && (i != axis) && (g_encoder.source[i] == ENCODER_QEI))
+        {
+            return(ENCODER_ERROR);
+        }
+    }
+
+    // the QEI is set up on first use, the QEMU board has none
+    if ((source == ENCODER_QEI) && !g_encoder.qei)
+    {
+        encoder_qei_init();
+    }
+
+    pins = ENCODER_PINS(axis);
+
+    ROM_GPIOPinIntDisable(GPIO_PORTB_BASE, pins);
+
+    masked = ROM_IntMasterDisable();
+
+    g_encoder.source[axis] = source;
+    g_encoder.count[axis] = 0;
+
+    if (source == ENCODER_GPIO)
+    {
+        g_encoder.gpio_mask |= pins;
+        g_encoder.state = (g_encoder.state & ~pins) | ROM_GPIOPinRead(GPIO_PORTB_BASE, pins);
+    }
+    else
+    {
+        g_encoder.gpio_mask &= ~pins;
+    }
+
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+
+    if (source == ENCODER_GPIO)
+    {
+        ROM_GPIOPinIntClear(GPIO_PORTB_BASE, pins);
+        ROM_GPIOPinIntEnable(GPIO_PORTB_BASE, pins);
+    }
+
+    return(ENCODER_OK);
+}
+
+// pins of the GPIO port at port_base the attached encoders read
+uint8_t encoder_pins(uint32_t port_base)
+{
+    uint8_t i;
+
+    if (port_base == GPIO_PORTB_BASE)
+    {
+        return(g_encoder.gpio_mask);
+    }
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        if ((port_base == GPIO_PORTD_BASE) && (g_encoder.source[i] == ENCODER_QEI))
+        {
+            return(GPIO_PIN_6 | GPIO_PIN_7);
+        }
+    }
+
+    return(0);
+}
+
+// encoder position of axis, counts
+int32_t encoder_count(uint8_t axis)
+{
+    if (axis >= STEPPER_MAX)
+    {
+        return(0);
+    }
+
+    switch (g_encoder.source[axis])
+    {
+        case ENCODER_QEI:
+            return((int32_t)ROM_QEIPositionGet(QEI0_BASE));
+
+        case ENCODER_GPIO:
+            return(g_encoder.count[axis]);
+
+        default:
+            return(0);
+    }
+}
+
+//*****************************************************************************
+//
+// Shell commands
+//
+//*****************************************************************************
+static void encoder_cmd_attach(const shell_arg_t *arg)
+{
+    if (encoder_attach(arg[0].i, arg[1].i) != ENCODER_OK)
+    {
+        console_printf("encoder: bad axis or source, gpio on axis 3, or the QEI is taken\n");
+        return;
+    }
+
+    console_printf("encoder: axis %i on %s\n", arg[0].i, g_source_name[arg[1].i]);
+}
+
+static void encoder_cmd_status(const shell_arg_t *arg)
+{
+    uint8_t i;
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        console_printf("encoder %i: %s, count %i\n", i, g_source_name[g_encoder.source[i]], encoder_count(i));
+    }
+
+    console_printf("encoder: %u edges missed\n", g_encoder.errors);
+}
+
+SHELL_COMMAND(enc, "enc", "ii", "(encoder) sid, source 0 none 1 qei 2 gpio (sid 0-2)", encoder_cmd_attach);
+SHELL_COMMAND(encst, "encst", "", "(encoder status)", encoder_cmd_status);
@@ -0,0 +1,36 @@
+//*****************************************************************************
+//
+// encoder.h - Quadrature encoders for stepper feedback
+//
+//*****************************************************************************
+
+#ifndef __ENCODER_H__
+#define __ENCODER_H__
+
+typedef enum
+{
+  ENCODER_ERROR = -1,
+  ENCODER_OK
+} encoder_result_t;
+
+typedef enum
+{
+  ENCODER_NONE,         // open loop
+  ENCODER_QEI,          // QEI0 on PD6/PD7, one axis at a time
+  ENCODER_GPIO,         // edges of PB(2 * axis) and PB(2 * axis + 1), axes 0-2:
+                        // PB6/PB7 are tied to axis 1's coils on PD0/PD1
+  ENCODER_SOURCE_MAX
+} encoder_source_t;
+
+//*****************************************************************************
+//
+// Prototypes for the ENCODER
+//
+//*****************************************************************************
+void encoder_init(void);
+int8_t encoder_attach(uint8_t axis, uint8_t source);
+int32_t encoder_count(uint8_t axis);
+uint8_t encoder_pins(uint32_t port_base);
+void EncoderIntHandler(void);
+
+#endif // __ENCODER_H__
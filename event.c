@@ -0,0 +1,248 @@
+//*****************************************************************************
+//
+// event.c - Single event loop for the low-priority modules
+//
+//*****************************************************************************
+
+#include <string.h>
+
+#include <inttypes.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "console.h"
+#include "shell_task.h"
+#include "priorities.h"
+#include "membudget.h"
+#include "event.h"
+
+//*****************************************************************************
+//
+// The stack size for the EVENT task; shell commands run on it.
+//
+//*****************************************************************************
+#define EVENTTASKSTACKSIZE      256         // Stack size in words
+
+MEMBUDGET_STACK(g_event_stack, EVENTTASKSTACKSIZE);
+
+typedef struct {
+    uint8_t         type;
+    event_handler_t handler;
+} event_slot_t;
+
+typedef struct {
+    portTickType    period;             // 0 when stopped
+    portTickType    due;
+    uint8_t         periodic;
+} event_soft_timer_t;
+
+typedef struct {
+    xQueueHandle       queue;
+    event_slot_t       slots[EVENT_MAX_HANDLERS];
+    uint8_t            nslots;
+    event_soft_timer_t timers[EVENT_TIMER_MAX];
+    uint32_t           dispatched;
+    uint32_t           dropped;         // queue full
+    uint8_t            peak;
+} event_loop_t;
+
+static event_loop_t g_event;
+
+// handlers are registered during init, before the scheduler starts
+int8_t event_register(uint8_t type, event_handler_t handler)
+{
+    if ((g_event.nslots == EVENT_MAX_HANDLERS) || (type >= EVENT_TYPE_MAX))
+    {
+        return(-1);
+    }
+
+    g_event.slots[g_event.nslots].type = type;
+    g_event.slots[g_event.nslots].handler = handler;
+    g_event.nslots++;
+
+    return(0);
+}
+
+int8_t event_post(uint8_t type, uint8_t arg, uint32_t value)
+{
+    event_t event = { type, arg, 0, value };
+
+    if (xQueueSend(g_event.queue, &event, 0) != pdPASS)
+    {
+        g_event.dropped++;
+        return(-1);
+    }
+
+    return(0);
+}
+
+// from interrupts at or below configMAX_SYSCALL_INTERRUPT_PRIORITY only
+int8_t event_post_from_isr(uint8_t type, uint8_t arg, uint32_t value)
+{
+    signed portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+    event_t event = { type, arg, 0, value };
+    int8_t result = 0;
+
+    if (xQueueSendFromISR(g_event.queue, &event, &xHigherPriorityTaskWoken) != pdPASS)
+    {
+        g_event.dropped++;
+        result = -1;
+    }
+
+    portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+
+    return(result);
+}
+
+// timers belong to the loop, start and stop them from handlers or init
+void event_timer_start(uint8_t id, uint32_t period_ms, uint8_t periodic)
+{
+    event_soft_timer_t *timer = &g_event.timers[id];
+
+    timer->period = (period_ms / portTICK_RATE_MS) ? (period_ms / portTICK_RATE_MS) : 1;
+    timer->due = xTaskGetTickCount() + timer->period;
+    timer->periodic = periodic;
+}
+
+void event_timer_stop(uint8_t id)
+{
+    g_event.timers[id].period = 0;
+}
+
+static void event_dispatch(const event_t *event)
+{
+    uint8_t i;
+
+    for (i=0; i<g_event.nslots; i++)
+    {
+        if (g_event.slots[i].type == event->type)
+        {
+            g_event.slots[i].handler(event);
+        }
+    }
+
+    g_event.dispatched++;
+}
+
+// fire expired timers, returns ticks until the next one is due
+static portTickType event_timers(void)
+{
+    portTickType now = xTaskGetTickCount();
+    portTickType wait = portMAX_DELAY;
+    portTickType left;
+    event_t event = { EVENT_TIMER, 0, 0, 0 };
+    uint8_t i;
+
+    for (i=0; i<EVENT_TIMER_MAX; i++)
+    {
+        event_soft_timer_t *timer = &g_event.timers[i];
+
+        if (timer->period == 0)
+        {
+            continue;
+        }
+
+        if ((portTickType)(now - timer->due) < (portMAX_DELAY / 2))
+        {
+            if (timer->periodic)
+            {
+                timer->due += timer->period;
+            }
+            else
+            {
+                timer->period = 0;
+            }
+
+            event.arg = i;
+            event.value = now;
+            event_dispatch(&event);
+
+            // the handler may have restarted or stopped it
+            if (timer->period == 0)
+            {
+                continue;
+            }
+
+            now = xTaskGetTickCount();
+        }
+
+        left = timer->due - now;
+        if (left > (portMAX_DELAY / 2))
+        {
+            left = 0;
+        }
+        if (left < wait)
+        {
+            wait = left;
+        }
+    }
+
+    return(wait);
+}
+
+static void
+eventTask(void *pvParameters)
+{
+    event_t event;
+    uint8_t depth;
+
+    while(1)
+    {
+        if (xQueueReceive(g_event.queue, &event, event_timers()) == pdPASS)
+        {
+            depth = uxQueueMessagesWaiting(g_event.queue) + 1;
+            if (depth > g_event.peak)
+            {
+                g_event.peak = depth;
+            }
+
+            event_dispatch(&event);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Initializes the EVENT task. Call before any module registers or posts.
+//
+//*****************************************************************************
+unsigned long
+eventTaskInit(void)
+{
+    g_event.queue = xQueueCreate(EVENT_QUEUE_SIZE, sizeof(event_t));
+
+    if (g_event.queue == NULL)
+    {
+        return(1);
+    }
+
+    //
+    // Create the EVENT task.
+    //
+    if(MEMBUDGET_TASK_CREATE(eventTask, "EVENT", g_event_stack, PRIORITY_EVENT_TASK) != pdTRUE)
+    {
+        return(1);
+    }
+
+    console_printf("Event task init.\n");
+
+    //
+    // Success.
+    //
+    return(0);
+}
+
+//*****************************************************************************
+//
+// Shell commands.
+//
+//*****************************************************************************
+static void event_cmd_status(const shell_arg_t *arg)
+{
+    console_printf("event_status: handlers %u, dispatched %u, dropped %u, queue peak %u/%u\n",
+                   g_event.nslots, g_event.dispatched, g_event.dropped, g_event.peak, EVENT_QUEUE_SIZE);
+}
+
+SHELL_COMMAND(est, "est", "", "(event loop status)", event_cmd_status);
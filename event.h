@@ -0,0 +1,57 @@
+//*****************************************************************************
+//
+// event.h - Single event loop for the low-priority modules
+//
+// The shell, buttons and LED no longer own tasks. They register handlers
+// here and the EVENT task dispatches every message posted to its queue, in
+// order, plus the expiries of a few software timers, on one stack.
+//
+//*****************************************************************************
+
+#ifndef __EVENT_H__
+#define __EVENT_H__
+
+typedef enum
+{
+  EVENT_LINE,           // shell line complete
+  EVENT_BUTTON,         // arg: buttons pressed
+  EVENT_TIMER,          // arg: timer id
+  EVENT_MOTION_DONE,    // arg: stepper index
+  EVENT_STEPS_LOST,     // arg: stepper index, value: steps lost (int32_t)
+  EVENT_TRIGGER,        // arg: stepper index, value: trigger arg
+  EVENT_TYPE_MAX
+} event_type_t;
+
+typedef enum
+{
+  EVENT_TIMER_LED,
+  EVENT_TIMER_TOP,
+  EVENT_TIMER_MAX
+} event_timer_t;
+
+typedef struct
+{
+  uint8_t  type;
+  uint8_t  arg;
+  uint16_t reserved;
+  uint32_t value;
+} event_t;
+
+typedef void (*event_handler_t)(const event_t *event);
+
+#define EVENT_MAX_HANDLERS      8
+#define EVENT_QUEUE_SIZE        16
+
+//*****************************************************************************
+//
+// Prototypes for the EVENT
+//
+//*****************************************************************************
+unsigned long eventTaskInit(void);
+int8_t event_register(uint8_t type, event_handler_t handler);
+int8_t event_post(uint8_t type, uint8_t arg, uint32_t value);
+int8_t event_post_from_isr(uint8_t type, uint8_t arg, uint32_t value);
+void event_timer_start(uint8_t id, uint32_t period_ms, uint8_t periodic);
+void event_timer_stop(uint8_t id);
+
+#endif // __EVENT_H__
@@ -1,235 +1,159 @@
-//*****************************************************************************
-//
-// led_task.c - A simple flashing LED task.
-//
-// Copyright (c) 2012 Texas Instruments Incorporated.  All rights reserved.
-// Software License Agreement
-// 
-// Texas Instruments (TI) is supplying this software for use solely and
-// exclusively on TI's microcontroller products. The software is owned by
-// TI and/or its suppliers, and is protected under applicable copyright
-// laws. You may not combine this software with "viral" open-source
-// software in order to form a larger program.
-// 
-// THIS SOFTWARE IS PROVIDED "AS IS" AND WITH ALL FAULTS.
-// NO WARRANTIES, WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT
-// NOT LIMITED TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
-// A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. TI SHALL NOT, UNDER ANY
-// CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
-// DAMAGES, FOR ANY REASON WHATSOEVER.
-// 
-// This is part of revision 9453 of the EK-LM4F120XL Firmware Package.
-//
-//*****************************************************************************
-
-#include "inc/hw_memmap.h"
-#include "inc/hw_types.h"
-#include "driverlib/gpio.h"
-#include "driverlib/rom.h"
-#include "drivers/rgb.h"
-#include "drivers/buttons.h"
-#include "utils/uartstdio.h"
-#include "led_task.h"
-#include "priorities.h"
-#include "FreeRTOS.h"
-#include "task.h"
-#include "queue.h"
-#include "semphr.h"
-
-//*****************************************************************************
-//
-// The stack size for the LED toggle task.
-//
-//*****************************************************************************
-#define LEDTASKSTACKSIZE        128         // Stack size in words
-
-//*****************************************************************************
-//
-// The item size and queue size for the LED message queue.
-//
-//*****************************************************************************
-#define LED_ITEM_SIZE           sizeof(unsigned char)
-#define LED_QUEUE_SIZE          5
-
-//*****************************************************************************
-//
-// Default LED toggle delay value. LED toggling frequency is twice this number.
-//
-//*****************************************************************************
-#define LED_TOGGLE_DELAY        250
-
-//*****************************************************************************
-//
-// The queue that holds messages sent to the LED task.
-//
-//*****************************************************************************
-xQueueHandle g_pLEDQueue;
-
-//
-// [G, R, B] range is 0 to 0xFFFF per color.
-//
-static unsigned long g_ulColors[3] = { 0x0000, 0x0000, 0x0000 };
-static unsigned char g_ucColorsIndx;
-
-extern xSemaphoreHandle g_pUARTSemaphore;
-
-//*****************************************************************************
-//
-// This task toggles the user selected LED at a user selected frequency. User
-// can make the selections by pressing the left and right buttons.
-//
-//*****************************************************************************
-static void
-LEDTask(void *pvParameters)
-{
-    portTickType ulWakeTime;
-    unsigned long ulLEDToggleDelay;
-    unsigned char cMessage;
-
-    //
-    // Initialize the LED Toggle Delay to default value.
-    //
-    ulLEDToggleDelay = LED_TOGGLE_DELAY;
-
-    //
-    // Get the current tick count.
-    //
-    ulWakeTime = xTaskGetTickCount();
-
-    //
-    // Loop forever.
-    //
-    while(1)
-    {
-        //
-        // Read the next message, if available on queue.
-        //
-        if(xQueueReceive(g_pLEDQueue, &cMessage, 0) == pdPASS)
-        {
-            //
-            // If left button, update to next LED.
-            //
-            if(cMessage == LEFT_BUTTON)
-            {
-                //
-                // Update the LED buffer to turn off the currently working.
-                //
-                g_ulColors[g_ucColorsIndx] = 0x0000;
-
-                //
-                // Update the index to next LED
-                g_ucColorsIndx++;
-                if(g_ucColorsIndx > 2)
-                {
-                    g_ucColorsIndx = 0;
-                }
-
-                //
-                // Update the LED buffer to turn on the newly selected LED.
-                //
-                g_ulColors[g_ucColorsIndx] = 0x8000;
-
-                //
-                // Configure the new LED settings.
-                //
-                RGBColorSet(g_ulColors);
-
-                //
-                // Guard UART from concurrent access. Print the currently
-                // blinking LED.
-                //
-                xSemaphoreTake(g_pUARTSemaphore, portMAX_DELAY);
-                UARTprintf("Led %d is blinking. [G, R, B]\n", g_ucColorsIndx);
-                xSemaphoreGive(g_pUARTSemaphore);
-            }
-
-            //
-            // If right button, update delay time between toggles of led.
-            //
-            if(cMessage == RIGHT_BUTTON)
-            {
-                ulLEDToggleDelay *= 2;
-                if(ulLEDToggleDelay > 1000)
-                {
-                    ulLEDToggleDelay = LED_TOGGLE_DELAY / 2;
-                }
-
-                //
-                // Guard UART from concurrent access. Print the currently
-                // blinking frequency.
-                //
-                xSemaphoreTake(g_pUARTSemaphore, portMAX_DELAY);
-                UARTprintf("Led blinking frequency is %d ms.\n",
-                           (ulLEDToggleDelay * 2));
-                xSemaphoreGive(g_pUARTSemaphore);
-            }
-        }
-
-        //
-        // Turn on the LED.
-        //
-        RGBEnable();
-
-        //
-        // Wait for the required amount of time.
-        //
-        vTaskDelayUntil(&ulWakeTime, ulLEDToggleDelay / portTICK_RATE_MS);
-
-        //
-        // Turn off the LED.
-        //
-        RGBDisable();
-
-        //
-        // Wait for the required amount of time.
-        //
-        vTaskDelayUntil(&ulWakeTime, ulLEDToggleDelay / portTICK_RATE_MS);
-    }
-}
-
-//*****************************************************************************
-//
-// Initializes the LED task.
-//
-//*****************************************************************************
-unsigned long
-LEDTaskInit(void)
-{
-    //
-    // Initialize the GPIOs and Timers that drive the three LEDs.
-    //
-    RGBInit(1);
-    RGBIntensitySet(0.3f);
-
-    //
-    // Turn on the Green LED
-    //
-    g_ucColorsIndx = 0;
-    g_ulColors[g_ucColorsIndx] = 0x8000;
-    RGBColorSet(g_ulColors);
-
-    //
-    // Print the current loggling LED and frequency.
-    //
-    UARTprintf("\nLed %d is blinking. [G, R, B]\n", g_ucColorsIndx);
-    UARTprintf("Led blinking frequency is %d ms.\n", (LED_TOGGLE_DELAY * 2));
-
-    //
-    // Create a queue for sending messages to the LED task.
-    //
-    g_pLEDQueue = xQueueCreate(LED_QUEUE_SIZE, LED_ITEM_SIZE);
-
-    //
-    // Create the LED task.
-    //
-    if(xTaskCreate(LEDTask, (signed portCHAR *)"LED", LEDTASKSTACKSIZE, NULL,
-                   tskIDLE_PRIORITY + PRIORITY_LED_TASK, NULL) != pdTRUE)
-    {
-        return(1);
-    }
-
-    //
-    // Success.
-    //
-    return(0);
-}
+//*****************************************************************************
+//
+// led_task.c - A simple flashing LED.
+//
+// Copyright (c) 2012 Texas Instruments Incorporated.  All rights reserved.
+// Software License Agreement
+// 
+// Texas Instruments (TI) is supplying this software for use solely and
+// exclusively on TI's microcontroller products. The software is owned by
+// TI and/or its suppliers, and is protected under applicable copyright
+// laws. You may not combine this software with "viral" open-source
+// software in order to form a larger program.
+// 
+// THIS SOFTWARE IS PROVIDED "AS IS" AND WITH ALL FAULTS.
+// NO WARRANTIES, WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT
+// NOT LIMITED TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. TI SHALL NOT, UNDER ANY
+// CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+// DAMAGES, FOR ANY REASON WHATSOEVER.
+// 
+// This is part of revision 9453 of the EK-LM4F120XL Firmware Package.
+//
+//*****************************************************************************
+
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+#include "driverlib/gpio.h"
+#include "driverlib/rom.h"
+#include "driverlib/sysctl.h"
+#include "drivers/buttons.h"
+
+#include <inttypes.h>
+
+#include "console.h"
+#include "led_task.h"
+#include "event.h"
+
+//*****************************************************************************
+//
+// Default LED toggle delay value. LED toggling frequency is twice this number.
+//
+//*****************************************************************************
+#define LED_TOGGLE_DELAY        250
+
+//
+// [G, R, B] on PF3, PF1 and PF2. Plain GPIO: the PWM of drivers/rgb.c needs
+// Timer0B, Timer1A and Timer1B, which step the motors.
+//
+#define LED_GPIO_PERIPH         SYSCTL_PERIPH_GPIOF
+#define LED_GPIO_BASE           GPIO_PORTF_BASE
+#define LED_GPIO_PINS           (GPIO_PIN_1 | GPIO_PIN_2 | GPIO_PIN_3)
+
+static const unsigned char g_ucLEDPins[3] = { GPIO_PIN_3, GPIO_PIN_1, GPIO_PIN_2 };
+static unsigned char g_ucColorsIndx;
+static unsigned long g_ulLEDToggleDelay;
+static unsigned char g_ucLEDOn;
+
+//*****************************************************************************
+//
+// Toggles the user selected LED on each expiry of the LED timer.
+//
+//*****************************************************************************
+static void
+LEDTimer(const event_t *event)
+{
+    if(event->arg != EVENT_TIMER_LED)
+    {
+        return;
+    }
+
+    g_ucLEDOn = !g_ucLEDOn;
+    ROM_GPIOPinWrite(LED_GPIO_BASE, LED_GPIO_PINS,
+                     g_ucLEDOn ? g_ucLEDPins[g_ucColorsIndx] : 0);
+}
+
+//*****************************************************************************
+//
+// Changes the user selected LED and frequency. User can make the selections
+// by pressing the left and right buttons.
+//
+//*****************************************************************************
+static void
+LEDButton(const event_t *event)
+{
+    //
+    // If left button, update to next LED.
+    //
+    if(event->arg == LEFT_BUTTON)
+    {
+        //
+        // Update the index to next LED, it lights on the next toggle.
+        //
+        g_ucColorsIndx++;
+        if(g_ucColorsIndx > 2)
+        {
+            g_ucColorsIndx = 0;
+        }
+
+        console_printf("Led %d is blinking. [G, R, B]\n", g_ucColorsIndx);
+    }
+
+    //
+    // If right button, update delay time between toggles of led.
+    //
+    if(event->arg == RIGHT_BUTTON)
+    {
+        g_ulLEDToggleDelay *= 2;
+        if(g_ulLEDToggleDelay > 1000)
+        {
+            g_ulLEDToggleDelay = LED_TOGGLE_DELAY / 2;
+        }
+
+        event_timer_start(EVENT_TIMER_LED, g_ulLEDToggleDelay, 1);
+
+        console_printf("Led blinking frequency is %d ms.\n",
+                       (g_ulLEDToggleDelay * 2));
+    }
+}
+
+//*****************************************************************************
+//
+// Initializes the LED, toggled from the EVENT task.
+//
+//*****************************************************************************
+unsigned long
+LEDInit(void)
+{
+    //
+    // Initialize the GPIOs that drive the three LEDs.
+    //
+    ROM_SysCtlPeripheralEnable(LED_GPIO_PERIPH);
+    ROM_GPIOPinTypeGPIOOutput(LED_GPIO_BASE, LED_GPIO_PINS);
+    ROM_GPIOPinWrite(LED_GPIO_BASE, LED_GPIO_PINS, 0);
+
+    //
+    // Start with the Green LED
+    //
+    g_ucColorsIndx = 0;
+
+    //
+    // Print the current loggling LED and frequency.
+    //
+    console_printf("\nLed %d is blinking. [G, R, B]\n", g_ucColorsIndx);
+    console_printf("Led blinking frequency is %d ms.\n", (LED_TOGGLE_DELAY * 2));
+
+    if((event_register(EVENT_TIMER, LEDTimer) != 0) ||
+       (event_register(EVENT_BUTTON, LEDButton) != 0))
+    {
+        return(1);
+    }
+
+    g_ulLEDToggleDelay = LED_TOGGLE_DELAY;
+    event_timer_start(EVENT_TIMER_LED, g_ulLEDToggleDelay, 1);
+
+    //
+    // Success.
+    //
+    return(0);
+}
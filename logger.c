@@ -0,0 +1,263 @@
+//*****************************************************************************
+//
+// logger.c - Deferred, tokenized logging
+//
+//*****************************************************************************
+
+#include <string.h>
+
+#include <inttypes.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "inc/hw_types.h"
+#include "console.h"
+#include "numio.h"
+#include "priorities.h"
+#include "membudget.h"
+#include "logger.h"
+
+//*****************************************************************************
+//
+// The stack size for the LOGGER task.
+//
+//*****************************************************************************
+#define LOGGERTASKSTACKSIZE     128         // Stack size in words
+
+MEMBUDGET_STACK(g_logger_stack, LOGGERTASKSTACKSIZE);
+
+//*****************************************************************************
+//
+// Ring size (power of 2) and drain interval of the LOGGER task.
+//
+//*****************************************************************************
+#define LOGGER_RING_SIZE        32
+#define LOGGER_DRAIN_DELAY      20
+
+//*****************************************************************************
+//
+// Binary frame: sync, id, nargs, seq[4], args[4 * nargs], xor of id..args.
+//
+//*****************************************************************************
+#define LOGGER_SYNC             0xa5
+
+typedef struct {
+    volatile uint8_t ready;             // entry fully written by producer
+    uint8_t          id;                // format-ID
+    uint8_t          nargs;             // number of valid args
+    uint32_t         seq;               // pushes before it, gaps mean drops
+    uint32_t         args[LOGGER_MAX_ARGS];
+} logger_entry_t;
+
+typedef struct {
+    volatile uint32_t head;             // next slot to reserve
+    volatile uint32_t tail;             // next slot to drain
+    volatile uint32_t dropped;          // pushes lost to a full ring
+    logger_entry_t    ring[LOGGER_RING_SIZE];
+} logger_t;
+
+static logger_t g_logger;
+
+#ifndef LOGGER_BINARY
+static const char * const g_logger_fmt[LOG_FMT_MAX] = {
+#define LOGGER_FMT(id, fmt) fmt,
+#include "logger_fmt.h"
+#undef LOGGER_FMT
+};
+#endif
+
+//*****************************************************************************
+//
+// Push a message, callable from tasks and ISRs. Slots are reserved with a
+// compare-and-swap on the head index so producers never block each other;
+// the ready flag hands the slot over to the LOGGER task.
+//
+//*****************************************************************************
+void logger_push(uint8_t id, uint8_t nargs, const uint32_t *args)
+{
+    logger_entry_t *entry;
+    uint32_t head, dropped;
+
+    do
+    {
+        head = g_logger.head;
+        dropped = g_logger.dropped;
+
+        if ((head - g_logger.tail) >= LOGGER_RING_SIZE)
+        {
+            // an ISR may drop one in the middle of a plain increment
+            __sync_fetch_and_add(&g_logger.dropped, 1);
+            return;
+        }
+    } while (!__sync_bool_compare_and_swap(&g_logger.head, head, head + 1));
+
+    entry = &g_logger.ring[head & (LOGGER_RING_SIZE - 1)];
+
+    if (nargs > LOGGER_MAX_ARGS)
+    {
+        nargs = LOGGER_MAX_ARGS;
+    }
+
+    entry->id = id;
+    entry->nargs = nargs;
+    // pushes dropped so far count too, so the host sees the gap; as read
+    // with the head the slot was reserved at, not after
+    entry->seq = head + dropped;
+    memcpy(entry->args, args, nargs * sizeof(uint32_t));
+
+    entry->ready = 1;
+}
+
+#ifdef LOGGER_BINARY
+static void logger_emit(const logger_entry_t *entry)
+{
+    uint8_t frame[8 + (LOGGER_MAX_ARGS * sizeof(uint32_t))];
+    uint8_t len, sum, i;
+
+    frame[0] = LOGGER_SYNC;
+    frame[1] = entry->id;
+    frame[2] = entry->nargs;
+    memcpy(&frame[3], &entry->seq, sizeof(uint32_t)); // little endian
+    memcpy(&frame[7], entry->args, entry->nargs * sizeof(uint32_t));
+    len = 7 + (entry->nargs * sizeof(uint32_t));
+
+    for (sum = 0, i = 1; i < len; i++)
+    {
+        sum ^= frame[i];
+    }
+    frame[len++] = sum;
+
+    console_write_raw((const char *)frame, len);
+}
+#else
+static void logger_print_float(uint32_t arg)
+{
+    union { uint32_t u; float f; } v;
+    char buf[NUMIO_BUFSIZE];
+    uint8_t len;
+
+    v.u = arg;
+    len = numio_ftoa(buf, v.f, 4, NUMIO_PLUS);
+
+    console_write(buf, len);
+}
+
+static void logger_emit(const logger_entry_t *entry)
+{
+    const char *fmt = g_logger_fmt[entry->id];
+    char spec[8];
+    uint8_t arg = 0;
+    uint8_t len;
+
+    while (*fmt != '\0')
+    {
+        // literal run
+        for (len = 0; (fmt[len] != '\0') && (fmt[len] != '%'); len++)
+        {
+        }
+
+        if (len != 0)
+        {
+            console_write(fmt, len);
+            fmt += len;
+            continue;
+        }
+
+        // conversion, copy "%[0-9]*c" and hand it one argument
+        for (len = 1; (fmt[len] >= '0') && (fmt[len] <= '9') && (len < sizeof(spec) - 2); len++)
+        {
+        }
+
+        if (fmt[len] == '\0')
+        {
+            break;
+        }
+
+        memcpy(spec, fmt, len + 1);
+        spec[len + 1] = '\0';
+
+        if (fmt[len] == '%')
+        {
+            console_write("%", 1);
+        }
+        else if (arg >= entry->nargs)
+        {
+            console_write("?", 1);
+        }
+        else if (fmt[len] == 'f')
+        {
+            logger_print_float(entry->args[arg++]);
+        }
+        else
+        {
+            console_printf(spec, entry->args[arg++]);
+        }
+
+        fmt += len + 1;
+    }
+}
+#endif
+
+//*****************************************************************************
+//
+// Drain the ring at low priority.
+//
+//*****************************************************************************
+static void
+loggerTask(void *pvParameters)
+{
+    logger_entry_t *entry;
+    uint32_t dropped = 0;
+
+    while(1)
+    {
+        entry = &g_logger.ring[g_logger.tail & (LOGGER_RING_SIZE - 1)];
+
+        if (entry->ready)
+        {
+            logger_emit(entry);
+
+            entry->ready = 0;
+            g_logger.tail++;
+            continue;
+        }
+
+        if (g_logger.dropped != dropped)
+        {
+            uint32_t lost = g_logger.dropped - dropped;
+
+            dropped += lost;
+            LOG_WARN(LOG_LOGGER_DROPPED, lost);
+        }
+
+        //
+        // Wait for the required amount of time.
+        //
+        vTaskDelay(LOGGER_DRAIN_DELAY / portTICK_RATE_MS);
+    }
+}
+
+//*****************************************************************************
+//
+// Initializes the LOGGER task.
+//
+//*****************************************************************************
+unsigned long
+loggerTaskInit(void)
+{
+    //
+    // Create the LOGGER task.
+    //
+    if(MEMBUDGET_TASK_CREATE(loggerTask, "LOGGER", g_logger_stack, PRIORITY_LOGGER_TASK) != pdTRUE)
+    {
+        return(1);
+    }
+
+    console_printf("Logger task init.\n");
+
+    //
+    // Success.
+    //
+    return(0);
+}
@@ -0,0 +1,84 @@
+//*****************************************************************************
+//
+// logger.h - Prototypes for the deferred logger
+//
+// Call sites only push a format-ID and raw 32-bit arguments into a RAM ring;
+// the logger task formats (or, with LOGGER_BINARY, tokenizes) them later at
+// low priority. Messages above LOGGER_LEVEL compile out entirely.
+//
+//*****************************************************************************
+
+#ifndef __LOGGER_H__
+#define __LOGGER_H__
+
+#define LOGGER_LEVEL_NONE       0
+#define LOGGER_LEVEL_ERROR      1
+#define LOGGER_LEVEL_WARN       2
+#define LOGGER_LEVEL_INFO       3
+#define LOGGER_LEVEL_DEBUG      4
+
+#ifndef LOGGER_LEVEL
+#define LOGGER_LEVEL            LOGGER_LEVEL_INFO
+#endif
+
+#define LOGGER_MAX_ARGS         6
+
+typedef enum
+{
+#define LOGGER_FMT(id, fmt) id,
+#include "logger_fmt.h"
+#undef LOGGER_FMT
+  LOG_FMT_MAX
+} logger_fmt_t;
+
+//*****************************************************************************
+//
+// Logging macros, arguments are cast to 32-bit words; floats must be wrapped
+// in logger_float().
+//
+//*****************************************************************************
+#define LOGGER_PUSH(id, ...) \
+  logger_push((id), (sizeof((const uint32_t[]){0, ##__VA_ARGS__}) / sizeof(uint32_t)) - 1, \
+              &((const uint32_t[]){0, ##__VA_ARGS__})[1])
+
+#if LOGGER_LEVEL >= LOGGER_LEVEL_ERROR
+#define LOG_ERROR(id, ...) LOGGER_PUSH(id, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(id, ...) do { } while (0)
+#endif
+
+#if LOGGER_LEVEL >= LOGGER_LEVEL_WARN
+#define LOG_WARN(id, ...) LOGGER_PUSH(id, ##__VA_ARGS__)
+#else
+#define LOG_WARN(id, ...) do { } while (0)
+#endif
+
+#if LOGGER_LEVEL >= LOGGER_LEVEL_INFO
+#define LOG_INFO(id, ...) LOGGER_PUSH(id, ##__VA_ARGS__)
+#else
+#define LOG_INFO(id, ...) do { } while (0)
+#endif
+
+#if LOGGER_LEVEL >= LOGGER_LEVEL_DEBUG
+#define LOG_DEBUG(id, ...) LOGGER_PUSH(id, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(id, ...) do { } while (0)
+#endif
+
+static inline uint32_t logger_float(float fv)
+{
+  union { float f; uint32_t u; } v;
+
+  v.f = fv;
+  return(v.u);
+}
+
+//*****************************************************************************
+//
+// Prototypes for the LOGGER
+//
+//*****************************************************************************
+void logger_push(uint8_t id, uint8_t nargs, const uint32_t *args);
+unsigned long loggerTaskInit(void);
+
+#endif // __LOGGER_H__
@@ -0,0 +1,27 @@
+//*****************************************************************************
+//
+// logger_fmt.h - Format table for the deferred logger
+//
+// One LOGGER_FMT(id, format) entry per message. The position in this list is
+// the format-ID that goes into the log ring and into binary log frames, so
+// only ever append; tools/logger_decode.py reads this file to decode them.
+//
+// Conversions: %c %d %i %u %x %X %s (flash-resident strings only) and %f
+// (float passed through logger_float()).
+//
+//*****************************************************************************
+
+LOGGER_FMT(LOG_LOGGER_DROPPED,      "logger: %u messages dropped\n")
+LOGGER_FMT(LOG_STEPPER_SETUP,       "stepper_setup: id %i, velocity %f, accel %f, steps %u, decel_steps %u, sem_pending %i\n")
+LOGGER_FMT(LOG_STEPPER_STOP,        "stepper_stop: index %i\n")
+LOGGER_FMT(LOG_STEPPER_IDLE,        "stepper_idle: index %i\n")
+LOGGER_FMT(LOG_STEPPER_WAITFOR,     "stepper_waitfor: waiting for stepper %i\n")
+LOGGER_FMT(LOG_STEPPER_NOWAIT,      "stepper_waitfor: NOT waiting for stepper %i\n")
+LOGGER_FMT(LOG_PLATFORM_VLIMITER,   "platform_go: vlimiter_%c %f\n")
+LOGGER_FMT(LOG_PLATFORM_NOTHING,    "platform_go: nothing to do\n")
+LOGGER_FMT(LOG_PLATFORM_GO,         "platform_go: velocity %f, velocity_r %f, velocity_l %f, angular_velocity %f, radius %f\n")
+LOGGER_FMT(LOG_PLATFORM_WHEEL,      "platform_go: sps_%c %f, acceleration_%c %f, numsteps_%c %i\n")
+LOGGER_FMT(LOG_PLATFORM_PROFILE,    "platform_go: t_accel %f, t_cruise %f\n")
+LOGGER_FMT(LOG_SCRIPT_START,        "script: slot %u started\n")
+LOGGER_FMT(LOG_SCRIPT_END,          "script: slot %u ended, result %i, %u instructions\n")
+LOGGER_FMT(LOG_STEPPER_LOST,        "stepper_feedback: id %i, %i steps lost, step_count %u\n")
@@ -1,213 +1,279 @@
-//*****************************************************************************
-//
-// freertos_demo.c - Simple FreeRTOS example.
-//
-//*****************************************************************************
-
-#include "inttypes.h"
-#include "inc/hw_memmap.h"
-#include "inc/hw_types.h"
-#include "driverlib/gpio.h"
-#include "driverlib/pin_map.h"
-#include "driverlib/rom.h"
-#include "driverlib/sysctl.h"
-#include "driverlib/uart.h"
-#include "utils/uartstdio.h"
-#include "FreeRTOS.h"
-#include "task.h"
-#include "queue.h"
-#include "semphr.h"
-
-#include "led_task.h"
-#include "shell_task.h"
-#include "switch_task.h"
-#include "stepper.h"
-#include "platform.h"
-#include "timer.h"
-
-//*****************************************************************************
-//
-// The mutex that protects concurrent access of UART from multiple tasks.
-//
-//*****************************************************************************
-xSemaphoreHandle g_pUARTSemaphore;
-
-//*****************************************************************************
-//
-// The error routine that is called if the driver library encounters an error.
-//
-//*****************************************************************************
-#ifdef DEBUG
-void
-__error__(char *pcFilename, unsigned long ulLine)
-{
-}
-
-#endif
-
-//*****************************************************************************
-//
-// This hook is called by FreeRTOS when an stack overflow error is detected.
-//
-//*****************************************************************************
-void
-vApplicationStackOverflowHook(xTaskHandle *pxTask, signed char *pcTaskName)
-{
-    //
-    // This function can not return, so loop forever.  Interrupts are disabled
-    // on entry to this function, so no processor interrupts will interrupt
-    // this loop.
-    //
-    while(1)
-    {
-    }
-}
-
-//*****************************************************************************
-//
-// Initialize FreeRTOS and start the initial set of tasks.
-//
-//*****************************************************************************
-int
-main(void)
-{
-    ROM_FPUEnable();
-    ROM_FPUStackingEnable();
-    ROM_IntMasterDisable();
-
-    //
-    // Set the clocking to run at 66.6 MHz from the PLL.
-    //
-    ROM_SysCtlClockSet(SYSCTL_SYSDIV_3 | SYSCTL_USE_PLL | SYSCTL_XTAL_16MHZ |
-                       SYSCTL_OSC_MAIN);
-
-    //
-    // Initialize the UART and configure it for 115,200, 8-N-1 operation.
-    //
-    ROM_SysCtlPeripheralEnable(SYSCTL_PERIPH_UART0);
-    ROM_SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOA);
-    GPIOPinConfigure(GPIO_PA0_U0RX);
-    GPIOPinConfigure(GPIO_PA1_U0TX);
-    ROM_GPIOPinTypeUART(GPIO_PORTA_BASE, GPIO_PIN_0 | GPIO_PIN_1);
-    UARTStdioInit(0);
-
-    //
-    // Print demo introduction.
-    //
-    UARTprintf("\033[2JStellaris EK-LM4F120 FreeRTOS (sysclk=%u)\n\n", ROM_SysCtlClockGet());
-#if 0
-#if 0
-    UARTprintf("            \\\\\\\\\\\\////// \n");
-    UARTprintf("             \\\\((()))//  \n");
-    UARTprintf("  WOE-      /   \\\\//   \\  \n");
-    UARTprintf("   -BOT   _|     \\/     |_ \n"); 
-    UARTprintf("         ((| \\___  ___/ |)) \n");
-    UARTprintf(" KILLS    \\ > -o-\\/-o- < / \n");
-    UARTprintf("   ALL     |     ..     | \n");
-    UARTprintf("  HUMANS    )   ____   (  \n");
-    UARTprintf(" GOOD    _,'\\          /`._\n");
-    UARTprintf("      ,-'    `-.____.-'    `. \n");
-    UARTprintf("     /         |    |        \\ \n");
-    UARTprintf("    |_|_|_|_|__|____|___|_|_|_| \n");
-    UARTprintf("\n");
-#else
-    UARTprintf("       -+-             .___. \n");
-    UARTprintf("     .--+--.         _/__ /|\n");
-    UARTprintf("     ||[o o]        |____|||\n");
-    UARTprintf("     || ___|         |O O ||\n");
-    UARTprintf("   __`-----'_      __|++++|/__\n");
-    UARTprintf("  |\\ ________\\    /_________ /|\n");
-    UARTprintf("  ||   WOE-  ||   |  nukes   ||\n");
-    UARTprintf("  |||  BOT   ||   || humans |||\n");
-    UARTprintf("  \\||  v1.0  ||   || good   ||/\n");
-    UARTprintf("   VV========VV   VV========VV\n");
-    UARTprintf("   ||       |      |   |   ||\n");
-    UARTprintf("   ||       |      |   |   ||\n");
-    UARTprintf("   \\|___|___|      |___|___|/\n");
-    UARTprintf("     \\___\\___\\     /___/___/\n");
-    UARTprintf("\n");
-#endif
-#endif
-
-    //
-    // Create a mutex to guard the UART.
-    //
-    g_pUARTSemaphore = xSemaphoreCreateMutex();
-
-
-#if 0
-    //
-    // Create the LED task.
-    //
-    if( LEDTaskInit() != 0)
-    {
-        
-        while(1)
-        {
-        }
-    }
-#endif
-#if 0
-    //
-    // Create the STEPPER task.
-    //
-    if(STEPPERTaskInit() != 0)
-    {
-        
-        while(1)
-        {
-        }
-    }
-#endif
-
-#if 0
-    //
-    // Create the switch task.
-    //
-    if(SwitchTaskInit() != 0)
-    {
-        
-        while(1)
-        {
-        }
-    }
-#endif
-
-    timer_init();
-    stepper_init(4);
-    platform_init();
-
-    //UARTprintf("Setting speed!\n");
-    //stepper_speed(0, 100.0f);
-
-#if 1
-    //
-    // Create the SHELL task.
-    //
-    if( shellTaskInit() != 0)
-    {
-        
-        while(1)
-        {
-        }
-    }
-#endif
-
-    ROM_IntMasterDisable();
-
-    UARTprintf("Going multitasking.\n");
-
-    //
-    // Start the scheduler.  This should not return.
-    //
-    vTaskStartScheduler();
-
-    //
-    // In case the scheduler returns for some reason, print an error and loop
-    // forever.
-    //
-
-    while(1)
-    {
-    }
-}
+//*****************************************************************************
+//
+// freertos_demo.c - Simple FreeRTOS example.
+//
+//*****************************************************************************
+
+#include "inttypes.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+#include "driverlib/gpio.h"
+#include "driverlib/pin_map.h"
+#include "driverlib/rom.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/uart.h"
+#include "console.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "led_task.h"
+#include "shell_task.h"
+#include "switch_task.h"
+#include "stepper.h"
+#include "stepper_task.h"
+#include "encoder.h"
+#include "platform.h"
+#include "timer.h"
+#include "logger.h"
+#include "proto.h"
+#include "telemetry.h"
+#include "script.h"
+#include "cpuload.h"
+#include "membudget.h"
+#include "event.h"
+#include "clock.h"
+
+//*****************************************************************************
+//
+// The error routine that is called if the driver library encounters an error.
+//
+//*****************************************************************************
+#ifdef DEBUG
+void
+__error__(char *pcFilename, unsigned long ulLine)
+{
+}
+
+#endif
+
+//*****************************************************************************
+//
+// This hook is called by FreeRTOS when an stack overflow error is detected.
+//
+//*****************************************************************************
+void
+vApplicationStackOverflowHook(xTaskHandle *pxTask, signed char *pcTaskName)
+{
+    //
+    // This function can not return, so loop forever.  Interrupts are disabled
+    // on entry to this function, so no processor interrupts will interrupt
+    // this loop.
+    //
+    while(1)
+    {
+    }
+}
+
+//*****************************************************************************
+//
+// Initialize FreeRTOS and start the initial set of tasks.
+//
+//*****************************************************************************
+int
+main(void)
+{
+    ROM_FPUEnable();
+    ROM_FPUStackingEnable();
+    ROM_IntMasterDisable();
+
+    //
+    // Set the clocking to run at 66.6 MHz from the PLL.
+    //
+    clock_init();
+
+    //
+    // Initialize the UART console for 115,200, 8-N-1 operation.
+    //
+    console_init(115200);
+
+    //
+    // Print demo introduction.
+    //
+    console_printf("\033[2JStellaris EK-LM4F120 FreeRTOS (sysclk=%u)\n\n", g_clock.hz);
+#if 0
+#if 0
+    console_printf("            \\\\\\\\\\\\////// \n");
+    console_printf("             \\\\((()))//  \n");
+    console_printf("  WOE-      /   \\\\//   \\  \n");
+    console_printf("   -BOT   _|     \\/     |_ \n"); 
+    console_printf("         ((| \\___  ___/ |)) \n");
+    console_printf(" KILLS    \\ > -o-\\/-o- < / \n");
+    console_printf("   ALL     |     ..     | \n");
+    console_printf("  HUMANS    )   ____   (  \n");
+    console_printf(" GOOD    _,'\\          /`._\n");
+    console_printf("      ,-'    `-.____.-'    `. \n");
+    console_printf("     /         |    |        \\ \n");
+    console_printf("    |_|_|_|_|__|____|___|_|_|_| \n");
+    console_printf("\n");
+#else
+    console_printf("       -+-             .___. \n");
+    console_printf("     .--+--.         _/__ /|\n");
+    console_printf("     ||[o o]        |____|||\n");
+    console_printf("     || ___|         |O O ||\n");
+    console_printf("   __`-----'_      __|++++|/__\n");
+    console_printf("  |\\ ________\\    /_________ /|\n");
+    console_printf("  ||   WOE-  ||   |  nukes   ||\n");
+    console_printf("  |||  BOT   ||   || humans |||\n");
+    console_printf("  \\||  v1.0  ||   || good   ||/\n");
+    console_printf("   VV========VV   VV========VV\n");
+    console_printf("   ||       |      |   |   ||\n");
+    console_printf("   ||       |      |   |   ||\n");
+    console_printf("   \\|___|___|      |___|___|/\n");
+    console_printf("     \\___\\___\\     /___/___/\n");
+    console_printf("\n");
+#endif
+#endif
+
+    //
+    // Start CPU load accounting before the first task is created.
+    //
+    cpuload_init();
+
+    //
+    // Create the EVENT task, the modules below register their handlers on it.
+    //
+    if(eventTaskInit() != 0)
+    {
+        
+        while(1)
+        {
+        }
+    }
+
+    //
+    // Start blinking the LED.
+    //
+    if(LEDInit() != 0)
+    {
+        
+        while(1)
+        {
+        }
+    }
+
+    //
+    // Start polling the switches.
+    //
+    if(SwitchInit() != 0)
+    {
+        
+        while(1)
+        {
+        }
+    }
+
+    //
+    // Let "top" refresh from an event timer.
+    //
+    if(cpuload_top_init() != 0)
+    {
+        
+        while(1)
+        {
+        }
+    }
+
+    //
+    // Create the LOGGER task.
+    //
+    if(loggerTaskInit() != 0)
+    {
+        
+        while(1)
+        {
+        }
+    }
+
+    timer_init();
+    stepper_init(4);
+    encoder_init();
+    platform_init();
+
+    //
+    // Create the STEPPER planner task.
+    //
+    if(stepperTaskInit() != 0)
+    {
+        
+        while(1)
+        {
+        }
+    }
+
+    //console_printf("Setting speed!\n");
+    //stepper_speed(0, 100.0f);
+
+    //
+    // Create the PROTO task.
+    //
+    if(protoTaskInit() != 0)
+    {
+        
+        while(1)
+        {
+        }
+    }
+
+    //
+    // Create the SCRIPT task.
+    //
+    if(scriptTaskInit() != 0)
+    {
+        
+        while(1)
+        {
+        }
+    }
+
+    //
+    // Create the TELEMETRY task.
+    //
+    if(telemetryTaskInit() != 0)
+    {
+        
+        while(1)
+        {
+        }
+    }
+
+    //
+    // Start the SHELL.
+    //
+    if(shellInit() != 0)
+    {
+        
+        while(1)
+        {
+        }
+    }
+
+    //
+    // Make sure the kernel can still create the idle task.
+    //
+    if(membudget_check() != 0)
+    {
+        
+        while(1)
+        {
+        }
+    }
+
+    ROM_IntMasterDisable();
+
+    console_printf("Going multitasking.\n");
+
+    //
+    // Start the scheduler.  This should not return.
+    //
+    vTaskStartScheduler();
+
+    //
+    // In case the scheduler returns for some reason, print an error and loop
+    // forever.
+    //
+
+    while(1)
+    {
+    }
+}
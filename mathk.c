@@ -0,0 +1,169 @@
+//*****************************************************************************
+//
+// mathk.c - Small integer and fixed-point math kernels for the motion code
+//
+//*****************************************************************************
+
+#include <inttypes.h>
+
+#include "inc/hw_types.h"
+
+#include "console.h"
+#include "cpuload.h"
+#include "shell_task.h"
+#include "mathk.h"
+
+// floor(sqrt(x)), one iteration per root bit from the top set bit down
+uint32_t mathk_isqrt(uint32_t x)
+{
+    uint32_t root = 0;
+    uint32_t bit;
+
+    if (x == 0)
+    {
+        return(0);
+    }
+
+    // highest power of four <= x
+    bit = 1UL << ((31 - __builtin_clz(x)) & ~1);
+
+    while (bit != 0)
+    {
+        if (x >= root + bit)
+        {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+
+        bit >>= 2;
+    }
+
+    return(root);
+}
+
+// d != 0
+void mathk_recip_init(mathk_recip_t *r, uint32_t d)
+{
+    uint32_t dn, x;
+    uint8_t i;
+
+    r->d = d;
+    r->shift = __builtin_clz(d);
+
+    // normalized divisor D = dn / 2^32 in [0.5, 1)
+    dn = d << r->shift;
+
+    // 48/17 - 32/17 D is within 1/17 of 1/D, three Newton steps
+    // x = x (2 - D x) take that past the Q30 resolution
+    x = 3031741621UL - (uint32_t)(((uint64_t)dn * 2021161081UL) >> 32);
+
+    for (i=0; i<3; i++)
+    {
+        uint32_t e = (1UL << 31) - (uint32_t)(((uint64_t)dn * x) >> 32);
+
+        x = (uint32_t)(((uint64_t)x * e) >> 30);
+    }
+
+    r->x = x;
+}
+
+// n / d, exact
+uint32_t mathk_recip_div(const mathk_recip_t *r, uint32_t n)
+{
+    uint32_t q = (uint32_t)(((uint64_t)n * r->x) >> (62 - r->shift));
+    int64_t rem = (int64_t)n - (int64_t)q * r->d;
+
+    // the Q30 estimate is off by a few at most
+    while (rem < 0)
+    {
+        q--;
+        rem += r->d;
+    }
+
+    while (rem >= r->d)
+    {
+        q++;
+        rem -= r->d;
+    }
+
+    return(q);
+}
+
+static int32_t mathk_sat32(int64_t a)
+{
+    return((a > INT32_MAX) ? INT32_MAX : (a < INT32_MIN) ? INT32_MIN : (int32_t)a);
+}
+
+// Q16.16 a * b, rounded toward -inf, saturated
+int32_t mathk_q16_mul(int32_t a, int32_t b)
+{
+    return(mathk_sat32(((int64_t)a * b) >> 16));
+}
+
+// Q16.16 a / b, rounded toward zero, saturated; b == 0 saturates by sign of a
+int32_t mathk_q16_div(int32_t a, int32_t b)
+{
+    if (b == 0)
+    {
+        return((a < 0) ? INT32_MIN : INT32_MAX);
+    }
+
+    return(mathk_sat32(((int64_t)a << 16) / b));
+}
+
+//*****************************************************************************
+//
+// Shell commands.
+//
+//*****************************************************************************
+#define MATHK_BENCH_N           256
+
+// average cycles per call over MATHK_BENCH_N varying inputs, less the loop
+#define MATHK_BENCH(name, ref, expr)                                        \
+    do {                                                                    \
+        seed = 1;                                                           \
+        start = cpuload_cycles();                                           \
+        for (i=0; i<MATHK_BENCH_N; i++)                                     \
+        {                                                                   \
+            seed = (seed * 1664525) + 1013904223;                           \
+            sink += (expr);                                                 \
+        }                                                                   \
+        cycles = cpuload_cycles() - start;                                  \
+        console_printf("%-24s %-20s %6.1f\n", name, ref,                    \
+                       (float)(int32_t)(cycles - base) / MATHK_BENCH_N);    \
+    } while (0)
+
+static void mathk_cmd_bench(const shell_arg_t *arg)
+{
+    volatile uint32_t sink = 0;
+    volatile float fsink = 0;
+    mathk_recip_t recip;
+    uint32_t seed, start, cycles, base = 0;
+    uint16_t i;
+
+    mathk_recip_init(&recip, 66666);
+
+    MATHK_BENCH("(loop)", "", seed);
+    base = cycles;
+
+    console_printf("%-24s %-20s %6s\n", "kernel", "replaces", "cycles");
+    MATHK_BENCH("mathk_isqrt(x >> 16)", "isqrt.c bit loop", mathk_isqrt(seed >> 16));
+    MATHK_BENCH("mathk_isqrt(x)", "", mathk_isqrt(seed));
+    MATHK_BENCH("mathk_recip_div", "x / 66666", mathk_recip_div(&recip, seed));
+    MATHK_BENCH("x / 66666", "", seed / 66666);
+    MATHK_BENCH("mathk_q16_mul", "", mathk_q16_mul(seed, seed >> 8));
+    MATHK_BENCH("mathk_q16_div", "", mathk_q16_div(seed, (seed >> 12) | 1));
+    MATHK_BENCH("mathk_usat16", "MIN(65535, x)", mathk_usat16(seed));
+    MATHK_BENCH("mathk_qadd", "", mathk_qadd(seed, 0x40000000));
+    MATHK_BENCH("mathk_sqrtf", "sqrtf", (fsink = mathk_sqrtf((float)seed), 0));
+    MATHK_BENCH("sqrtf", "", (fsink = sqrtf((float)seed), 0));
+    MATHK_BENCH("float divide", "", (fsink = 66666666.0f / (float)(seed | 1), 0));
+
+    (void)fsink;
+}
+
+SHELL_COMMAND(mbench, "mbench", "", "(math kernel cycle counts)", mathk_cmd_bench);
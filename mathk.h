@@ -0,0 +1,104 @@
+//*****************************************************************************
+//
+// mathk.h - Small integer and fixed-point math kernels for the motion code
+//
+// mathk_isqrt() starts at the highest set bit instead of looping over all
+// sixteen root bits. A mathk_recip_t holds a Newton-Raphson reciprocal so a
+// divisor used many times costs one multiply per divide. The Q16.16 helpers
+// saturate instead of wrapping. On the Cortex-M4 the saturating add and
+// clamp use QADD and USAT/SSAT and the float square root is a single VSQRT;
+// elsewhere (host builds) portable C is used.
+//
+// Of these only mathk_usat16() is on a motion path, clamping the reclocked
+// step timers. The rest have no callers beyond "mbench" and
+// test/mathk_test.c and stay in flash until one does.
+//
+//*****************************************************************************
+
+#ifndef __MATHK_H__
+#define __MATHK_H__
+
+#include <math.h>
+
+#if defined(__ARM_FEATURE_DSP) || defined(__ARM_ARCH_7EM__)
+#define MATHK_DSP               1
+#else
+#define MATHK_DSP               0
+#endif
+
+#define MATHK_Q16_ONE           (1L << 16)
+#define MATHK_Q16(f)            ((int32_t)((f) * MATHK_Q16_ONE))
+
+typedef struct
+{
+  uint32_t d;
+  uint32_t x;           // 1 / normalized d, Q30
+  uint8_t  shift;       // leading zeros of d
+} mathk_recip_t;
+
+// saturating 32-bit add
+static inline int32_t mathk_qadd(int32_t a, int32_t b)
+{
+#if MATHK_DSP
+    int32_t r;
+
+    __asm("qadd %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+    return(r);
+#else
+    int64_t r = (int64_t)a + b;
+
+    return((r > INT32_MAX) ? INT32_MAX : (r < INT32_MIN) ? INT32_MIN : (int32_t)r);
+#endif
+}
+
+// clamp to [0, 65535], e.g. a 16-bit timer load
+static inline uint32_t mathk_usat16(int32_t a)
+{
+#if MATHK_DSP
+    uint32_t r;
+
+    __asm("usat %0, #16, %1" : "=r" (r) : "r" (a));
+    return(r);
+#else
+    return((a < 0) ? 0 : (a > 65535) ? 65535 : (uint32_t)a);
+#endif
+}
+
+// clamp to [-32768, 32767]
+static inline int32_t mathk_ssat16(int32_t a)
+{
+#if MATHK_DSP
+    int32_t r;
+
+    __asm("ssat %0, #16, %1" : "=r" (r) : "r" (a));
+    return(r);
+#else
+    return((a < -32768) ? -32768 : (a > 32767) ? 32767 : a);
+#endif
+}
+
+// square root without the errno path sqrtf() carries, NaN for x < 0
+static inline float mathk_sqrtf(float x)
+{
+#if defined(__ARM_FP)
+    float r;
+
+    __asm("vsqrt.f32 %0, %1" : "=t" (r) : "t" (x));
+    return(r);
+#else
+    return(sqrtf(x));
+#endif
+}
+
+//*****************************************************************************
+//
+// Prototypes for the MATHK
+//
+//*****************************************************************************
+uint32_t mathk_isqrt(uint32_t x);
+void mathk_recip_init(mathk_recip_t *r, uint32_t d);
+uint32_t mathk_recip_div(const mathk_recip_t *r, uint32_t n);
+int32_t mathk_q16_mul(int32_t a, int32_t b);
+int32_t mathk_q16_div(int32_t a, int32_t b);
+
+#endif // __MATHK_H__
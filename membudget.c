@@ -0,0 +1,118 @@
+//*****************************************************************************
+//
+// membudget.c - Static task stacks and the SRAM budget
+//
+//*****************************************************************************
+
+#include <inttypes.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "console.h"
+#include "shell_task.h"
+#include "membudget.h"
+
+//*****************************************************************************
+//
+// Linker symbols, see out.ld.
+//
+//*****************************************************************************
+extern unsigned long _data;
+extern unsigned long _edata;
+extern unsigned long _bss;
+extern unsigned long _ebss;
+extern unsigned long _stacks;
+extern unsigned long _estacks;
+extern unsigned long _sram_end;
+
+typedef struct {
+    const char     *name;
+    xTaskHandle     handle;
+    unsigned short  words;
+} membudget_task_t;
+
+static membudget_task_t g_tasks[MEMBUDGET_MAX_TASKS];
+static uint8_t g_ntasks;
+
+#define SECTION_SIZE(start, end) ((unsigned long)&(end) - (unsigned long)&(start))
+
+//*****************************************************************************
+//
+// Create a task on a MEMBUDGET_STACK() and remember it for the report.
+//
+//*****************************************************************************
+signed portBASE_TYPE membudget_task_create(pdTASK_CODE code, const char *name, portSTACK_TYPE *stack,
+                                           unsigned short words, unsigned portBASE_TYPE priority)
+{
+    xTaskHandle handle;
+    signed portBASE_TYPE result;
+
+    result = xTaskGenericCreate(code, (const signed char *)name, words, NULL,
+                                tskIDLE_PRIORITY + priority, &handle, stack, NULL);
+
+    if ((result == pdTRUE) && (g_ntasks < MEMBUDGET_MAX_TASKS))
+    {
+        g_tasks[g_ntasks].name = name;
+        g_tasks[g_ntasks].handle = handle;
+        g_tasks[g_ntasks].words = words;
+        g_ntasks++;
+    }
+
+    return(result);
+}
+
+void membudget_report(void)
+{
+    unsigned long used;
+    uint8_t i;
+
+    console_printf("sram: data %u, bss %u, stacks %u, heap %u, unused %u (of %u)\n",
+                   SECTION_SIZE(_data, _edata), SECTION_SIZE(_bss, _ebss),
+                   SECTION_SIZE(_stacks, _estacks), configTOTAL_HEAP_SIZE,
+                   SECTION_SIZE(_estacks, _sram_end),
+                   (unsigned long)&_sram_end - (unsigned long)&_data);
+
+    console_printf("heap: %u free of %u\n", xPortGetFreeHeapSize(), configTOTAL_HEAP_SIZE);
+
+    console_printf("%-12s %6s %6s %6s\n", "stack", "words", "used", "free");
+
+    for (i=0; i<g_ntasks; i++)
+    {
+        used = g_tasks[i].words - uxTaskGetStackHighWaterMark(g_tasks[i].handle);
+
+        console_printf("%-12s %6u %6u %6u\n", g_tasks[i].name, g_tasks[i].words,
+                       used, g_tasks[i].words - used);
+    }
+}
+
+//*****************************************************************************
+//
+// Called after all tasks are created, before vTaskStartScheduler(). Returns
+// nonzero (after printing the report) if the heap is too small.
+//
+//*****************************************************************************
+unsigned long membudget_check(void)
+{
+    if (xPortGetFreeHeapSize() < (MEMBUDGET_IDLE_RESERVE + MEMBUDGET_HEAP_MARGIN))
+    {
+        console_printf("RAM budget exceeded: heap %u free, need %u\n", xPortGetFreeHeapSize(),
+                       MEMBUDGET_IDLE_RESERVE + MEMBUDGET_HEAP_MARGIN);
+        membudget_report();
+        return(1);
+    }
+
+    return(0);
+}
+
+//*****************************************************************************
+//
+// Shell commands.
+//
+//*****************************************************************************
+static void membudget_cmd_report(const shell_arg_t *arg)
+{
+    membudget_report();
+}
+
+SHELL_COMMAND(mem, "mem", "", "(ram usage)", membudget_cmd_report);
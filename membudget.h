@@ -0,0 +1,44 @@
+//*****************************************************************************
+//
+// membudget.h - Static task stacks and the SRAM budget
+//
+// Task stacks are declared with MEMBUDGET_STACK() and land in the .stacks
+// section (see out.ld), so the link map shows every one of them by name and
+// the kernel heap only carries TCBs, queues and semaphores. tools/
+// ram_report.py breaks the map down by subsystem, "mem" reports usage at
+// run time and membudget_check() refuses to start the scheduler when the
+// heap cannot hold what the kernel still has to allocate.
+//
+//*****************************************************************************
+
+#ifndef __MEMBUDGET_H__
+#define __MEMBUDGET_H__
+
+#define MEMBUDGET_MAX_TASKS     8
+
+//
+// The idle task is created by vTaskStartScheduler(): TCB and stack from
+// the heap, plus a block header each.
+//
+#define MEMBUDGET_IDLE_RESERVE  ((configMINIMAL_STACK_SIZE * sizeof(portSTACK_TYPE)) + 128)
+
+// what must be left on the heap once the scheduler runs
+#define MEMBUDGET_HEAP_MARGIN   256
+
+#define MEMBUDGET_STACK(buf, words) \
+    static portSTACK_TYPE buf[words] __attribute__((section(".stack." #buf), aligned(8)))
+
+#define MEMBUDGET_TASK_CREATE(code, name, buf, prio) \
+    membudget_task_create((code), (name), (buf), sizeof(buf) / sizeof(portSTACK_TYPE), (prio))
+
+//*****************************************************************************
+//
+// Prototypes for the MEMBUDGET
+//
+//*****************************************************************************
+signed portBASE_TYPE membudget_task_create(pdTASK_CODE code, const char *name, portSTACK_TYPE *stack,
+                                           unsigned short words, unsigned portBASE_TYPE priority);
+void membudget_report(void);
+unsigned long membudget_check(void);
+
+#endif // __MEMBUDGET_H__
@@ -0,0 +1,733 @@
+//*****************************************************************************
+//
+// numio.c - Integer-only decimal formatting and parsing
+//
+//*****************************************************************************
+
+#include <errno.h>
+#include <string.h>
+
+#include "numio.h"
+
+#define NUMIO_MAX_DIGITS        19          // significant digits kept in a uint64_t
+#define NUMIO_MAX_POW10         18          // largest power of ten below 2^63
+#define NUMIO_MAX_POW5          27          // largest power of five below 2^63
+#define NUMIO_MAX_POW5_32       13          // largest power of five below 2^32
+#define NUMIO_BIG_WORDS         6           // 192-bit numio_strtof() operands
+
+// decimal magnitudes outside of which floats overflow or flush to zero
+#define NUMIO_FLT_MAX10         38
+#define NUMIO_FLT_MIN10         -37
+
+static const uint64_t g_pow10[NUMIO_MAX_POW10 + 1] =
+{
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL
+};
+
+static const uint64_t g_pow5[NUMIO_MAX_POW5 + 1] =
+{
+    1ULL, 5ULL, 25ULL, 125ULL, 625ULL, 3125ULL, 15625ULL, 78125ULL,
+    390625ULL, 1953125ULL, 9765625ULL, 48828125ULL, 244140625ULL,
+    1220703125ULL, 6103515625ULL, 30517578125ULL, 152587890625ULL,
+    762939453125ULL, 3814697265625ULL, 19073486328125ULL,
+    95367431640625ULL, 476837158203125ULL, 2384185791015625ULL,
+    11920928955078125ULL, 59604644775390625ULL, 298023223876953125ULL,
+    1490116119384765625ULL, 7450580596923828125ULL
+};
+
+//*****************************************************************************
+//
+// Formatting.
+//
+//*****************************************************************************
+
+// digits of a multi-word (little endian) unsigned integer, reversed into tmp
+static uint8_t numio_utoa_rev(char *tmp, uint32_t *word, uint8_t words)
+{
+    uint8_t n = 0;
+    uint8_t i;
+
+    while ((words > 1) && (word[words - 1] == 0))
+    {
+        words--;
+    }
+
+    // long division by 10^9, nine digits per pass
+    while (words > 1)
+    {
+        uint32_t rem = 0;
+
+        for (i = words; i-- > 0; )
+        {
+            uint64_t cur = ((uint64_t)rem << 32) | word[i];
+
+            word[i] = (uint32_t)(cur / 1000000000UL);
+            rem = (uint32_t)(cur % 1000000000UL);
+        }
+
+        for (i = 0; i < 9; i++)
+        {
+            tmp[n++] = '0' + (rem % 10);
+            rem /= 10;
+        }
+
+        while ((words > 1) && (word[words - 1] == 0))
+        {
+            words--;
+        }
+    }
+
+    do
+    {
+        tmp[n++] = '0' + (word[0] % 10);
+        word[0] /= 10;
+    } while (word[0] != 0);
+
+    return(n);
+}
+
+//
+// Print sign, integer part and 'decimals' digits of frac / 2^shift, rounded
+// half even. frac must be below 2^31 so frac * 10^9 fits in 64 bits.
+//
+static uint8_t numio_format(char *buf, uint8_t neg, uint32_t *ipart, uint8_t words,
+                            uint32_t frac, uint8_t shift, uint8_t decimals, uint8_t flags)
+{
+    char tmp[40];
+    uint32_t scale;
+    uint64_t q = 0;
+    uint8_t len = 0;
+    uint8_t n;
+
+    if (decimals > NUMIO_MAX_DECIMALS)
+    {
+        decimals = NUMIO_MAX_DECIMALS;
+    }
+
+    scale = (uint32_t)g_pow10[decimals];
+
+    if (shift != 0)
+    {
+        uint64_t scaled = (uint64_t)frac * scale;
+        uint64_t half = 1ULL << (shift - 1);
+        uint64_t rem;
+
+        q = scaled >> shift;
+        rem = scaled & ((half << 1) - 1);
+
+        // ties go to the even last printed digit
+        if ((rem > half) || ((rem == half) && ((decimals ? q : ipart[0]) & 1)))
+        {
+            q++;
+        }
+
+        // carry into the integer part, it has room to spare
+        if (q == scale)
+        {
+            q = 0;
+            for (n = 0; (n < words) && (++ipart[n] == 0); n++)
+            {
+            }
+        }
+    }
+
+    if (neg)
+    {
+        buf[len++] = '-';
+    }
+    else if (flags & NUMIO_PLUS)
+    {
+        buf[len++] = '+';
+    }
+
+    n = numio_utoa_rev(tmp, ipart, words);
+    while (n != 0)
+    {
+        buf[len++] = tmp[--n];
+    }
+
+    if (decimals != 0)
+    {
+        buf[len++] = '.';
+
+        for (n = decimals; n-- > 0; )
+        {
+            buf[len + n] = '0' + (uint32_t)(q % 10);
+            q /= 10;
+        }
+        len += decimals;
+    }
+
+    buf[len] = '\0';
+
+    return(len);
+}
+
+//*****************************************************************************
+//
+// Format a float with a fixed number of decimals (at most NUMIO_MAX_DECIMALS)
+// into buf, which must hold NUMIO_BUFSIZE bytes. Returns the length.
+//
+//*****************************************************************************
+uint8_t numio_ftoa(char *buf, float value, uint8_t decimals, uint8_t flags)
+{
+    uint32_t ipart[4] = { 0, 0, 0, 0 };
+    uint32_t bits, mant;
+    uint8_t neg;
+    int16_t exp;
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    neg = bits >> 31;
+    exp = (bits >> 23) & 0xff;
+    mant = bits & 0x7fffff;
+
+    if (exp == 0xff)
+    {
+        strcpy(buf, mant ? "nan" : (neg ? "-inf" : ((flags & NUMIO_PLUS) ? "+inf" : "inf")));
+        return(strlen(buf));
+    }
+
+    // value = mant * 2^exp
+    if (exp == 0)
+    {
+        exp = -149;
+    }
+    else
+    {
+        mant |= 1UL << 23;
+        exp -= 150;
+    }
+
+    if (exp >= 0)
+    {
+        // up to 2^128, spread over four words
+        uint8_t word = exp >> 5;
+        uint8_t bit = exp & 31;
+
+        ipart[word] = mant << bit;
+        if ((bit != 0) && (word < 3))
+        {
+            ipart[word + 1] = mant >> (32 - bit);
+        }
+
+        return(numio_format(buf, neg, ipart, 4, 0, 0, decimals, flags));
+    }
+
+    if (exp > -24)
+    {
+        ipart[0] = mant >> -exp;
+        return(numio_format(buf, neg, ipart, 1, mant & ((1UL << -exp) - 1), -exp, decimals, flags));
+    }
+
+    // below one; mant * 10^9 / 2^64 rounds to zero, no need to go further
+    if (exp < -63)
+    {
+        return(numio_format(buf, neg, ipart, 1, 0, 0, decimals, flags));
+    }
+
+    return(numio_format(buf, neg, ipart, 1, mant, -exp, decimals, flags));
+}
+
+//*****************************************************************************
+//
+// Format a signed fixed-point value with frac_bits (at most 31) fraction
+// bits, same rules as numio_ftoa().
+//
+//*****************************************************************************
+uint8_t numio_qtoa(char *buf, int32_t value, uint8_t frac_bits, uint8_t decimals, uint8_t flags)
+{
+    uint32_t mag = (value < 0) ? (0 - (uint32_t)value) : (uint32_t)value;
+    uint32_t ipart;
+
+    if (frac_bits > 31)
+    {
+        frac_bits = 31;
+    }
+
+    ipart = (frac_bits == 31) ? (mag >> 31) : (mag >> frac_bits);
+
+    return(numio_format(buf, value < 0, &ipart, 1, mag & ((1UL << frac_bits) - 1),
+                        frac_bits, decimals, flags));
+}
+
+//*****************************************************************************
+//
+// Parsing.
+//
+//*****************************************************************************
+typedef struct {
+    uint64_t digits;    // significant digits
+    int16_t  exp10;     // value = digits * 10^exp10
+    uint8_t  sticky;    // nonzero digits were dropped
+    uint8_t  neg;
+} numio_dec_t;
+
+// [ws][+-]digits[.digits][(e|E)[+-]digits], returns 0 if there are no digits
+static uint8_t numio_scan(const char *str, char **endptr, numio_dec_t *dec)
+{
+    const char *p = str;
+    uint8_t ndigits = 0;
+    uint8_t seen = 0;
+    uint8_t point = 0;
+
+    memset(dec, 0, sizeof(*dec));
+
+    while ((*p == ' ') || (*p == '\t'))
+    {
+        p++;
+    }
+
+    if ((*p == '-') || (*p == '+'))
+    {
+        dec->neg = (*p++ == '-');
+    }
+
+    for ( ; ; p++)
+    {
+        if ((*p == '.') && !point)
+        {
+            point = 1;
+            continue;
+        }
+
+        if ((*p < '0') || (*p > '9'))
+        {
+            break;
+        }
+
+        seen = 1;
+
+        if ((ndigits == 0) && (*p == '0'))
+        {
+            // leading zero, only moves the point
+            dec->exp10 -= point;
+        }
+        else if (ndigits < NUMIO_MAX_DIGITS)
+        {
+            dec->digits = (dec->digits * 10) + (*p - '0');
+            dec->exp10 -= point;
+            ndigits++;
+        }
+        else
+        {
+            dec->exp10 += !point;
+            dec->sticky |= (*p != '0');
+        }
+    }
+
+    if (!seen)
+    {
+        if (endptr)
+        {
+            *endptr = (char *)str;
+        }
+        return(0);
+    }
+
+    if ((*p == 'e') || (*p == 'E'))
+    {
+        const char *e = p + 1;
+        uint8_t eneg = 0;
+        int16_t exp = 0;
+
+        if ((*e == '-') || (*e == '+'))
+        {
+            eneg = (*e++ == '-');
+        }
+
+        if ((*e >= '0') && (*e <= '9'))
+        {
+            while ((*e >= '0') && (*e <= '9'))
+            {
+                if (exp < 1000)
+                {
+                    exp = (exp * 10) + (*e - '0');
+                }
+                e++;
+            }
+
+            dec->exp10 += eneg ? -exp : exp;
+            p = e;
+        }
+    }
+
+    if (endptr)
+    {
+        *endptr = (char *)p;
+    }
+
+    return(1);
+}
+
+//
+// Big unsigned integers, little endian 32-bit words, wide enough for the
+// largest numerator and denominator numio_strtof() builds: 19 digits times
+// 5^39, or 5^57 shifted left by 26 bits.
+//
+static void numio_big_set(uint32_t *big, uint64_t value)
+{
+    memset(big, 0, NUMIO_BIG_WORDS * sizeof(uint32_t));
+    big[0] = (uint32_t)value;
+    big[1] = (uint32_t)(value >> 32);
+}
+
+static void numio_big_mul(uint32_t *big, uint32_t m)
+{
+    uint64_t carry = 0;
+    uint8_t i;
+
+    for (i = 0; i < NUMIO_BIG_WORDS; i++)
+    {
+        carry += (uint64_t)big[i] * m;
+        big[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+}
+
+static void numio_big_mul_pow5(uint32_t *big, uint8_t k)
+{
+    for ( ; k > NUMIO_MAX_POW5_32; k -= NUMIO_MAX_POW5_32)
+    {
+        numio_big_mul(big, (uint32_t)g_pow5[NUMIO_MAX_POW5_32]);
+    }
+    numio_big_mul(big, (uint32_t)g_pow5[k]);
+}
+
+static void numio_big_shl(uint32_t *big, uint16_t shift)
+{
+    uint8_t words = shift >> 5;
+    uint8_t bits = shift & 31;
+    uint8_t i;
+
+    for (i = NUMIO_BIG_WORDS; i-- > 0; )
+    {
+        uint32_t hi = (i >= words) ? big[i - words] : 0;
+        uint32_t lo = (i > words) ? big[i - words - 1] : 0;
+
+        big[i] = bits ? ((hi << bits) | (lo >> (32 - bits))) : hi;
+    }
+}
+
+static void numio_big_shr1(uint32_t *big)
+{
+    uint8_t i;
+
+    for (i = 0; i < NUMIO_BIG_WORDS - 1; i++)
+    {
+        big[i] = (big[i] >> 1) | (big[i + 1] << 31);
+    }
+    big[i] >>= 1;
+}
+
+// a -= b if a >= b, 1 if it did
+static uint8_t numio_big_sub(uint32_t *a, const uint32_t *b)
+{
+    uint64_t borrow = 0;
+    uint32_t diff[NUMIO_BIG_WORDS];
+    uint8_t i;
+
+    for (i = 0; i < NUMIO_BIG_WORDS; i++)
+    {
+        uint64_t d = (uint64_t)a[i] - b[i] - borrow;
+
+        diff[i] = (uint32_t)d;
+        borrow = (d >> 32) & 1;
+    }
+
+    if (borrow)
+    {
+        return(0);
+    }
+
+    memcpy(a, diff, sizeof(diff));
+    return(1);
+}
+
+static uint16_t numio_big_bits(const uint32_t *big)
+{
+    uint8_t i;
+
+    for (i = NUMIO_BIG_WORDS; i-- > 0; )
+    {
+        if (big[i] != 0)
+        {
+            return((i * 32) + 32 - __builtin_clz(big[i]));
+        }
+    }
+
+    return(0);
+}
+
+//
+// Round q * 2^exp, q in [2^25, 2^27) with sticky marking a nonzero tail
+// below it, half even to a float.
+//
+static float numio_round(uint32_t q, int16_t exp, uint8_t sticky, uint8_t neg)
+{
+    uint32_t mant, bits;
+    float value;
+
+    if (q >= (1UL << 26))
+    {
+        sticky |= q & 1;
+        q >>= 1;
+        exp++;
+    }
+
+    mant = q >> 2;
+    if ((q & 2) && ((q & 1) || sticky || (mant & 1)))
+    {
+        mant++;
+        if (mant == (1UL << 24))
+        {
+            mant >>= 1;
+            exp++;
+        }
+    }
+
+    // value = mant * 2^(exp + 2), mant in [2^23, 2^24)
+    exp += 2 + 23 + 127;
+
+    if (exp >= 0xff)
+    {
+        errno = ERANGE;
+        bits = 0xff << 23;
+    }
+    else if (exp <= 0)
+    {
+        // no subnormals
+        errno = ERANGE;
+        bits = 0;
+    }
+    else
+    {
+        bits = ((uint32_t)exp << 23) | (mant & 0x7fffff);
+    }
+
+    bits |= (uint32_t)neg << 31;
+    memcpy(&value, &bits, sizeof(value));
+
+    return(value);
+}
+
+//
+// Correctly rounded float of (num / den) * 2^exp, den below 2^63, by 64-bit
+// long division: the common case of a few digits and a small exponent.
+//
+static float numio_pack(uint64_t num, uint64_t den, int16_t exp, uint8_t sticky, uint8_t neg)
+{
+    uint64_t q = num / den;
+    uint64_t rem = num % den;
+
+    if (q >= (1ULL << 26))
+    {
+        uint8_t shift = (64 - __builtin_clzll(q)) - 26;
+
+        sticky |= ((q & ((1ULL << shift) - 1)) != 0) || (rem != 0);
+        q >>= shift;
+        exp += shift;
+    }
+    else
+    {
+        // den < 2^63 so rem << 1 cannot overflow
+        while (q < (1ULL << 25))
+        {
+            rem <<= 1;
+            q <<= 1;
+            if (rem >= den)
+            {
+                rem -= den;
+                q |= 1;
+            }
+            exp--;
+        }
+        sticky |= (rem != 0);
+    }
+
+    return(numio_round((uint32_t)q, exp, sticky, neg));
+}
+
+//
+// The same in big integers, for the rest of the float range. num and den
+// are lined up so the quotient has 26 or 27 bits; num and den are
+// clobbered.
+//
+static float numio_pack_big(uint32_t *num, uint32_t *den, int16_t exp, uint8_t sticky, uint8_t neg)
+{
+    uint32_t q = 0;
+    int16_t shift;
+    uint8_t i;
+
+    shift = numio_big_bits(den) - numio_big_bits(num) + 26;
+    if (shift >= 0)
+    {
+        numio_big_shl(num, shift);
+    }
+    else
+    {
+        numio_big_shl(den, -shift);
+    }
+    exp -= shift;
+
+    // num / den in (2^25, 2^27)
+    numio_big_shl(den, 26);
+    for (i = 0; i < 27; i++)
+    {
+        q = (q << 1) | numio_big_sub(num, den);
+        numio_big_shr1(den);
+    }
+
+    return(numio_round(q, exp, sticky | (numio_big_bits(num) != 0), neg));
+}
+
+//*****************************************************************************
+//
+// strtof() replacement. digits * 10^k is taken as digits * 5^k * 2^k, or
+// digits / 5^-k * 2^k, in 64-bit integers where they fit and big integers
+// where not, so the result is exact up to the final rounding. Values below
+// FLT_MIN flush to zero.
+//
+//*****************************************************************************
+float numio_strtof(const char *str, char **endptr)
+{
+    uint32_t num[NUMIO_BIG_WORDS];
+    uint32_t den[NUMIO_BIG_WORDS];
+    numio_dec_t dec;
+    int16_t mag, k;
+
+    if (!numio_scan(str, endptr, &dec))
+    {
+        return(0.0f);
+    }
+
+    if (dec.digits == 0)
+    {
+        return(dec.neg ? -0.0f : 0.0f);
+    }
+
+    // value in [10^(mag - 1), 10^mag)
+    for (mag = 1; (mag <= NUMIO_MAX_POW10) && (dec.digits >= g_pow10[mag]); mag++)
+    {
+    }
+    mag += dec.exp10;
+
+    if ((mag - 1) > NUMIO_FLT_MAX10)
+    {
+        errno = ERANGE;
+        return(dec.neg ? -__builtin_inff() : __builtin_inff());
+    }
+
+    if (mag < NUMIO_FLT_MIN10)
+    {
+        errno = ERANGE;
+        return(dec.neg ? -0.0f : 0.0f);
+    }
+
+    k = dec.exp10;
+
+    if ((k >= 0) && (k <= NUMIO_MAX_POW5) && (dec.digits <= (UINT64_MAX / g_pow5[k])))
+    {
+        return(numio_pack(dec.digits * g_pow5[k], 1, k, dec.sticky, dec.neg));
+    }
+
+    if ((k < 0) && (k >= -NUMIO_MAX_POW5))
+    {
+        return(numio_pack(dec.digits, g_pow5[-k], k, dec.sticky, dec.neg));
+    }
+
+    numio_big_set(num, dec.digits);
+    numio_big_set(den, 1);
+
+    if (k >= 0)
+    {
+        numio_big_mul_pow5(num, k);
+    }
+    else
+    {
+        numio_big_mul_pow5(den, -k);
+    }
+
+    return(numio_pack_big(num, den, k, dec.sticky, dec.neg));
+}
+
+//*****************************************************************************
+//
+// Parse into a signed fixed-point value with frac_bits (at most 30) fraction
+// bits, rounded half even and saturated to the int32_t range.
+//
+//*****************************************************************************
+int32_t numio_strtoq(const char *str, char **endptr, uint8_t frac_bits)
+{
+    numio_dec_t dec;
+    uint64_t num, den, q, rem, half;
+    int16_t k;
+
+    if (!numio_scan(str, endptr, &dec) || (dec.digits == 0))
+    {
+        return(0);
+    }
+
+    if (frac_bits > 30)
+    {
+        frac_bits = 30;
+    }
+
+    num = dec.digits;
+    den = 1;
+    k = dec.exp10;
+
+    if (k >= 0)
+    {
+        for ( ; k > 0; k--)
+        {
+            if (num >= (1ULL << (63 - frac_bits)))
+            {
+                goto saturate;
+            }
+            num *= 10;
+        }
+    }
+    else
+    {
+        // keep num << frac_bits and the divisor inside 64 bits
+        while ((k < -NUMIO_MAX_POW10) || (num >= (1ULL << (63 - frac_bits))))
+        {
+            dec.sticky |= ((num % 10) != 0);
+            num /= 10;
+            k++;
+        }
+        den = g_pow10[-k];
+    }
+
+    if (num >= (1ULL << (63 - frac_bits)))
+    {
+        goto saturate;
+    }
+
+    num <<= frac_bits;
+    q = num / den;
+    rem = num % den;
+    half = den >> 1;
+
+    // den is 1 (exact, rem is 0) or even, so half is exact
+    if ((rem > half) || ((rem == half) && (rem != 0) && ((q & 1) || dec.sticky)))
+    {
+        q++;
+    }
+
+    if (q > (dec.neg ? 0x80000000ULL : 0x7fffffffULL))
+    {
+        goto saturate;
+    }
+
+    return(dec.neg ? (int32_t)(0 - (uint32_t)q) : (int32_t)q);
+
+saturate:
+    errno = ERANGE;
+    return(dec.neg ? INT32_MIN : INT32_MAX);
+}
@@ -0,0 +1,37 @@
+//*****************************************************************************
+//
+// numio.h - Integer-only decimal formatting and parsing
+//
+// Floats are taken apart into mantissa and exponent and converted with 32/64
+// bit integer arithmetic, so console number I/O pulls in no double-precision
+// library code. Formatting is exact (round half even on the binary value),
+// parsing is correctly rounded for up to 19 significant digits over the
+// normal float range; values below FLT_MIN flush to zero. test/numio_test.c
+// checks both on the host.
+//
+//*****************************************************************************
+
+#ifndef __NUMIO_H__
+#define __NUMIO_H__
+
+#include <inttypes.h>
+
+#define NUMIO_MAX_DECIMALS      9
+
+// sign, 39 integer digits, '.', decimals and the terminator
+#define NUMIO_BUFSIZE           (1 + 39 + 1 + NUMIO_MAX_DECIMALS + 1)
+
+// always print a sign
+#define NUMIO_PLUS              0x01
+
+//*****************************************************************************
+//
+// Prototypes for the NUMIO
+//
+//*****************************************************************************
+uint8_t numio_ftoa(char *buf, float value, uint8_t decimals, uint8_t flags);
+uint8_t numio_qtoa(char *buf, int32_t value, uint8_t frac_bits, uint8_t decimals, uint8_t flags);
+float numio_strtof(const char *str, char **endptr);
+int32_t numio_strtoq(const char *str, char **endptr, uint8_t frac_bits);
+
+#endif // __NUMIO_H__
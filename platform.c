@@ -1,166 +1,289 @@
-//*****************************************************************************
-//
-// platform.c
-//
-//*****************************************************************************
-
-#include <stdlib.h>
-#include <string.h>
-#include <math.h>
-
-#include <inttypes.h>
-
-#include "FreeRTOS.h"
-//#include "semphr.h"
-
-#include "inc/hw_ints.h"
-#include "inc/hw_memmap.h"
-#include "inc/hw_types.h"
-#include "driverlib/debug.h"
-#include "driverlib/rom.h"
-#include "driverlib/sysctl.h"
-#include "driverlib/timer.h"
-#include "utils/uartstdio.h"
-#include "stepper.h"
-#include "platform.h"
-
-#define ABS(a) ((a) > 0 ? (a) : -(a))
-#define SIGN(a) ((a) >= 0 ? +1 : -1)
-#define MIN(a, b) ((a) < (b) ? (a) : (b))
-#define MAX(a, b) ((a) > (b) ? (a) : (b))
-
-int8_t platform_init(void)
-{
-  UARTprintf("Platform driver initialized (steppers: right=%i, left=%i)\n", PLATFORM_STEPPER_R, PLATFORM_STEPPER_L);
-
-  return(PLATFORM_OK);
-}
-
-#define UARTprintf_float(fv) { double i, f; f=modf((fv), &i); UARTprintf("%c%i.%04i", ((fv)<0?'-':'+'), (int32_t)abs(i), (int32_t)(abs(f*10000.0))); }
-
-int8_t platform_go(float velocity, float acceleration, float angular_velocity, float distance)
-{
-  // equations borrowed from:
-  // http://rossum.sourceforge.net/papers/CalculationsForRobotics/DifferentialWheelVelocity/index.htm
-  // http://www.cs.columbia.edu/~allen/F11/NOTES/icckinematics.pdf
-
-  float velocity_r, velocity_l;
-  float sps_r, sps_l;
-  int32_t numsteps_r, numsteps_l;
-  float acceleration_r, acceleration_l;
-  float radius = angular_velocity;
-  float ratio_r, ratio_l;
-
-#if 0
-  if (radius != 0)
-  {
-    angular_velocity = velocity / (radius * 2 * PI);
-  }
-#endif
-
-  // derive wheel velocities
-  //velocity_r = velocity + angular_velocity * (radius + (PLATFORM_WHEEL_BASE / 2));
-  //velocity_r = velocity - angular_velocity * radius + angular_velocity * (radius + (PLATFORM_WHEEL_BASE / 2));
-  velocity_r = velocity + 2 * PI * angular_velocity * (PLATFORM_WHEEL_BASE / 2);
-
-  //velocity_l = velocity + angular_velocity * (radius - (PLATFORM_WHEEL_BASE / 2));
-  //velocity_l = velocity - angular_velocity * radius + angular_velocity * (radius - (PLATFORM_WHEEL_BASE / 2));
-  velocity_l = velocity - 2 * PI * angular_velocity * (PLATFORM_WHEEL_BASE / 2);
-
-  // max velocity limiters
-  if ((velocity_r > +PLATFORM_MAX_VELOCITY)
-    ||(velocity_r < -PLATFORM_MAX_VELOCITY))
-  {
-    float vlimiter = PLATFORM_MAX_VELOCITY / ABS(velocity_r);
-
-    UARTprintf("vlimiter_r "); UARTprintf_float(vlimiter); UARTprintf("\n");
-
-    velocity_r = velocity_r * vlimiter;
-    velocity_l = velocity_l * vlimiter;
-  }
-
-  if ((velocity_l > +PLATFORM_MAX_VELOCITY)
-    ||(velocity_l < -PLATFORM_MAX_VELOCITY))
-  {
-    float vlimiter = PLATFORM_MAX_VELOCITY / ABS(velocity_l);
-    UARTprintf("vlimiter_l "); UARTprintf_float(vlimiter); UARTprintf("\n");
-
-    velocity_r = velocity_r * vlimiter;
-    velocity_l = velocity_l * vlimiter;
-  }
-
-  // last chance ...
-  //velocity_r = MIN(velocity_r, +PLATFORM_MAX_VELOCITY);
-  //velocity_r = MAX(velocity_r, -PLATFORM_MAX_VELOCITY);
-  //velocity_l = MIN(velocity_l, +PLATFORM_MAX_VELOCITY);
-  //velocity_l = MAX(velocity_l, -PLATFORM_MAX_VELOCITY);
-
-  // calc radius
-  radius = velocity / (angular_velocity * 2 * PI);
-
-  // convert to motor parameters
-  sps_r = (360 / PLATFORM_ANGLE_PER_STEP) * (velocity_r / PLATFORM_WHEEL_CIRCUMFERENCE);
-  sps_l = (360 / PLATFORM_ANGLE_PER_STEP) * (velocity_l / PLATFORM_WHEEL_CIRCUMFERENCE);
-
-  //sps_r = MIN(sps_r, +PLATFORM_MAX_STEPPER_SPS);
-  //sps_r = MAX(sps_r, -PLATFORM_MAX_STEPPER_SPS);
-  //sps_l = MIN(sps_l, +PLATFORM_MAX_STEPPER_SPS);
-  //sps_l = MAX(sps_l, -PLATFORM_MAX_STEPPER_SPS);
-
-  ratio_r = velocity_r / velocity;
-  ratio_l = velocity_l / velocity;
-
-  acceleration_r = acceleration * ratio_r;
-  acceleration_r = (360 / PLATFORM_ANGLE_PER_STEP) * (acceleration_r / PLATFORM_WHEEL_CIRCUMFERENCE);
-
-  acceleration_l = acceleration * ratio_l;
-  acceleration_l = (360 / PLATFORM_ANGLE_PER_STEP) * (acceleration_l / PLATFORM_WHEEL_CIRCUMFERENCE);
-
-  numsteps_r = (360 / PLATFORM_ANGLE_PER_STEP) * ((distance * ratio_r) / PLATFORM_WHEEL_CIRCUMFERENCE);
-  numsteps_l = (360 / PLATFORM_ANGLE_PER_STEP) * ((distance * ratio_l) / PLATFORM_WHEEL_CIRCUMFERENCE);
-
-  // debug output
-  UARTprintf("platform_go:\n");
-  UARTprintf("velocity "); UARTprintf_float(velocity);
-  UARTprintf(", velocity_r "); UARTprintf_float(velocity_r);
-  UARTprintf(", velocity_l "); UARTprintf_float(velocity_l);
-  UARTprintf(", angular_velocity "); UARTprintf_float(angular_velocity);
-  UARTprintf(", radius "); UARTprintf_float(radius);
-  UARTprintf("\nsps_r "); UARTprintf_float(sps_r);
-  UARTprintf(", acceleration_r "); UARTprintf_float(acceleration_r);
-  UARTprintf(", numsteps_r %i", numsteps_r);
-  UARTprintf("\nsps_l "); UARTprintf_float(sps_l);
-  UARTprintf(", acceleration_l "); UARTprintf_float(acceleration_l);
-  UARTprintf(", numsteps_l %i", numsteps_l);
-  UARTprintf("\n\n");
-
-  // execute
-  stepper_go(PLATFORM_STEPPER_R, sps_r, acceleration_r, numsteps_r);
-  stepper_go(PLATFORM_STEPPER_L, sps_l, acceleration_l, numsteps_l);
-
-  stepper_waitfor(PLATFORM_STEPPER_R);
-  stepper_waitfor(PLATFORM_STEPPER_L);
-
-  return(PLATFORM_OK);
-}
-
-int8_t platform_stop(uint8_t hard_stop)
-{
-  stepper_stop(PLATFORM_STEPPER_R, hard_stop);
-  stepper_stop(PLATFORM_STEPPER_L, hard_stop);
-
-  return(PLATFORM_OK);
-}
-
-int8_t platform_idle()
-{
-  stepper_idle(PLATFORM_STEPPER_R);
-  stepper_idle(PLATFORM_STEPPER_L);
-
-  return(PLATFORM_OK);
-}
-
-int8_t platform_status()
-{
-  return(PLATFORM_OK);
-}
+//*****************************************************************************
+//
+// platform.c
+//
+//*****************************************************************************
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <inttypes.h>
+
+#include "FreeRTOS.h"
+//#include "semphr.h"
+
+#include "inc/hw_ints.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+#include "driverlib/debug.h"
+#include "driverlib/rom.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/timer.h"
+#include "console.h"
+#include "stepper.h"
+#include "platform.h"
+#include "shell_task.h"
+#include "logger.h"
+#include "mathk.h"
+
+#define ABS(a) ((a) > 0 ? (a) : -(a))
+#define SIGN(a) ((a) >= 0 ? +1 : -1)
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+// 28BYJ-48 at 12V, max acceleration (SPS^2) at 0, 20, 40 .. 100% of
+// PLATFORM_MAX_STEPPER_SPS; a starting point, tune per robot with scv
+static const float g_wheel_curve[STEPPER_CURVE_POINTS] = { 20000, 16000, 11000, 7000, 4000, 2000 };
+
+int8_t platform_init(void)
+{
+  // the wheels share one curve, platform_start() scales it per wheel
+  stepper_curve(PLATFORM_STEPPER_R, PLATFORM_MAX_STEPPER_SPS, g_wheel_curve);
+  stepper_curve(PLATFORM_STEPPER_L, PLATFORM_MAX_STEPPER_SPS, g_wheel_curve);
+
+  console_printf("Platform driver initialized (steppers: right=%i, left=%i)\n", PLATFORM_STEPPER_R, PLATFORM_STEPPER_L);
+
+  return(PLATFORM_OK);
+}
+
+// plan and start a move, returns without waiting for it to finish
+int8_t platform_start(float velocity, float acceleration, float angular_velocity, float distance)
+{
+  // equations borrowed from:
+  // http://rossum.sourceforge.net/papers/CalculationsForRobotics/DifferentialWheelVelocity/index.htm
+  // http://www.cs.columbia.edu/~allen/F11/NOTES/icckinematics.pdf
+
+  float velocity_r, velocity_l;
+  float sps_r, sps_l;
+  int32_t numsteps_r, numsteps_l;
+  float acceleration_r, acceleration_l;
+  uint32_t decel_steps_r, decel_steps_l;
+  float radius = angular_velocity;
+  float ratio_r, ratio_l;
+  float velocity_ref, inv_ref, scale;
+  float sps_ref, accel_ref, steps_ref, ramp_steps;
+  float t_accel, t_cruise;
+  float max_velocity;
+  uint8_t index_ref;
+
+#if 0
+  if (radius != 0)
+  {
+    angular_velocity = velocity / (radius * 2 * PI);
+  }
+#endif
+
+  // derive wheel velocities
+  //velocity_r = velocity + angular_velocity * (radius + (PLATFORM_WHEEL_BASE / 2));
+  //velocity_r = velocity - angular_velocity * radius + angular_velocity * (radius + (PLATFORM_WHEEL_BASE / 2));
+  velocity_r = velocity + 2 * PI * angular_velocity * (PLATFORM_WHEEL_BASE / 2);
+
+  //velocity_l = velocity + angular_velocity * (radius - (PLATFORM_WHEEL_BASE / 2));
+  //velocity_l = velocity - angular_velocity * radius + angular_velocity * (radius - (PLATFORM_WHEEL_BASE / 2));
+  velocity_l = velocity - 2 * PI * angular_velocity * (PLATFORM_WHEEL_BASE / 2);
+
+  // max velocity limiters, from the top speed of the wheel curves
+  max_velocity = MIN(stepper_top_sps(PLATFORM_STEPPER_R), stepper_top_sps(PLATFORM_STEPPER_L));
+  max_velocity = (max_velocity != HUGE_VALF) ? (max_velocity * PLATFORM_METERS_PER_STEP) : PLATFORM_MAX_VELOCITY;
+
+  if ((velocity_r > +max_velocity)
+    ||(velocity_r < -max_velocity))
+  {
+    float vlimiter = max_velocity / ABS(velocity_r);
+
+    LOG_DEBUG(LOG_PLATFORM_VLIMITER, 'r', logger_float(vlimiter));
+
+    velocity = velocity * vlimiter;
+    velocity_r = velocity_r * vlimiter;
+    velocity_l = velocity_l * vlimiter;
+  }
+
+  if ((velocity_l > +max_velocity)
+    ||(velocity_l < -max_velocity))
+  {
+    float vlimiter = max_velocity / ABS(velocity_l);
+    LOG_DEBUG(LOG_PLATFORM_VLIMITER, 'l', logger_float(vlimiter));
+
+    velocity = velocity * vlimiter;
+    velocity_r = velocity_r * vlimiter;
+    velocity_l = velocity_l * vlimiter;
+  }
+
+  // last chance ...
+  //velocity_r = MIN(velocity_r, +PLATFORM_MAX_VELOCITY);
+  //velocity_r = MAX(velocity_r, -PLATFORM_MAX_VELOCITY);
+  //velocity_l = MIN(velocity_l, +PLATFORM_MAX_VELOCITY);
+  //velocity_l = MAX(velocity_l, -PLATFORM_MAX_VELOCITY);
+
+  // calc radius
+  radius = velocity / (angular_velocity * 2 * PI);
+
+  // the faster wheel is the reference both wheel profiles are scaled from,
+  // so the wheel ratios stay within [-1, +1] even when spinning in place
+  velocity_ref = MAX(ABS(velocity_r), ABS(velocity_l));
+  index_ref = (ABS(velocity_r) >= ABS(velocity_l)) ? PLATFORM_STEPPER_R : PLATFORM_STEPPER_L;
+
+  if (velocity_ref == 0)
+  {
+    LOG_WARN(LOG_PLATFORM_NOTHING);
+    return(PLATFORM_ERROR);
+  }
+
+  inv_ref = 1.0f / velocity_ref;
+  ratio_r = velocity_r * inv_ref;
+  ratio_l = velocity_l * inv_ref;
+
+  // center line to reference wheel; when spinning in place distance and
+  // acceleration are taken as those of the reference wheel
+  scale = (velocity != 0) ? (velocity_ref / ABS(velocity)) : 1;
+
+  // one time-parameterized trapezoid for the reference wheel, in steps
+  sps_ref = velocity_ref * PLATFORM_STEPS_PER_METER;
+  accel_ref = ABS(acceleration) * scale * PLATFORM_STEPS_PER_METER;
+  steps_ref = ABS(distance) * scale * PLATFORM_STEPS_PER_METER;
+  ramp_steps = 0;
+  t_accel = 0;
+  t_cruise = 0;
+
+  if (accel_ref != 0)
+  {
+    // braking distance along the reference wheel's torque curve
+    ramp_steps = stepper_brake_steps(index_ref, sps_ref, accel_ref, 1);
+
+    // cruise never reached, peak half way through; with a curve the peak
+    // is lower still, the wheels turn back at half way all the same
+    if ((steps_ref != 0) && (2 * ramp_steps > steps_ref))
+    {
+      ramp_steps = 0.5f * steps_ref;
+      sps_ref = mathk_sqrtf(accel_ref * steps_ref);
+    }
+
+    // at least, the curve stretches it
+    t_accel = sps_ref / accel_ref;
+  }
+
+  if (steps_ref != 0)
+  {
+    t_cruise = (steps_ref - 2 * ramp_steps) / sps_ref;
+  }
+
+  // derive the wheel profiles; scaling velocity, acceleration and distance
+  // alike keeps the accel, cruise and decel phases of both wheels aligned
+  sps_r = ratio_r * sps_ref;
+  sps_l = ratio_l * sps_ref;
+
+  acceleration_r = ABS(ratio_r) * accel_ref;
+  acceleration_l = ABS(ratio_l) * accel_ref;
+
+  numsteps_r = SIGN(distance) * ABS(ratio_r) * steps_ref;
+  numsteps_l = SIGN(distance) * ABS(ratio_l) * steps_ref;
+
+  decel_steps_r = ABS(ratio_r) * ramp_steps;
+  decel_steps_l = ABS(ratio_l) * ramp_steps;
+
+  // debug output
+  LOG_INFO(LOG_PLATFORM_GO, logger_float(velocity), logger_float(velocity_r), logger_float(velocity_l),
+           logger_float(angular_velocity), logger_float(radius));
+  LOG_INFO(LOG_PLATFORM_WHEEL, 'r', logger_float(sps_r), 'r', logger_float(acceleration_r), 'r', numsteps_r);
+  LOG_INFO(LOG_PLATFORM_WHEEL, 'l', logger_float(sps_l), 'l', logger_float(acceleration_l), 'l', numsteps_l);
+  LOG_INFO(LOG_PLATFORM_PROFILE, logger_float(t_accel), logger_float(t_cruise));
+
+  // execute, both wheels latched together; each follows the reference
+  // wheel's curve scaled by its ratio, which keeps the ramps aligned
+  // a geared wheel refuses, start neither then
+  if ((stepper_setup(PLATFORM_STEPPER_R, sps_r, acceleration_r, numsteps_r, decel_steps_r, ABS(ratio_r)) != STEPPER_OK)
+    ||(stepper_setup(PLATFORM_STEPPER_L, sps_l, acceleration_l, numsteps_l, decel_steps_l, ABS(ratio_l)) != STEPPER_OK))
+  {
+    return(PLATFORM_ERROR);
+  }
+
+  stepper_start((1 << PLATFORM_STEPPER_R) | (1 << PLATFORM_STEPPER_L));
+
+  return(PLATFORM_OK);
+}
+
+int8_t platform_go(float velocity, float acceleration, float angular_velocity, float distance)
+{
+  if (platform_start(velocity, acceleration, angular_velocity, distance) != PLATFORM_OK)
+  {
+    return(PLATFORM_ERROR);
+  }
+
+  stepper_waitfor(PLATFORM_STEPPER_R);
+  stepper_waitfor(PLATFORM_STEPPER_L);
+
+  return(PLATFORM_OK);
+}
+
+int8_t platform_stop(uint8_t hard_stop)
+{
+  stepper_stop(PLATFORM_STEPPER_R, hard_stop);
+  stepper_stop(PLATFORM_STEPPER_L, hard_stop);
+
+  return(PLATFORM_OK);
+}
+
+int8_t platform_idle()
+{
+  stepper_idle(PLATFORM_STEPPER_R);
+  stepper_idle(PLATFORM_STEPPER_L);
+
+  return(PLATFORM_OK);
+}
+
+// platform motion derived from wheel snapshots (indexed by stepper id)
+void platform_snapshot(const stepper_snapshot_t *axes, platform_snapshot_t *snap)
+{
+  snap->velocity_r = axes[PLATFORM_STEPPER_R].velocity * PLATFORM_METERS_PER_STEP;
+  snap->velocity_l = axes[PLATFORM_STEPPER_L].velocity * PLATFORM_METERS_PER_STEP;
+  snap->velocity = 0.5f * (snap->velocity_r + snap->velocity_l);
+  snap->angular_velocity = (snap->velocity_r - snap->velocity_l) * (1.0f / (2 * PI * PLATFORM_WHEEL_BASE));
+}
+
+int8_t platform_status()
+{
+  stepper_snapshot_t axes[STEPPER_MAX];
+  platform_snapshot_t snap;
+
+  stepper_snapshot_all(axes);
+  platform_snapshot(axes, &snap);
+
+  console_printf("platform_status: v %.3f m/s, w %.3f rot/s, right %.3f m/s (%u steps left), left %.3f m/s (%u steps left)\n",
+                 snap.velocity, snap.angular_velocity, snap.velocity_r, axes[PLATFORM_STEPPER_R].step_count,
+                 snap.velocity_l, axes[PLATFORM_STEPPER_L].step_count);
+
+  return(PLATFORM_OK);
+}
+
+//*****************************************************************************
+//
+// Shell commands.
+//
+//*****************************************************************************
+// returns once the move is started, the EVENT task must not block; "pst"
+// follows it
+static void platform_cmd_go(const shell_arg_t *arg)
+{
+  platform_start(arg[0].f, arg[1].f, arg[2].f, arg[3].f);
+}
+
+static void platform_cmd_idle(const shell_arg_t *arg)
+{
+  platform_idle();
+}
+
+static void platform_cmd_stop(const shell_arg_t *arg)
+{
+  platform_stop(arg[0].i);
+}
+
+static void platform_cmd_status(const shell_arg_t *arg)
+{
+  platform_status();
+}
+
+SHELL_COMMAND(pg, "pg", "f|fff", "(platform go) v, a, w, d", platform_cmd_go);
+SHELL_COMMAND(pi, "pi", "", "(platform idle)", platform_cmd_idle);
+SHELL_COMMAND(ps, "ps", "|i", "(platform stop) hard_stop_flag", platform_cmd_stop);
+SHELL_COMMAND(pst, "pst", "", "(platform status)", platform_cmd_status);
@@ -1,39 +1,41 @@
-//*****************************************************************************
-//
-// priorities.h - Priorities for the various FreeRTOS tasks.
-//
-// Copyright (c) 2012 Texas Instruments Incorporated.  All rights reserved.
-// Software License Agreement
-// 
-// Texas Instruments (TI) is supplying this software for use solely and
-// exclusively on TI's microcontroller products. The software is owned by
-// TI and/or its suppliers, and is protected under applicable copyright
-// laws. You may not combine this software with "viral" open-source
-// software in order to form a larger program.
-// 
-// THIS SOFTWARE IS PROVIDED "AS IS" AND WITH ALL FAULTS.
-// NO WARRANTIES, WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT
-// NOT LIMITED TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
-// A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. TI SHALL NOT, UNDER ANY
-// CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
-// DAMAGES, FOR ANY REASON WHATSOEVER.
-// 
-// This is part of revision 9453 of the EK-LM4F120XL Firmware Package.
-//
-//*****************************************************************************
-
-#ifndef __PRIORITIES_H__
-#define __PRIORITIES_H__
-
-//*****************************************************************************
-//
-// The priorities of the various tasks.
-//
-//*****************************************************************************
-#define PRIORITY_SWITCH_TASK    0
-#define PRIORITY_LED_TASK       0
-#define PRIORITY_STEPPER_TASK   0
-#define PRIORITY_SHELL_TASK     0
-
-
-#endif // __PRIORITIES_H__
+//*****************************************************************************
+//
+// priorities.h - Priorities for the various FreeRTOS tasks.
+//
+// Copyright (c) 2012 Texas Instruments Incorporated.  All rights reserved.
+// Software License Agreement
+// 
+// Texas Instruments (TI) is supplying this software for use solely and
+// exclusively on TI's microcontroller products. The software is owned by
+// TI and/or its suppliers, and is protected under applicable copyright
+// laws. You may not combine this software with "viral" open-source
+// software in order to form a larger program.
+// 
+// THIS SOFTWARE IS PROVIDED "AS IS" AND WITH ALL FAULTS.
+// NO WARRANTIES, WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT
+// NOT LIMITED TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. TI SHALL NOT, UNDER ANY
+// CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+// DAMAGES, FOR ANY REASON WHATSOEVER.
+// 
+// This is part of revision 9453 of the EK-LM4F120XL Firmware Package.
+//
+//*****************************************************************************
+
+#ifndef __PRIORITIES_H__
+#define __PRIORITIES_H__
+
+//*****************************************************************************
+//
+// The priorities of the various tasks.
+//
+//*****************************************************************************
+#define PRIORITY_EVENT_TASK     1
+#define PRIORITY_LOGGER_TASK    0
+#define PRIORITY_PROTO_TASK     1
+#define PRIORITY_TELEMETRY_TASK 1
+#define PRIORITY_SCRIPT_TASK    1
+#define PRIORITY_STEPPER_TASK   3
+
+
+#endif // __PRIORITIES_H__
@@ -0,0 +1,509 @@
+//*****************************************************************************
+//
+// proto.c - Binary framed host protocol
+//
+// The console RX handler collects a COBS frame up to its 0x00 delimiter and
+// wakes the PROTO task, which decodes, checks and executes it. Moves are
+// started without waiting, so a host can stream setpoints at a high rate.
+//
+//*****************************************************************************
+
+#include <string.h>
+
+#include <inttypes.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "inc/hw_types.h"
+#include "console.h"
+#include "shell_task.h"
+#include "priorities.h"
+#include "membudget.h"
+#include "stepper.h"
+#include "platform.h"
+#include "telemetry.h"
+#include "script.h"
+#include "proto.h"
+
+//*****************************************************************************
+//
+// The stack size for the PROTO task.
+//
+//*****************************************************************************
+#define PROTOTASKSTACKSIZE      192         // Stack size in words
+
+MEMBUDGET_STACK(g_proto_stack, PROTOTASKSTACKSIZE);
+
+// type + seq + payload + crc, and its COBS encoding
+#define PROTO_MAX_RAW           (2 + PROTO_MAX_PAYLOAD + 2)
+#define PROTO_MAX_FRAME         (PROTO_MAX_RAW + 2)
+
+typedef struct {
+    uint8_t              rx[PROTO_MAX_FRAME];    // frame being received (ISR)
+    uint8_t              rx_len;
+    uint8_t              rx_overflow;
+    uint8_t              frame[PROTO_MAX_FRAME]; // complete frame (task)
+    volatile uint8_t     frame_len;              // 0 when free
+    uint8_t              seq;                    // last seq seen
+    uint8_t              active;
+    console_rx_handler_t prev_handler;
+    xSemaphoreHandle     sem;
+    uint32_t             frames;
+    uint32_t             crc_errors;
+    uint32_t             framing_errors;
+    uint32_t             overruns;
+    uint32_t             seq_gaps;
+} proto_t;
+
+static proto_t g_proto;
+
+uint16_t proto_crc16(const uint8_t *buf, uint16_t len)
+{
+    uint16_t crc = 0xffff;
+    uint8_t i;
+
+    while (len--)
+    {
+        crc ^= (uint16_t)(*buf++) << 8;
+
+        for (i=0; i<8; i++)
+        {
+            crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+        }
+    }
+
+    return(crc);
+}
+
+// COBS encode, returns the encoded length (no delimiter)
+static uint8_t proto_cobs_encode(const uint8_t *in, uint8_t len, uint8_t *out)
+{
+    uint8_t code_idx = 0;
+    uint8_t code = 1;
+    uint8_t o = 1;
+    uint8_t i;
+
+    for (i=0; i<len; i++)
+    {
+        if (in[i] == 0)
+        {
+            out[code_idx] = code;
+            code_idx = o++;
+            code = 1;
+        }
+        else
+        {
+            out[o++] = in[i];
+            code++;
+        }
+    }
+
+    out[code_idx] = code;
+
+    return(o);
+}
+
+// COBS decode, returns the decoded length or 0 if malformed
+static uint8_t proto_cobs_decode(const uint8_t *in, uint8_t len, uint8_t *out)
+{
+    uint8_t i = 0;
+    uint8_t o = 0;
+
+    while (i < len)
+    {
+        uint8_t code = in[i++];
+        uint8_t n;
+
+        if ((code == 0) || ((i + code - 1) > len))
+        {
+            return(0);
+        }
+
+        for (n=1; n<code; n++)
+        {
+            out[o++] = in[i++];
+        }
+
+        if ((code < 0xff) && (i < len))
+        {
+            out[o++] = 0;
+        }
+    }
+
+    return(o);
+}
+
+void proto_send(uint8_t type, uint8_t seq, const uint8_t *payload, uint8_t len)
+{
+    uint8_t raw[PROTO_MAX_RAW];
+    uint8_t frame[1 + PROTO_MAX_FRAME + 1];
+    uint16_t crc;
+    uint8_t n;
+
+    raw[0] = type;
+    raw[1] = seq;
+    memcpy(&raw[2], payload, len);
+    crc = proto_crc16(raw, len + 2);
+    raw[len + 2] = crc & 0xff;
+    raw[len + 3] = crc >> 8;
+
+    // leading delimiter separates the frame from any stray text output
+    frame[0] = 0;
+    n = 1 + proto_cobs_encode(raw, len + 4, &frame[1]);
+    frame[n++] = 0;
+
+    console_write_raw((const char *)frame, n);
+}
+
+static void proto_ack(uint8_t type, uint8_t seq, int8_t result)
+{
+    uint8_t payload[2];
+
+    payload[0] = type;
+    payload[1] = (uint8_t)result;
+
+    proto_send(PROTO_MSG_ACK, seq, payload, sizeof(payload));
+}
+
+static void proto_nak(uint8_t seq, uint8_t reason)
+{
+    proto_send(PROTO_MSG_NAK, seq, &reason, 1);
+}
+
+static void proto_exit(void)
+{
+    console_set_rx_handler(g_proto.prev_handler);
+    g_proto.active = 0;
+}
+
+static void proto_dispatch(const uint8_t *raw, uint8_t len)
+{
+    const uint8_t *p = &raw[2];
+    uint8_t type, seq;
+    uint8_t plen;
+    uint16_t crc;
+
+    if (len < 4)
+    {
+        g_proto.framing_errors++;
+        proto_nak(0, PROTO_NAK_LENGTH);
+        return;
+    }
+
+    plen = len - 4;
+    type = raw[0];
+    seq = raw[1];
+    crc = raw[len - 2] | (raw[len - 1] << 8);
+
+    if (proto_crc16(raw, len - 2) != crc)
+    {
+        g_proto.crc_errors++;
+        proto_nak(seq, PROTO_NAK_CRC);
+        return;
+    }
+
+    g_proto.frames++;
+
+    if (seq != (uint8_t)(g_proto.seq + 1))
+    {
+        g_proto.seq_gaps++;
+    }
+    g_proto.seq = seq;
+
+    switch (type)
+    {
+        case PROTO_MSG_PING:
+            proto_ack(type, seq, 0);
+            break;
+
+        case PROTO_MSG_STEPPER_GO:
+        {
+            float sps, accel;
+            int32_t steps;
+
+            if (plen != 13)
+            {
+                proto_nak(seq, PROTO_NAK_LENGTH);
+                break;
+            }
+
+            memcpy(&sps, &p[1], 4);
+            memcpy(&accel, &p[5], 4);
+            memcpy(&steps, &p[9], 4);
+
+            proto_ack(type, seq, stepper_go(p[0], sps, accel, steps));
+            break;
+        }
+
+        case PROTO_MSG_PLATFORM_GO:
+        {
+            float arg[4];
+
+            if (plen != sizeof(arg))
+            {
+                proto_nak(seq, PROTO_NAK_LENGTH);
+                break;
+            }
+
+            memcpy(arg, p, sizeof(arg));
+
+            proto_ack(type, seq, platform_start(arg[0], arg[1], arg[2], arg[3]));
+            break;
+        }
+
+        case PROTO_MSG_STOP:
+        {
+            int8_t result = STEPPER_OK;
+            uint8_t i;
+
+            if (plen != 2)
+            {
+                proto_nak(seq, PROTO_NAK_LENGTH);
+                break;
+            }
+
+            for (i=0; i<STEPPER_MAX; i++)
+            {
+                if (p[0] & (1 << i))
+                {
+                    result |= stepper_stop(i, p[1]);
+                }
+            }
+
+            proto_ack(type, seq, result);
+            break;
+        }
+
+        case PROTO_MSG_STATUS:
+        {
+            stepper_snapshot_t snap;
+            uint8_t reply[13];
+
+            if (plen != 1)
+            {
+                proto_nak(seq, PROTO_NAK_LENGTH);
+                break;
+            }
+
+            if (stepper_snapshot(p[0], &snap) != STEPPER_OK)
+            {
+                proto_ack(type, seq, STEPPER_ERROR);
+                break;
+            }
+
+            reply[0] = p[0];
+            memcpy(&reply[1], &snap.velocity, 4);
+            memcpy(&reply[5], &snap.tvelocity, 4);
+            memcpy(&reply[9], &snap.step_count, 4);
+
+            proto_send(PROTO_MSG_STATUS_REPLY, seq, reply, sizeof(reply));
+            break;
+        }
+
+        case PROTO_MSG_TELEMETRY_RATE:
+        {
+            uint16_t rate;
+
+            if (plen != 2)
+            {
+                proto_nak(seq, PROTO_NAK_LENGTH);
+                break;
+            }
+
+            rate = p[0] | (p[1] << 8);
+
+            proto_ack(type, seq, telemetry_rate(rate));
+            break;
+        }
+
+        case PROTO_MSG_SCRIPT_DATA:
+        {
+            uint16_t offset;
+
+            if (plen < 2)
+            {
+                proto_nak(seq, PROTO_NAK_LENGTH);
+                break;
+            }
+
+            offset = p[0] | (p[1] << 8);
+
+            proto_ack(type, seq, script_stage(offset, &p[2], plen - 2));
+            break;
+        }
+
+        case PROTO_MSG_SCRIPT_STORE:
+        {
+            uint16_t len, crc;
+
+            if (plen != 5)
+            {
+                proto_nak(seq, PROTO_NAK_LENGTH);
+                break;
+            }
+
+            len = p[1] | (p[2] << 8);
+            crc = p[3] | (p[4] << 8);
+
+            proto_ack(type, seq, script_store(p[0], len, crc));
+            break;
+        }
+
+        case PROTO_MSG_SCRIPT_RUN:
+        {
+            if (plen != 1)
+            {
+                proto_nak(seq, PROTO_NAK_LENGTH);
+                break;
+            }
+
+            proto_ack(type, seq, (p[0] == 0xff) ? script_stop() : script_run(p[0]));
+            break;
+        }
+
+        case PROTO_MSG_EXIT:
+            proto_ack(type, seq, 0);
+            proto_exit();
+            break;
+
+        default:
+            proto_nak(seq, PROTO_NAK_TYPE);
+            break;
+    }
+}
+
+//*****************************************************************************
+//
+// Console RX handler while in binary mode, runs in the UART ISR.
+//
+//*****************************************************************************
+static void proto_rx(char chr)
+{
+    signed portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+
+    if (chr != 0)
+    {
+        if (g_proto.rx_len < sizeof(g_proto.rx))
+        {
+            g_proto.rx[g_proto.rx_len++] = chr;
+        }
+        else
+        {
+            g_proto.rx_overflow = 1;
+        }
+
+        return;
+    }
+
+    // delimiter, hand a complete frame to the task
+    if (g_proto.rx_overflow)
+    {
+        g_proto.framing_errors++;
+    }
+    else if (g_proto.rx_len != 0)
+    {
+        if (g_proto.frame_len == 0)
+        {
+            memcpy(g_proto.frame, g_proto.rx, g_proto.rx_len);
+            g_proto.frame_len = g_proto.rx_len;
+
+            xSemaphoreGiveFromISR(g_proto.sem, &xHigherPriorityTaskWoken);
+        }
+        else
+        {
+            g_proto.overruns++;
+        }
+    }
+
+    g_proto.rx_len = 0;
+    g_proto.rx_overflow = 0;
+
+    portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+}
+
+static void
+protoTask(void *pvParameters)
+{
+    uint8_t raw[PROTO_MAX_FRAME];
+    uint8_t len;
+
+    while(1)
+    {
+        xSemaphoreTake(g_proto.sem, portMAX_DELAY);
+
+        len = proto_cobs_decode(g_proto.frame, g_proto.frame_len, raw);
+        g_proto.frame_len = 0;
+
+        if (len == 0)
+        {
+            g_proto.framing_errors++;
+            continue;
+        }
+
+        proto_dispatch(raw, len);
+    }
+}
+
+// switch the console input over to binary frames
+void proto_enter(void)
+{
+    if (g_proto.active)
+    {
+        return;
+    }
+
+    g_proto.rx_len = 0;
+    g_proto.rx_overflow = 0;
+    g_proto.active = 1;
+    g_proto.prev_handler = console_set_rx_handler(proto_rx);
+}
+
+//*****************************************************************************
+//
+// Initializes the PROTO task.
+//
+//*****************************************************************************
+unsigned long
+protoTaskInit(void)
+{
+    vSemaphoreCreateBinary(g_proto.sem);
+    xSemaphoreTake(g_proto.sem, 0);
+
+    //
+    // Create the PROTO task.
+    //
+    if(MEMBUDGET_TASK_CREATE(protoTask, "PROTO", g_proto_stack, PRIORITY_PROTO_TASK) != pdTRUE)
+    {
+        return(1);
+    }
+
+    console_printf("Proto task init.\n");
+
+    //
+    // Success.
+    //
+    return(0);
+}
+
+//*****************************************************************************
+//
+// Shell commands.
+//
+//*****************************************************************************
+static void proto_cmd_enter(const shell_arg_t *arg)
+{
+    console_printf("binary mode, send EXIT (0x%02x) to return\n", PROTO_MSG_EXIT);
+    proto_enter();
+}
+
+static void proto_cmd_status(const shell_arg_t *arg)
+{
+    console_printf("proto_status: frames %u, crc_errors %u, framing_errors %u, overruns %u, seq_gaps %u\n",
+                   g_proto.frames, g_proto.crc_errors, g_proto.framing_errors,
+                   g_proto.overruns, g_proto.seq_gaps);
+}
+
+SHELL_COMMAND(bin, "bin", "", "(enter binary protocol mode)", proto_cmd_enter);
+SHELL_COMMAND(bst, "bst", "", "(binary protocol status)", proto_cmd_status);
@@ -0,0 +1,54 @@
+//*****************************************************************************
+//
+// proto.h - Binary framed host protocol
+//
+// Each frame is COBS encoded and delimited by 0x00. Decoded it reads
+// type, seq, payload, crc16 where the CRC (CCITT, 0x1021, init 0xffff,
+// little endian) covers type through payload. Multi-byte payload fields are
+// little endian, floats are IEEE-754 single precision. Every command is
+// answered with an ACK (or a STATUS_REPLY) carrying the same seq.
+//
+//*****************************************************************************
+
+#ifndef __PROTO_H__
+#define __PROTO_H__
+
+#define PROTO_MAX_PAYLOAD       64
+
+typedef enum
+{
+  PROTO_MSG_PING           = 0x01, // -
+  PROTO_MSG_STEPPER_GO     = 0x02, // u8 index, f32 sps, f32 accel, i32 steps
+  PROTO_MSG_PLATFORM_GO    = 0x03, // f32 v, f32 a, f32 w, f32 d (does not wait)
+  PROTO_MSG_STOP           = 0x04, // u8 stepper mask, u8 hard_stop
+  PROTO_MSG_STATUS         = 0x05, // u8 index
+  PROTO_MSG_EXIT           = 0x06, // - (back to the shell)
+  PROTO_MSG_TELEMETRY_RATE = 0x07, // u16 rate_hz (0 stops the stream)
+  PROTO_MSG_SCRIPT_DATA    = 0x08, // u16 offset, u8 code[] (see script.h)
+  PROTO_MSG_SCRIPT_STORE   = 0x09, // u8 slot, u16 length, u16 crc16 of the code
+  PROTO_MSG_SCRIPT_RUN     = 0x0a, // u8 slot (0xff stops the running script)
+
+  PROTO_MSG_ACK            = 0x80, // u8 type, i8 result
+  PROTO_MSG_NAK            = 0x81, // u8 reason
+  PROTO_MSG_STATUS_REPLY   = 0x82, // u8 index, f32 velocity, f32 tvelocity, u32 step_count
+  PROTO_MSG_TELEMETRY      = 0x83  // unsolicited, see telemetry.h
+} proto_msg_t;
+
+typedef enum
+{
+  PROTO_NAK_CRC            = 1,
+  PROTO_NAK_LENGTH,
+  PROTO_NAK_TYPE
+} proto_nak_t;
+
+//*****************************************************************************
+//
+// Prototypes for the PROTO
+//
+//*****************************************************************************
+unsigned long protoTaskInit(void);
+void proto_enter(void);
+void proto_send(uint8_t type, uint8_t seq, const uint8_t *payload, uint8_t len);
+uint16_t proto_crc16(const uint8_t *buf, uint16_t len);
+
+#endif // __PROTO_H__
@@ -0,0 +1,83 @@
+//*****************************************************************************
+//
+// rom_shim.h - Board support for the QEMU lm3s6965evb build (BOARD=qemu)
+//
+// Force included ahead of every source file by the Makefile. QEMU emulates a
+// Cortex-M3 LM3S6965: no mask ROM, no FPU, no DWT and an 8 MHz crystal. The
+// UART, GPIO, GPTM and NVIC sit at the same addresses as on the LM4F120, so
+// the firmware runs unchanged once the ROM calls go to the linked driverlib.
+// QEMU's GPTM only counts in the 32-bit modes, so each axis steps from a
+// 32-bit timer of its own there, Timer0-3 (timer.c, stepper.c), and the
+// buttons settle without the Timer2 debounce (switch_task.c).
+//
+//*****************************************************************************
+
+#ifndef __ROM_SHIM_H__
+#define __ROM_SHIM_H__
+
+#define BOARD_QEMU              1
+
+//
+// No FPU to enable.
+//
+#define ROM_FPUEnable()
+#define ROM_FPUStackingEnable()
+
+//
+// The crystal of the lm3s6965evb, see clock.c.
+//
+#define CLOCK_XTAL              SYSCTL_XTAL_8MHZ
+
+//
+// ROM_* to the flash copy of driverlib, for these sources and the ones the
+// Makefile takes from elsewhere (drivers/buttons.c).
+//
+#define ROM_FlashErase                  FlashErase
+#define ROM_FlashProgram                FlashProgram
+#define ROM_GPIODirModeSet              GPIODirModeSet
+#define ROM_GPIOIntTypeSet              GPIOIntTypeSet
+#define ROM_GPIOPadConfigSet            GPIOPadConfigSet
+#define ROM_GPIOPinIntClear             GPIOPinIntClear
+#define ROM_GPIOPinIntDisable           GPIOPinIntDisable
+#define ROM_GPIOPinIntEnable            GPIOPinIntEnable
+#define ROM_GPIOPinIntStatus            GPIOPinIntStatus
+#define ROM_GPIOPinRead                 GPIOPinRead
+#define ROM_GPIOPinTypeGPIOInput        GPIOPinTypeGPIOInput
+#define ROM_GPIOPinTypeGPIOOutput       GPIOPinTypeGPIOOutput
+#define ROM_GPIOPinTypeQEI              GPIOPinTypeQEI
+#define ROM_GPIOPinTypeUART             GPIOPinTypeUART
+#define ROM_GPIOPinWrite                GPIOPinWrite
+#define ROM_IntEnable                   IntEnable
+#define ROM_IntMasterDisable            IntMasterDisable
+#define ROM_IntMasterEnable             IntMasterEnable
+#define ROM_IntPendSet                  IntPendSet
+#define ROM_IntPrioritySet              IntPrioritySet
+#define ROM_QEIConfigure                QEIConfigure
+#define ROM_QEIEnable                   QEIEnable
+#define ROM_QEIPositionGet              QEIPositionGet
+#define ROM_SysCtlClockGet              SysCtlClockGet
+#define ROM_SysCtlClockSet              SysCtlClockSet
+#define ROM_SysCtlPeripheralEnable      SysCtlPeripheralEnable
+#define ROM_TimerConfigure              TimerConfigure
+#define ROM_TimerDisable                TimerDisable
+#define ROM_TimerEnable                 TimerEnable
+#define ROM_TimerIntClear               TimerIntClear
+#define ROM_TimerIntEnable              TimerIntEnable
+#define ROM_TimerLoadGet                TimerLoadGet
+#define ROM_TimerLoadSet                TimerLoadSet
+#define ROM_TimerValueGet               TimerValueGet
+#define ROM_TimerIntStatus              TimerIntStatus
+#define ROM_UARTBusy                    UARTBusy
+#define ROM_UARTCharGetNonBlocking      UARTCharGetNonBlocking
+#define ROM_UARTCharPutNonBlocking      UARTCharPutNonBlocking
+#define ROM_UARTCharsAvail              UARTCharsAvail
+#define ROM_UARTConfigSetExpClk         UARTConfigSetExpClk
+#define ROM_UARTFIFOEnable              UARTFIFOEnable
+#define ROM_UARTFIFOLevelSet            UARTFIFOLevelSet
+#define ROM_UARTIntClear                UARTIntClear
+#define ROM_UARTIntDisable              UARTIntDisable
+#define ROM_UARTIntEnable               UARTIntEnable
+#define ROM_UARTIntStatus               UARTIntStatus
+#define ROM_UARTSpaceAvail              UARTSpaceAvail
+
+#endif // __ROM_SHIM_H__
@@ -0,0 +1,41 @@
+//*****************************************************************************
+//
+// ramfunc.h - Run hot code and tables from SRAM
+//
+// Flash needs wait states at the system clock, SRAM does not. A function
+// marked RAMFUNC lands in .ramfunc and a table marked FASTDATA in .fastdata;
+// out.ld gives both flash load addresses and ResetISR copies them to SRAM
+// along with .data. Calls between flash and SRAM are out of range of a BL,
+// RAMFUNC makes its callers use a long call and the linker adds veneers for
+// the calls out of SRAM.
+//
+// Build with -DRAMFUNC_ENABLE=0 to leave everything in flash, e.g. to
+// compare the isr cycles "top" reports. -DRAMFUNC_VECTORS=1 also serves the
+// vector table from SRAM (1KB aligned, first in .data).
+//
+//*****************************************************************************
+
+#ifndef __RAMFUNC_H__
+#define __RAMFUNC_H__
+
+#ifndef RAMFUNC_ENABLE
+#define RAMFUNC_ENABLE          1
+#endif
+
+#ifndef RAMFUNC_VECTORS
+#define RAMFUNC_VECTORS         0
+#endif
+
+#define RAMFUNC_STR(x)          #x
+#define RAMFUNC_XSTR(x)         RAMFUNC_STR(x)
+
+#if RAMFUNC_ENABLE
+// one section per object, const and writable ones can't share a name
+#define RAMFUNC     __attribute__((section(".ramfunc." RAMFUNC_XSTR(__COUNTER__)), long_call, noinline))
+#define FASTDATA    __attribute__((section(".fastdata." RAMFUNC_XSTR(__COUNTER__))))
+#else
+#define RAMFUNC
+#define FASTDATA
+#endif
+
+#endif // __RAMFUNC_H__
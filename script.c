@@ -0,0 +1,709 @@
+//*****************************************************************************
+//
+// script.c - Flash resident motion scripts
+//
+// Programs are uploaded over the binary protocol into a RAM staging buffer,
+// checked and written to a flash slot. script_run() checks a slot once; the
+// SCRIPT task then interprets it from flash with no further checks. Moves
+// are started without waiting, WAIT blocks until the done interrupt reports
+// the counted moves the script started itself.
+//
+//*****************************************************************************
+
+#include <string.h>
+
+#include <inttypes.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "inc/hw_types.h"
+#include "driverlib/flash.h"
+#include "driverlib/rom.h"
+#include "console.h"
+#include "shell_task.h"
+#include "priorities.h"
+#include "membudget.h"
+#include "logger.h"
+#include "stepper.h"
+#include "platform.h"
+#include "proto.h"
+#include "script.h"
+
+//*****************************************************************************
+//
+// The stack size for the SCRIPT task.
+//
+//*****************************************************************************
+#define SCRIPTTASKSTACKSIZE     192         // Stack size in words
+
+MEMBUDGET_STACK(g_script_stack, SCRIPTTASKSTACKSIZE);
+
+// the SCRIPT region of out.ld, SCRIPT_SLOTS erase blocks
+extern const uint8_t _script[];
+
+#define SCRIPT_SLOT(slot)       (&_script[(slot) * SCRIPT_SLOT_SIZE])
+#define SCRIPT_AXES             ((1 << STEPPER_MAX) - 1)
+#define SCRIPT_NO_TARGET        INT32_MIN
+
+// instructions run without blocking before the task sleeps a tick, so a
+// loop with no WAIT or DELAY leaves the lower priority tasks some time
+#define SCRIPT_SLICE            256
+
+typedef struct {
+    uint32_t magic;
+    uint16_t len;
+    uint16_t crc;
+} script_header_t;
+
+// operand layout of each opcode
+typedef struct {
+    uint8_t mode;       // a mode byte follows the opcode
+    uint8_t fixed;      // u8 operands, then
+    uint8_t nargs;      // N operands, then
+    uint8_t offset;     // an i16 jump offset
+} script_layout_t;
+
+static const script_layout_t g_script_layout[SCRIPT_OP_MAX] = {
+    {0, 0, 0, 0},       // END
+    {1, 1, 3, 0},       // GO
+    {1, 0, 4, 0},       // PLATFORM
+    {0, 1, 0, 0},       // WAIT
+    {1, 0, 1, 0},       // DELAY
+    {0, 2, 0, 0},       // STOP
+    {1, 1, 1, 0},       // SET
+    {1, 1, 1, 0},       // ADD
+    {1, 1, 1, 0},       // MUL
+    {0, 1, 0, 1},       // LOOP
+    {0, 0, 0, 1},       // JUMP
+    {0, 1, 0, 1}        // JNZ
+};
+
+typedef struct {
+    uint32_t          stage[SCRIPT_SLOT_SIZE / 4];  // header + code being uploaded
+    uint8_t           starts[SCRIPT_MAX_CODE / 8];  // instruction boundaries
+    float             var[SCRIPT_VARS];
+    const uint8_t     *code;                        // running program, NULL when idle
+    uint8_t           slot;
+    volatile uint8_t  stop;
+    volatile uint8_t  done;                         // sequences the done interrupt reported
+    uint8_t           moving;                       // moves WAIT can wait for
+    uint8_t           axes;                         // axes the script moved
+    xSemaphoreHandle  run;
+    xSemaphoreHandle  wake;                         // done events and stop
+    uint32_t          runs;
+    uint32_t          instructions;
+    uint16_t          slice;                        // instructions since the task blocked
+    int8_t            result;
+} script_t;
+
+static script_t g_script;
+
+//*****************************************************************************
+//
+// Checking. Everything the interpreter relies on is checked here once, so
+// it can trust the code while it runs.
+//
+//*****************************************************************************
+
+// decode the instruction at pos, returns its opcode or -1 if malformed
+static int8_t script_decode(const uint8_t *code, uint16_t len, uint16_t pos,
+                            uint16_t *next, int32_t *target)
+{
+    const script_layout_t *layout;
+    uint8_t op, mode = 0;
+    uint8_t i;
+    int16_t offset;
+
+    op = code[pos++];
+    if (op >= SCRIPT_OP_MAX)
+    {
+        return(-1);
+    }
+    layout = &g_script_layout[op];
+
+    if (layout->mode)
+    {
+        if (pos >= len)
+        {
+            return(-1);
+        }
+
+        mode = code[pos++];
+        if ((mode >> layout->nargs) != 0)
+        {
+            return(-1);
+        }
+    }
+
+    if ((pos + layout->fixed) > len)
+    {
+        return(-1);
+    }
+
+    switch (op)
+    {
+        case SCRIPT_OP_GO:
+            if (code[pos] >= STEPPER_MAX)
+            {
+                return(-1);
+            }
+            break;
+
+        case SCRIPT_OP_WAIT:
+        case SCRIPT_OP_STOP:
+            if ((code[pos] & ~SCRIPT_AXES) != 0)
+            {
+                return(-1);
+            }
+            break;
+
+        case SCRIPT_OP_SET:
+        case SCRIPT_OP_ADD:
+        case SCRIPT_OP_MUL:
+        case SCRIPT_OP_LOOP:
+        case SCRIPT_OP_JNZ:
+            if (code[pos] >= SCRIPT_VARS)
+            {
+                return(-1);
+            }
+            break;
+    }
+    pos += layout->fixed;
+
+    for (i=0; i<layout->nargs; i++)
+    {
+        if (mode & (1 << i))
+        {
+            if ((pos >= len) || (code[pos] >= SCRIPT_VARS))
+            {
+                return(-1);
+            }
+            pos++;
+        }
+        else
+        {
+            pos += 4;
+        }
+    }
+
+    *target = SCRIPT_NO_TARGET;
+    if (layout->offset)
+    {
+        if ((pos + 2) > len)
+        {
+            return(-1);
+        }
+
+        offset = code[pos] | (code[pos + 1] << 8);
+        pos += 2;
+        *target = (int32_t)pos + offset;
+    }
+
+    if (pos > len)
+    {
+        return(-1);
+    }
+
+    *next = pos;
+    return(op);
+}
+
+static int8_t script_check(const uint8_t *code, uint16_t len)
+{
+    uint16_t pos, next;
+    int32_t target;
+    int8_t op = -1;
+
+    if ((len == 0) || (len > SCRIPT_MAX_CODE))
+    {
+        return(SCRIPT_BAD_CODE);
+    }
+
+    memset(g_script.starts, 0, sizeof(g_script.starts));
+
+    for (pos=0; pos<len; pos=next)
+    {
+        if ((op = script_decode(code, len, pos, &next, &target)) < 0)
+        {
+            return(SCRIPT_BAD_CODE);
+        }
+
+        g_script.starts[pos >> 3] |= 1 << (pos & 7);
+    }
+
+    // no running off the end
+    if ((op != SCRIPT_OP_END) && (op != SCRIPT_OP_JUMP))
+    {
+        return(SCRIPT_BAD_CODE);
+    }
+
+    // every jump lands on an instruction
+    for (pos=0; pos<len; pos=next)
+    {
+        script_decode(code, len, pos, &next, &target);
+
+        if ((target != SCRIPT_NO_TARGET)
+         && ((target < 0) || (target >= len)
+          || !(g_script.starts[target >> 3] & (1 << (target & 7)))))
+        {
+            return(SCRIPT_BAD_CODE);
+        }
+    }
+
+    return(SCRIPT_OK);
+}
+
+static int8_t script_check_slot(uint8_t slot)
+{
+    const script_header_t *header;
+
+    if (slot >= SCRIPT_SLOTS)
+    {
+        return(SCRIPT_BAD_SLOT);
+    }
+
+    header = (const script_header_t *)SCRIPT_SLOT(slot);
+
+    if ((header->magic != SCRIPT_MAGIC)
+     || (header->len > SCRIPT_MAX_CODE)
+     || (proto_crc16(SCRIPT_SLOT(slot) + SCRIPT_HEADER_SIZE, header->len) != header->crc))
+    {
+        return(SCRIPT_BAD_HEADER);
+    }
+
+    return(script_check(SCRIPT_SLOT(slot) + SCRIPT_HEADER_SIZE, header->len));
+}
+
+//*****************************************************************************
+//
+// Upload.
+//
+//*****************************************************************************
+int8_t script_stage(uint16_t offset, const uint8_t *data, uint8_t len)
+{
+    if ((offset + len) > SCRIPT_MAX_CODE)
+    {
+        return(SCRIPT_BAD_CODE);
+    }
+
+    memcpy((uint8_t *)g_script.stage + SCRIPT_HEADER_SIZE + offset, data, len);
+
+    return(SCRIPT_OK);
+}
+
+// check the staged code and write it to a slot; the CPU stalls on flash
+// for the erase, so only with the axes at rest
+int8_t script_store(uint8_t slot, uint16_t len, uint16_t crc)
+{
+    script_header_t *header = (script_header_t *)g_script.stage;
+    const uint8_t *code = (const uint8_t *)g_script.stage + SCRIPT_HEADER_SIZE;
+    uint32_t addr;
+    uint16_t size;
+    int8_t result;
+
+    if (slot >= SCRIPT_SLOTS)
+    {
+        return(SCRIPT_BAD_SLOT);
+    }
+
+    if ((g_script.code != NULL) || (stepper_busy() != 0))
+    {
+        return(SCRIPT_BUSY);
+    }
+
+    if ((len > SCRIPT_MAX_CODE) || (proto_crc16(code, len) != crc))
+    {
+        return(SCRIPT_BAD_HEADER);
+    }
+
+    if ((result = script_check(code, len)) != SCRIPT_OK)
+    {
+        return(result);
+    }
+
+    header->magic = SCRIPT_MAGIC;
+    header->len = len;
+    header->crc = crc;
+
+    addr = (uint32_t)SCRIPT_SLOT(slot);
+    size = (SCRIPT_HEADER_SIZE + len + 3) & ~3;
+
+    if ((ROM_FlashErase(addr) != 0)
+     || (ROM_FlashProgram((unsigned long *)g_script.stage, addr, size) != 0)
+     || (memcmp((const void *)addr, g_script.stage, size) != 0))
+    {
+        return(SCRIPT_FLASH);
+    }
+
+    return(SCRIPT_OK);
+}
+
+//*****************************************************************************
+//
+// Interpreter.
+//
+//*****************************************************************************
+
+// next N operand, the low mode bit says variable or immediate
+static inline float script_arg(const uint8_t **ip, uint8_t *mode)
+{
+    float f;
+
+    if (*mode & 1)
+    {
+        f = g_script.var[*(*ip)++];
+    }
+    else
+    {
+        memcpy(&f, *ip, sizeof(f));
+        *ip += sizeof(f);
+    }
+
+    *mode >>= 1;
+    return(f);
+}
+
+static inline int16_t script_offset(const uint8_t **ip)
+{
+    int16_t offset = (*ip)[0] | ((*ip)[1] << 8);
+
+    *ip += 2;
+    return(offset);
+}
+
+// before a move call, a done report from here on belongs to the new move
+// and WAIT no longer waits for the old one
+static void script_starting(uint8_t mask)
+{
+    taskENTER_CRITICAL();
+    g_script.done &= ~mask;
+    taskEXIT_CRITICAL();
+
+    g_script.moving &= ~mask;
+}
+
+// only a counted move ends in a done report, a refused one or one without
+// a whole step count never does
+static void script_started(uint8_t mask)
+{
+    g_script.moving |= stepper_counted(mask);
+    g_script.axes |= mask;
+}
+
+static void script_wait(uint8_t mask)
+{
+    mask &= g_script.moving;
+
+    while (!g_script.stop && ((g_script.done & mask) != mask))
+    {
+        xSemaphoreTake(g_script.wake, portMAX_DELAY);
+        g_script.slice = 0;
+    }
+
+    taskENTER_CRITICAL();
+    g_script.done &= ~mask;
+    taskEXIT_CRITICAL();
+
+    g_script.moving &= ~mask;
+}
+
+static void script_delay(float ms)
+{
+    portTickType end = xTaskGetTickCount() + (portTickType)(ms / portTICK_RATE_MS);
+    portTickType now;
+
+    while (!g_script.stop && ((int32_t)(end - (now = xTaskGetTickCount())) > 0))
+    {
+        xSemaphoreTake(g_script.wake, end - now);
+        g_script.slice = 0;
+    }
+}
+
+static int8_t script_exec(const uint8_t *code)
+{
+    const uint8_t *ip = code;
+    float *var = g_script.var;
+    float a[4];
+    uint8_t mode, op, i, n;
+    int16_t offset;
+
+    while (!g_script.stop)
+    {
+        if (++g_script.slice > SCRIPT_SLICE)
+        {
+            vTaskDelay(1);
+            g_script.slice = 0;
+        }
+
+        op = *ip++;
+        g_script.instructions++;
+
+        mode = g_script_layout[op].mode ? *ip++ : 0;
+
+        switch (op)
+        {
+            case SCRIPT_OP_END:
+                return(SCRIPT_OK);
+
+            case SCRIPT_OP_GO:
+                n = *ip++;
+                a[0] = script_arg(&ip, &mode);
+                a[1] = script_arg(&ip, &mode);
+                a[2] = script_arg(&ip, &mode);
+
+                script_starting(1 << n);
+                if (stepper_go(n, a[0], a[1], (int32_t)a[2]) == STEPPER_OK)
+                {
+                    script_started(1 << n);
+                }
+                break;
+
+            case SCRIPT_OP_PLATFORM:
+                for (i=0; i<4; i++)
+                {
+                    a[i] = script_arg(&ip, &mode);
+                }
+
+                // a wheel left standing gets no steps and is not counted
+                script_starting((1 << PLATFORM_STEPPER_R) | (1 << PLATFORM_STEPPER_L));
+                if (platform_start(a[0], a[1], a[2], a[3]) == PLATFORM_OK)
+                {
+                    script_started((1 << PLATFORM_STEPPER_R) | (1 << PLATFORM_STEPPER_L));
+                }
+                break;
+
+            case SCRIPT_OP_WAIT:
+                script_wait(*ip++);
+                break;
+
+            case SCRIPT_OP_DELAY:
+                script_delay(script_arg(&ip, &mode));
+                break;
+
+            case SCRIPT_OP_STOP:
+                for (i=0; i<STEPPER_MAX; i++)
+                {
+                    if (ip[0] & (1 << i))
+                    {
+                        stepper_stop(i, ip[1]);
+                    }
+                }
+                g_script.moving &= ~ip[0];
+                ip += 2;
+                break;
+
+            case SCRIPT_OP_SET:
+                n = *ip++;
+                var[n] = script_arg(&ip, &mode);
+                break;
+
+            case SCRIPT_OP_ADD:
+                n = *ip++;
+                var[n] += script_arg(&ip, &mode);
+                break;
+
+            case SCRIPT_OP_MUL:
+                n = *ip++;
+                var[n] *= script_arg(&ip, &mode);
+                break;
+
+            case SCRIPT_OP_LOOP:
+                n = *ip++;
+                offset = script_offset(&ip);
+                if (--var[n] > 0)
+                {
+                    ip += offset;
+                }
+                break;
+
+            case SCRIPT_OP_JUMP:
+                offset = script_offset(&ip);
+                ip += offset;
+                break;
+
+            case SCRIPT_OP_JNZ:
+                n = *ip++;
+                offset = script_offset(&ip);
+                if (var[n] != 0)
+                {
+                    ip += offset;
+                }
+                break;
+        }
+    }
+
+    return(SCRIPT_ERROR);
+}
+
+static void
+scriptTask(void *pvParameters)
+{
+    uint8_t i;
+
+    while(1)
+    {
+        xSemaphoreTake(g_script.run, portMAX_DELAY);
+
+        LOG_INFO(LOG_SCRIPT_START, g_script.slot);
+
+        memset(g_script.var, 0, sizeof(g_script.var));
+        g_script.done = 0;
+        g_script.moving = 0;
+        g_script.axes = 0;
+        g_script.instructions = 0;
+        g_script.slice = 0;
+        g_script.runs++;
+
+        g_script.result = script_exec(g_script.code);
+
+        // stopped: bring the axes it moved to rest
+        if (g_script.stop)
+        {
+            for (i=0; i<STEPPER_MAX; i++)
+            {
+                if (g_script.axes & (1 << i))
+                {
+                    stepper_stop(i, 0);
+                }
+            }
+        }
+
+        LOG_INFO(LOG_SCRIPT_END, g_script.slot, g_script.result, g_script.instructions);
+
+        g_script.stop = 0;
+        g_script.code = NULL;
+    }
+}
+
+// from the done interrupt, not the EVENT task: a busy or full event loop
+// must not hold up WAIT
+static long script_on_motion_done(uint8_t mask)
+{
+    signed portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+
+    g_script.done |= mask;
+    xSemaphoreGiveFromISR(g_script.wake, &xHigherPriorityTaskWoken);
+
+    return(xHigherPriorityTaskWoken);
+}
+
+int8_t script_run(uint8_t slot)
+{
+    int8_t result;
+
+    if (g_script.code != NULL)
+    {
+        return(SCRIPT_BUSY);
+    }
+
+    if ((result = script_check_slot(slot)) != SCRIPT_OK)
+    {
+        return(result);
+    }
+
+    g_script.slot = slot;
+    g_script.code = SCRIPT_SLOT(slot) + SCRIPT_HEADER_SIZE;
+    xSemaphoreGive(g_script.run);
+
+    return(SCRIPT_OK);
+}
+
+int8_t script_stop(void)
+{
+    if (g_script.code == NULL)
+    {
+        return(SCRIPT_ERROR);
+    }
+
+    g_script.stop = 1;
+    xSemaphoreGive(g_script.wake);
+
+    return(SCRIPT_OK);
+}
+
+void script_status(void)
+{
+    const script_header_t *header;
+    uint8_t slot;
+
+    console_printf("script_status: %s slot %u, runs %u, instructions %u, result %i\n",
+                   (g_script.code != NULL) ? "running" : "idle", g_script.slot,
+                   g_script.runs, g_script.instructions, g_script.result);
+
+    for (slot=0; slot<SCRIPT_SLOTS; slot++)
+    {
+        header = (const script_header_t *)SCRIPT_SLOT(slot);
+
+        console_printf("    slot %u: ", slot);
+        if (header->magic == SCRIPT_MAGIC)
+        {
+            console_printf("%u bytes, check %i\n", header->len, script_check_slot(slot));
+        }
+        else
+        {
+            console_printf("empty\n");
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Initializes the SCRIPT task.
+//
+//*****************************************************************************
+unsigned long
+scriptTaskInit(void)
+{
+    vSemaphoreCreateBinary(g_script.run);
+    xSemaphoreTake(g_script.run, 0);
+    vSemaphoreCreateBinary(g_script.wake);
+    xSemaphoreTake(g_script.wake, 0);
+
+    stepper_set_done_handler(script_on_motion_done);
+
+    //
+    // Create the SCRIPT task.
+    //
+    if(MEMBUDGET_TASK_CREATE(scriptTask, "SCRIPT", g_script_stack, PRIORITY_SCRIPT_TASK) != pdTRUE)
+    {
+        return(1);
+    }
+
+    console_printf("Script task init.\n");
+
+    //
+    // Success.
+    //
+    return(0);
+}
+
+//*****************************************************************************
+//
+// Shell commands.
+//
+//*****************************************************************************
+static void script_cmd_run(const shell_arg_t *arg)
+{
+    int8_t result = script_run(arg[0].i);
+
+    if (result != SCRIPT_OK)
+    {
+        console_printf("script_run: slot %i failed, result %i\n", arg[0].i, result);
+    }
+}
+
+static void script_cmd_stop(const shell_arg_t *arg)
+{
+    script_stop();
+}
+
+static void script_cmd_status(const shell_arg_t *arg)
+{
+    script_status();
+}
+
+SHELL_COMMAND(xrun, "xrun", "i", "(run motion script) slot", script_cmd_run);
+SHELL_COMMAND(xstop, "xstop", "", "(stop motion script)", script_cmd_stop);
+SHELL_COMMAND(xst, "xst", "", "(motion script status)", script_cmd_status);
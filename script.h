@@ -0,0 +1,71 @@
+//*****************************************************************************
+//
+// script.h - Flash resident motion scripts
+//
+// A script is a compact bytecode program stored in one of SCRIPT_SLOTS 1KB
+// flash blocks reserved at the top of flash (see out.ld). The SCRIPT task
+// checks a program once when it is started and then runs it straight from
+// flash, feeding the stepper and platform APIs back to back with no host
+// round trips and no command parsing.
+//
+// A slot holds a header { u32 SCRIPT_MAGIC, u16 length, u16 crc16 } and
+// the code; the CRC (as proto.h) covers the code. Instructions are an opcode
+// byte and their operands, little endian. An operand marked N below is either
+// an f32 immediate or, if its bit is set in the mode byte that follows the
+// opcode (bit 0 for the first N), a u8 variable index. Jump offsets are i16
+// relative to the next instruction. tools/script_asm.py assembles and
+// uploads scripts.
+//
+//*****************************************************************************
+
+#ifndef __SCRIPT_H__
+#define __SCRIPT_H__
+
+#define SCRIPT_SLOTS            4
+#define SCRIPT_SLOT_SIZE        1024
+#define SCRIPT_HEADER_SIZE      8
+#define SCRIPT_MAX_CODE         (SCRIPT_SLOT_SIZE - SCRIPT_HEADER_SIZE)
+#define SCRIPT_VARS             16
+#define SCRIPT_MAGIC            0x5243534d  // "MSCR"
+
+typedef enum
+{
+  SCRIPT_OP_END            = 0x00, // -
+  SCRIPT_OP_GO             = 0x01, // mode, u8 axis, N sps, N accel, N steps
+  SCRIPT_OP_PLATFORM       = 0x02, // mode, N v, N a, N w, N d
+  SCRIPT_OP_WAIT           = 0x03, // u8 axis mask, until every counted move is done
+  SCRIPT_OP_DELAY          = 0x04, // mode, N ms
+  SCRIPT_OP_STOP           = 0x05, // u8 axis mask, u8 hard_stop
+  SCRIPT_OP_SET            = 0x06, // mode, u8 var, N        var = N
+  SCRIPT_OP_ADD            = 0x07, // mode, u8 var, N        var += N
+  SCRIPT_OP_MUL            = 0x08, // mode, u8 var, N        var *= N
+  SCRIPT_OP_LOOP           = 0x09, // u8 var, i16 offset     jump while --var > 0
+  SCRIPT_OP_JUMP           = 0x0a, // i16 offset
+  SCRIPT_OP_JNZ            = 0x0b, // u8 var, i16 offset     jump if var != 0
+  SCRIPT_OP_MAX
+} script_op_t;
+
+typedef enum
+{
+  SCRIPT_ERROR = -1,
+  SCRIPT_OK,
+  SCRIPT_BAD_SLOT,
+  SCRIPT_BAD_HEADER,
+  SCRIPT_BAD_CODE,
+  SCRIPT_BUSY,
+  SCRIPT_FLASH
+} script_result_t;
+
+//*****************************************************************************
+//
+// Prototypes for the SCRIPT
+//
+//*****************************************************************************
+unsigned long scriptTaskInit(void);
+int8_t script_stage(uint16_t offset, const uint8_t *data, uint8_t len);
+int8_t script_store(uint8_t slot, uint16_t len, uint16_t crc);
+int8_t script_run(uint8_t slot);
+int8_t script_stop(void);
+void script_status(void);
+
+#endif // __SCRIPT_H__
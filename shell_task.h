@@ -1,17 +1,49 @@
-//*****************************************************************************
-//
-// shell_task.h - Prototypes for the SHELL task.
-//
-//*****************************************************************************
-
-#ifndef __SHELL_TASK_H__
-#define __SHELL_TASK_H__
-
-//*****************************************************************************
-//
-// Prototypes for the SHELL task.
-//
-//*****************************************************************************
-extern unsigned long shellTaskInit(void);
-
-#endif // __SHELL_TASK_H__
+//*****************************************************************************
+//
+// shell_task.h - Prototypes for the SHELL task.
+//
+//*****************************************************************************
+
+#ifndef __SHELL_TASK_H__
+#define __SHELL_TASK_H__
+
+//*****************************************************************************
+//
+// Shell commands. Any module can add one with SHELL_COMMAND(); the linker
+// collects them into a table sorted by name (see out.ld), looked up with a
+// binary search. The argument descriptor has one character per argument,
+// 'i' for an integer and 'f' for a float; arguments after a '|' are optional
+// and read as 0 when omitted. Arguments are parsed and validated before the
+// handler runs.
+//
+//*****************************************************************************
+#define SHELL_MAX_ARGS          8
+
+typedef union
+{
+  int32_t i;
+  float   f;
+} shell_arg_t;
+
+typedef void (*shell_handler_t)(const shell_arg_t *arg);
+
+typedef struct
+{
+  const char      *name;
+  const char      *args;
+  const char      *usage;
+  shell_handler_t handler;
+} shell_cmd_t;
+
+#define SHELL_COMMAND(ID, NAME, ARGS, USAGE, HANDLER) \
+  static const shell_cmd_t g_shell_cmd_##ID \
+  __attribute__((section(".shell_cmd." NAME), used)) = { NAME, ARGS, USAGE, HANDLER }
+
+//*****************************************************************************
+//
+// Prototypes for the SHELL.
+//
+//*****************************************************************************
+extern unsigned long shellInit(void);
+
+#endif // __SHELL_TASK_H__
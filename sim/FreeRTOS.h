@@ -0,0 +1,24 @@
+//*****************************************************************************
+//
+// FreeRTOS.h - Kernel stand-in for the host build of the stepper engine
+//
+// Only what stepper.c touches. The simulation has no tasks, nothing blocks.
+//
+//*****************************************************************************
+
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+
+#define portBASE_TYPE           long
+
+typedef unsigned long portTickType;
+
+#define pdFALSE                 ((portBASE_TYPE)0)
+#define pdTRUE                  ((portBASE_TYPE)1)
+#define portMAX_DELAY           ((portTickType)0xffffffff)
+
+#define portEND_SWITCHING_ISR(xSwitchRequired)  ((void)(xSwitchRequired))
+#define portSET_INTERRUPT_MASK_FROM_ISR()       0
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x)    ((void)(x))
+
+#endif // INC_FREERTOS_H
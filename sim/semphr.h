@@ -0,0 +1,27 @@
+//*****************************************************************************
+//
+// semphr.h - Semaphore stand-in for the host build of the stepper engine
+//
+//*****************************************************************************
+
+#ifndef SEMAPHORE_H
+#define SEMAPHORE_H
+
+typedef void *xSemaphoreHandle;
+
+extern char g_sim_sem;
+
+#define vSemaphoreCreateBinary(xSemaphore)      ((xSemaphore) = &g_sim_sem)
+
+static inline portBASE_TYPE xSemaphoreTake(xSemaphoreHandle xSemaphore, portTickType xBlockTime)
+{
+  return(pdTRUE);
+}
+
+static inline portBASE_TYPE xSemaphoreGiveFromISR(xSemaphoreHandle xSemaphore,
+                                                  signed portBASE_TYPE *pxHigherPriorityTaskWoken)
+{
+  return(pdTRUE);
+}
+
+#endif // SEMAPHORE_H
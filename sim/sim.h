@@ -0,0 +1,42 @@
+//*****************************************************************************
+//
+// sim.h - Host build of the stepper engine (make sim)
+//
+// Force included ahead of stepper.c and mathk.c when they are compiled for
+// the host, see stepper_sim.c. The StellarisWare headers are used as they
+// are; HWREG and the driverlib calls of the stepper code land in the timer
+// and GPIO model of stepper_sim.c. FreeRTOS.h and semphr.h in this
+// directory stand in for the kernel.
+//
+//*****************************************************************************
+
+#ifndef __SIM_H__
+#define __SIM_H__
+
+#include <stdint.h>
+
+#include "inc/hw_types.h"
+#include "driverlib/rom.h"
+
+//
+// GPIO data register writes are latched and replayed into the model.
+//
+#undef HWREG
+#define HWREG(x)                (*sim_hwreg(x))
+
+extern volatile unsigned long *sim_hwreg(unsigned long addr);
+
+//
+// No TARGET_IS_ part, no mask ROM: ROM_* to the model.
+//
+#define ROM_IntEnable           IntEnable
+#define ROM_IntMasterDisable    IntMasterDisable
+#define ROM_IntMasterEnable     IntMasterEnable
+#define ROM_IntPendSet          IntPendSet
+#define ROM_IntPrioritySet      IntPrioritySet
+#define ROM_TimerLoadGet        TimerLoadGet
+#define ROM_TimerLoadSet        TimerLoadSet
+#define ROM_TimerValueGet       TimerValueGet
+#define ROM_TimerIntStatus      TimerIntStatus
+
+#endif // __SIM_H__
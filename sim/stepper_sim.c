@@ -0,0 +1,1174 @@
+//*****************************************************************************
+//
+// stepper_sim.c - Host simulation of the stepper engine with VCD output
+//
+// Runs stepper.c unchanged against a model of the four step timers and the
+// GPIO ports, in virtual CPU cycles, and dumps every coil output, the
+// position and the velocity of each axis as a Value Change Dump for GTKWave,
+// and the ports no axis drives (trigger outputs) as 8-bit vectors.
+//
+// Usage: stepper_sim [-o out.vcd] [-t max_seconds] [-c clock_hz] [-v] [script]
+//
+// The script (stdin if omitted) holds one command per line, run at the given
+// time in seconds; a time starting with '+' counts from the previous line.
+//
+//   0     sg 0 1500 4000 20000     stepper_go(sid, sps, accel, steps)
+//   0     setup 1 800 2000 5000 0  stepper_setup(sid, sps, accel, steps, decel, 1)
+//   0     curve 0 2500 20000 16000 11000 7000 4000 2000
+//                                  stepper_curve(sid, vmax, a0..a5)
+//   0     coalesce 10              stepper_coalesce_set(window_us)
+//   0     motor 0 1800 3000 1      motor model: pull-out SPS, pull-out SPS^2,
+//                                  encoder counts per step (0 0: ideal)
+//   0     fb 0 1 4                 stepper_feedback(sid, counts_per_step, tolerance)
+//   0     trigger 0 5000 0 0x110 0 stepper_trigger(sid, position, action, arg,
+//                                  velocity), arg in decimal or 0x hex
+//   0     tclear 0                 stepper_trigger_clear(sid)
+//   0     gear 1 0 -1 2 400        stepper_gear(slave, master, p, q, ramp_steps)
+//   0     ungear 1 400             stepper_gear_release(slave, ramp_steps)
+//   0     start 2                  stepper_start(mask)
+//   +1.5  ss 0 0                   stepper_stop(sid, hard_stop)
+//   +0    wait 1                   hold the script until sid's timer is off
+//   12    estop 3000               stepper_estop(decel)
+//   20    si 1                     stepper_idle(sid)
+//   +0    expect 1 -300            fail the run unless stepper_position(sid)
+//                                  is position
+//   0     tcheck 0 400             trigger at position that fails the run
+//                                  unless it fires, with the coils there
+//
+// The run ends once the script is done and every step timer is off, or after
+// max_seconds of virtual time (600 by default). It fails (exit 1) on an
+// expect or tcheck that does not hold, or unless the steps traced on every
+// axis's coils add up to its stepper_position().
+//
+// Timer model: a periodic 16-bit timer interrupts load + 1 cycles after its
+// last timeout or load write (TnILD clear, the reset default); load 0 is off.
+// Handlers take no virtual time. Step interrupts due at the same cycle run in
+// vector order, the done interrupt after them, then the STEPPER task and the
+// script last, the way thread mode would see it. The task runs stepper_plan()
+// every millisecond while a step timer is on, and at once after a script
+// command wakes it, as its priority has it on the target.
+//
+// Motor model: the rotor takes a step unless it comes faster than the
+// pull-out rate, or speeds the rotor up harder than the pull-out
+// acceleration; a missed step stalls it until the steps come slowly enough
+// to pull it in again. encoder_count() reads the rotor, so stepper.c sees
+// the steps lost, and the VCD shows the rotor next to the commanded
+// position.
+//
+// Only changes are written, and the velocity only when the ramp moves it, so
+// a cruise costs a few bytes per coil edge; multi-minute moves at full step
+// rate stay in the tens of megabytes.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include "inc/hw_ints.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+#include "driverlib/gpio.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/timer.h"
+#include "console.h"
+#include "cpuload.h"
+#include "event.h"
+#include "stepper.h"
+#include "stepper_task.h"
+#include "encoder.h"
+#include "clock.h"
+
+#define SIM_NEVER               UINT64_MAX
+
+// STEPPER_DONE_INT in stepper.c
+#define SIM_DONE_INT            INT_UDMA
+
+#define SIM_PORTS               6
+
+#define SIM_SCRIPT_MAX          1024
+#define SIM_SCRIPT_ARGS         (2 + STEPPER_CURVE_POINTS)
+
+// "tcheck" triggers post EVENT_TRIGGER with this tag | their index
+#define SIM_TCHECK_MAX          16
+#define SIM_TCHECK_TAG          0xfe00
+
+//*****************************************************************************
+//
+// Hardware model. The axis tables mirror g_io and g_phase_bits in stepper.c.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned long base;
+    unsigned long timer;
+    unsigned long interrupt;
+    unsigned long load;         // 0: off
+    uint64_t      due;          // next timeout, cycles
+    uint8_t       pending;      // IntPendSet() seen
+} sim_timer_t;
+
+typedef struct
+{
+    uint8_t port;
+    uint8_t base_pin;
+} sim_axis_t;
+
+static sim_timer_t g_timer[STEPPER_MAX] =
+{
+    {TIMER0_BASE, TIMER_A, INT_TIMER0A},
+    {TIMER0_BASE, TIMER_B, INT_TIMER0B},
+    {TIMER1_BASE, TIMER_A, INT_TIMER1A},
+    {TIMER1_BASE, TIMER_B, INT_TIMER1B}
+};
+
+static const sim_axis_t g_axis[STEPPER_MAX] =
+{
+    {2, 4},     // PC4-7
+    {3, 0},     // PD0-3
+    {0, 4},     // PA4-7
+    {0, 0}      // PA0-3
+};
+
+static const uint8_t g_phase_bits[8] = {1, 1|2, 2, 2|4, 4, 4|8, 8, 8|1};
+
+static const unsigned long g_port_base[SIM_PORTS] =
+{
+    GPIO_PORTA_BASE, GPIO_PORTB_BASE, GPIO_PORTC_BASE,
+    GPIO_PORTD_BASE, GPIO_PORTE_BASE, GPIO_PORTF_BASE
+};
+
+static uint8_t g_port_data[SIM_PORTS];
+
+// HWREG() write in flight, applied by sim_gpio_flush()
+static struct
+{
+    int8_t                 port;
+    uint8_t                mask;
+    volatile unsigned long value;
+} g_latch = {-1};
+
+static volatile unsigned long g_scratch;
+
+static uint64_t g_now;          // cycles
+static uint64_t g_step_ints;    // step interrupts taken
+static uint8_t  g_done_int;
+static uint8_t  g_plan_wake;    // stepper_task_wake() seen
+static tBoolean g_masked;
+
+clock_info_t g_clock;
+char g_sim_sem;
+
+//*****************************************************************************
+//
+// VCD writer. Identifiers are one printable character per signal.
+//
+//*****************************************************************************
+enum
+{
+    SIM_SIG_COIL0,
+    SIM_SIG_VELOCITY = 4,
+    SIM_SIG_POSITION,
+    SIM_SIG_ROTOR,
+    SIM_SIG_PER_AXIS
+};
+
+// the 8-bit port vectors come after the axes
+#define SIM_SIG_PORT(port)      SIM_SIG_ID(STEPPER_MAX, port)
+
+typedef struct
+{
+    uint8_t  coils;             // last nibble written
+    int8_t   phase;             // index into g_phase_bits, -1 unknown
+    int32_t  position;          // phase steps taken
+    float    velocity;
+} sim_trace_t;
+
+typedef struct
+{
+    float    pullout_sps;       // 0: takes every step
+    float    pullout_accel;     // SPS^2, 0: no limit
+    float    counts_per_step;   // encoder
+    uint64_t last_step;         // cycles
+    float    rate;              // SPS the rotor turns at, 0 stalled
+    int32_t  rotor;             // steps taken
+    uint32_t missed;
+} sim_motor_t;
+
+static sim_motor_t g_motor[STEPPER_MAX];
+
+static FILE       *g_vcd;
+static uint64_t    g_vcd_ns = SIM_NEVER;
+static sim_trace_t g_trace[STEPPER_MAX];
+static uint8_t     g_verbose;
+static uint8_t     g_failed;
+
+static struct
+{
+    int      line;
+    uint8_t  axis;
+    int32_t  position;
+    uint8_t  fired;
+} g_tcheck[SIM_TCHECK_MAX];
+static uint8_t g_tchecks;
+
+#define SIM_SIG_ID(axis, sig)   ((char)('!' + (axis) * SIM_SIG_PER_AXIS + (sig)))
+
+static uint64_t sim_ns(uint64_t cycles)
+{
+    return((cycles / g_clock.hz) * 1000000000ull +
+           ((cycles % g_clock.hz) * 1000000000ull) / g_clock.hz);
+}
+
+static void vcd_time(void)
+{
+    uint64_t ns = sim_ns(g_now);
+
+    if (ns != g_vcd_ns)
+    {
+        fprintf(g_vcd, "#%" PRIu64 "\n", ns);
+        g_vcd_ns = ns;
+    }
+}
+
+static void vcd_integer(int32_t value, char id)
+{
+    uint32_t v = (uint32_t)value;
+    char buf[34];
+    int n = 32;
+
+    // leading zeros may go, a negative number keeps all 32 bits
+    buf[n--] = '\0';
+    do
+    {
+        buf[n--] = '0' + (v & 1);
+        v >>= 1;
+    } while ((value < 0) ? (n >= 0) : (v != 0));
+
+    fprintf(g_vcd, "b%s %c\n", &buf[n + 1], id);
+}
+
+static void vcd_port(uint8_t port)
+{
+    char bits[9];
+    uint8_t b;
+
+    for (b=0; b<8; b++)
+    {
+        bits[b] = (g_port_data[port] & (0x80 >> b)) ? '1' : '0';
+    }
+    bits[8] = 0;
+
+    fprintf(g_vcd, "b%s %c\n", bits, SIM_SIG_PORT(port));
+}
+
+// no coils on it, so traced as a vector
+static uint8_t sim_port_free(uint8_t port)
+{
+    uint8_t i;
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        if (g_axis[i].port == port)
+        {
+            return(0);
+        }
+    }
+
+    return(1);
+}
+
+static void vcd_header(void)
+{
+    uint8_t i, c;
+
+    fprintf(g_vcd, "$version stepper_sim $end\n$timescale 1ns $end\n$scope module stepper $end\n");
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        fprintf(g_vcd, "$scope module axis%u $end\n", i);
+        for (c=0; c<4; c++)
+        {
+            fprintf(g_vcd, "$var wire 1 %c coil%u $end\n", SIM_SIG_ID(i, SIM_SIG_COIL0 + c), c);
+        }
+        fprintf(g_vcd, "$var real 64 %c velocity $end\n", SIM_SIG_ID(i, SIM_SIG_VELOCITY));
+        fprintf(g_vcd, "$var integer 32 %c position $end\n", SIM_SIG_ID(i, SIM_SIG_POSITION));
+        fprintf(g_vcd, "$var integer 32 %c rotor $end\n", SIM_SIG_ID(i, SIM_SIG_ROTOR));
+        fprintf(g_vcd, "$upscope $end\n");
+    }
+
+    for (i=0; i<SIM_PORTS; i++)
+    {
+        if (sim_port_free(i))
+        {
+            fprintf(g_vcd, "$var wire 8 %c port%c $end\n", SIM_SIG_PORT(i), 'A' + i);
+        }
+    }
+
+    fprintf(g_vcd, "$upscope $end\n$enddefinitions $end\n");
+
+    vcd_time();
+    fprintf(g_vcd, "$dumpvars\n");
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        // the planner starts from phase 0, energizing counts as a step
+        g_trace[i].phase = 0;
+
+        for (c=0; c<4; c++)
+        {
+            fprintf(g_vcd, "0%c\n", SIM_SIG_ID(i, SIM_SIG_COIL0 + c));
+        }
+        fprintf(g_vcd, "r0 %c\n", SIM_SIG_ID(i, SIM_SIG_VELOCITY));
+        vcd_integer(0, SIM_SIG_ID(i, SIM_SIG_POSITION));
+        vcd_integer(0, SIM_SIG_ID(i, SIM_SIG_ROTOR));
+    }
+    for (i=0; i<SIM_PORTS; i++)
+    {
+        if (sim_port_free(i))
+        {
+            vcd_port(i);
+        }
+    }
+    fprintf(g_vcd, "$end\n");
+}
+
+// the rotor follows a step of the coils, or falls out of step
+static void motor_step(uint8_t i, int8_t dir)
+{
+    sim_motor_t *m = &g_motor[i];
+    float rate = g_clock.hz_f / (float)(g_now - m->last_step);
+
+    m->last_step = g_now;
+
+    if ((m->pullout_sps != 0)
+     && ((rate > m->pullout_sps)
+      || ((m->pullout_accel != 0) && ((rate - m->rate) * rate > m->pullout_accel))))
+    {
+        m->rate = 0;
+        m->missed++;
+        return;
+    }
+
+    m->rate = rate;
+    m->rotor += dir;
+    vcd_integer(m->rotor, SIM_SIG_ID(i, SIM_SIG_ROTOR));
+}
+
+// coil edges and phase steps of every axis on port
+static void trace_coils(uint8_t port)
+{
+    sim_trace_t *trace;
+    uint8_t coils, changed, i, c;
+    int8_t phase;
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        if (g_axis[i].port != port)
+        {
+            continue;
+        }
+
+        trace = &g_trace[i];
+        coils = (g_port_data[port] >> g_axis[i].base_pin) & 0xf;
+        changed = coils ^ trace->coils;
+
+        if (changed == 0)
+        {
+            continue;
+        }
+
+        vcd_time();
+        for (c=0; c<4; c++)
+        {
+            if (changed & (1 << c))
+            {
+                fprintf(g_vcd, "%c%c\n", (coils & (1 << c)) ? '1' : '0',
+                        SIM_SIG_ID(i, SIM_SIG_COIL0 + c));
+            }
+        }
+        trace->coils = coils;
+
+        // one phase forward or back is a step, drive off keeps the phase
+        for (phase=0; phase<8; phase++)
+        {
+            if (g_phase_bits[phase] == coils)
+            {
+                break;
+            }
+        }
+
+        if (phase == 8)
+        {
+            continue;
+        }
+
+        if (trace->phase >= 0)
+        {
+            if (((trace->phase + 1) & 7) == phase)
+            {
+                trace->position++;
+                motor_step(i, +1);
+            }
+            else if (((phase + 1) & 7) == trace->phase)
+            {
+                trace->position--;
+                motor_step(i, -1);
+            }
+            vcd_integer(trace->position, SIM_SIG_ID(i, SIM_SIG_POSITION));
+        }
+        trace->phase = phase;
+    }
+}
+
+static void trace_velocity(uint8_t i)
+{
+    stepper_snapshot_t snap;
+
+    stepper_snapshot(i, &snap);
+
+    if (snap.velocity != g_trace[i].velocity)
+    {
+        vcd_time();
+        fprintf(g_vcd, "r%.9g %c\n", snap.velocity, SIM_SIG_ID(i, SIM_SIG_VELOCITY));
+        g_trace[i].velocity = snap.velocity;
+    }
+}
+
+//*****************************************************************************
+//
+// GPIO and register access.
+//
+//*****************************************************************************
+static void sim_gpio_flush(void)
+{
+    uint8_t port = g_latch.port;
+    uint8_t data;
+
+    if (g_latch.port < 0)
+    {
+        return;
+    }
+
+    data = (g_port_data[port] & ~g_latch.mask) | (g_latch.value & g_latch.mask);
+    g_latch.port = -1;
+
+    if (data == g_port_data[port])
+    {
+        return;
+    }
+    g_port_data[port] = data;
+
+    if (sim_port_free(port))
+    {
+        vcd_time();
+        vcd_port(port);
+        return;
+    }
+
+    trace_coils(port);
+}
+
+static int8_t sim_gpio_port(unsigned long base)
+{
+    int8_t port;
+
+    for (port=0; port<SIM_PORTS; port++)
+    {
+        if (g_port_base[port] == base)
+        {
+            return(port);
+        }
+    }
+
+    return(-1);
+}
+
+volatile unsigned long *sim_hwreg(unsigned long addr)
+{
+    int8_t port;
+
+    sim_gpio_flush();
+
+    // GPIODATA: address bits 9:2 mask the write
+    port = sim_gpio_port(addr & ~0xfffUL);
+    if ((port < 0) || ((addr & 0xfff) >= 0x400))
+    {
+        return(&g_scratch);
+    }
+
+    // reads see the masked pins, a read-modify-write keeps the rest
+    g_latch.port = port;
+    g_latch.mask = (addr >> 2) & 0xff;
+    g_latch.value = g_port_data[port] & g_latch.mask;
+
+    return(&g_latch.value);
+}
+
+void GPIOPinWrite(unsigned long ulPort, unsigned char ucPins, unsigned char ucVal)
+{
+    HWREG(ulPort + (ucPins << 2)) = ucVal;
+    sim_gpio_flush();
+}
+
+void GPIOPinTypeGPIOOutput(unsigned long ulPort, unsigned char ucPins)
+{
+}
+
+void SysCtlPeripheralEnable(unsigned long ulPeripheral)
+{
+}
+
+//*****************************************************************************
+//
+// Timers and interrupts.
+//
+//*****************************************************************************
+static sim_timer_t *sim_timer(unsigned long base, unsigned long timer)
+{
+    uint8_t i;
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        if ((g_timer[i].base == base) && (g_timer[i].timer == timer))
+        {
+            return(&g_timer[i]);
+        }
+    }
+
+    fprintf(stderr, "stepper_sim: no timer 0x%lx/0x%lx\n", base, timer);
+    exit(1);
+}
+
+void TimerLoadSet(unsigned long ulBase, unsigned long ulTimer, unsigned long ulValue)
+{
+    sim_timer_t *t = sim_timer(ulBase, ulTimer);
+
+    t->load = ulValue & 0xffff;
+    t->due = g_now + t->load + 1;
+}
+
+unsigned long TimerLoadGet(unsigned long ulBase, unsigned long ulTimer)
+{
+    return(sim_timer(ulBase, ulTimer)->load);
+}
+
+// counts down to 0, the timeout is one cycle later
+unsigned long TimerValueGet(unsigned long ulBase, unsigned long ulTimer)
+{
+    sim_timer_t *t = sim_timer(ulBase, ulTimer);
+
+    return(((t->load != 0) && (t->due > g_now)) ? (unsigned long)(t->due - g_now - 1) : 0);
+}
+
+// raw status: timed out, handler not run yet
+unsigned long TimerIntStatus(unsigned long ulBase, tBoolean bMasked)
+{
+    unsigned long status = 0;
+    uint8_t i;
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        if ((g_timer[i].base == ulBase) && (g_timer[i].load != 0) && (g_timer[i].due <= g_now))
+        {
+            status |= (g_timer[i].timer == TIMER_A) ? TIMER_TIMA_TIMEOUT : TIMER_TIMB_TIMEOUT;
+        }
+    }
+
+    return(status);
+}
+
+void IntPendSet(unsigned long ulInterrupt)
+{
+    uint8_t i;
+
+    if (ulInterrupt == SIM_DONE_INT)
+    {
+        g_done_int = 1;
+        return;
+    }
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        if (g_timer[i].interrupt == ulInterrupt)
+        {
+            g_timer[i].pending = 1;
+        }
+    }
+}
+
+void IntEnable(unsigned long ulInterrupt)
+{
+}
+
+void IntPrioritySet(unsigned long ulInterrupt, unsigned char ucPriority)
+{
+}
+
+tBoolean IntMasterDisable(void)
+{
+    tBoolean masked = g_masked;
+
+    g_masked = true;
+    return(masked);
+}
+
+tBoolean IntMasterEnable(void)
+{
+    tBoolean masked = g_masked;
+
+    g_masked = false;
+    return(masked);
+}
+
+// next step interrupt in vector order, SIM_NEVER if all timers are off
+static uint64_t sim_next_step(int8_t *index)
+{
+    uint64_t next = SIM_NEVER;
+    int8_t i;
+
+    *index = -1;
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        if (g_timer[i].pending)
+        {
+            *index = i;
+            return(g_now);
+        }
+
+        if ((g_timer[i].load != 0) && (g_timer[i].due < next))
+        {
+            next = g_timer[i].due;
+            *index = i;
+        }
+    }
+
+    return(next);
+}
+
+static void sim_step_int(uint8_t index)
+{
+    sim_timer_t *t = &g_timer[index];
+
+    // periodic reload, a load write from the handler restarts it again
+    t->pending = 0;
+    t->due = g_now + t->load + 1;
+
+    stepper_tick(index);
+    stepper_coalesce(index);
+    sim_gpio_flush();
+
+    for (index=0; index<STEPPER_MAX; index++)
+    {
+        trace_velocity(index);
+    }
+    g_step_ints++;
+}
+
+//*****************************************************************************
+//
+// Firmware services stepper.c and mathk.c link against.
+//
+//*****************************************************************************
+void console_printf(const char *fmt, ...)
+{
+    va_list args;
+
+    if (g_verbose)
+    {
+        va_start(args, fmt);
+        vfprintf(stderr, fmt, args);
+        va_end(args);
+    }
+}
+
+int8_t event_post_from_isr(uint8_t type, uint8_t arg, uint32_t value)
+{
+    if (g_verbose && (type == EVENT_MOTION_DONE))
+    {
+        fprintf(stderr, "%.6f: axis %u done\n", (double)g_now * g_clock.inv_hz_f, arg);
+    }
+    else if (g_verbose && (type == EVENT_TRIGGER))
+    {
+        fprintf(stderr, "%.6f: axis %u trigger %" PRIu32 "\n", (double)g_now * g_clock.inv_hz_f, arg, value);
+    }
+
+    // the done interrupt runs right after the step that fired it
+    if ((type == EVENT_TRIGGER) && ((value & 0xff00) == SIM_TCHECK_TAG) && ((value & 0xff) < g_tchecks))
+    {
+        g_tcheck[value & 0xff].fired = 1;
+
+        if (g_trace[arg].position != g_tcheck[value & 0xff].position)
+        {
+            fprintf(stderr, "stepper_sim: line %d: trigger at %" PRId32 " fired with axis %u's coils at %" PRId32 "\n",
+                    g_tcheck[value & 0xff].line, g_tcheck[value & 0xff].position, arg, g_trace[arg].position);
+            g_failed = 1;
+        }
+    }
+
+    return(0);
+}
+
+int8_t event_post(uint8_t type, uint8_t arg, uint32_t value)
+{
+    if (g_verbose && (type == EVENT_STEPS_LOST))
+    {
+        fprintf(stderr, "%.6f: axis %u lost %d steps\n", (double)g_now * g_clock.inv_hz_f, arg, (int32_t)value);
+    }
+
+    return(0);
+}
+
+// the rotor as the encoder reads it
+int32_t encoder_count(uint8_t axis)
+{
+    return((int32_t)((float)g_motor[axis].rotor * g_motor[axis].counts_per_step));
+}
+
+// no encoder inputs on the simulated ports
+uint8_t encoder_pins(uint32_t port_base)
+{
+    return(0);
+}
+
+void stepper_task_wake(void)
+{
+    g_plan_wake = 1;
+}
+
+uint32_t cpuload_cycles(void)
+{
+    return((uint32_t)g_now);
+}
+
+//*****************************************************************************
+//
+// Script.
+//
+//*****************************************************************************
+typedef struct
+{
+    double  time;               // seconds
+    uint8_t relative;           // time counts from the previous line
+    char    cmd[12];
+    double  arg[SIM_SCRIPT_ARGS];
+    uint8_t nargs;
+    int     line;
+} sim_cmd_t;
+
+static const struct
+{
+    const char *name;
+    uint8_t    nargs;
+} g_script_cmds[] =
+{
+    {"sg", 4}, {"setup", 5}, {"start", 1}, {"ss", 2}, {"si", 1}, {"estop", 1}, {"wait", 1},
+    {"curve", SIM_SCRIPT_ARGS}, {"coalesce", 1}, {"motor", 4}, {"fb", 3},
+    {"trigger", 5}, {"tclear", 1}, {"gear", 5}, {"ungear", 2}, {"expect", 2},
+    {"tcheck", 2}
+};
+
+static sim_cmd_t g_script[SIM_SCRIPT_MAX];
+static int g_script_len;
+
+static void script_load(FILE *f)
+{
+    char line[256], time[32];
+    sim_cmd_t *cmd;
+    int lineno = 0, n, pos;
+    unsigned i;
+
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        lineno++;
+
+        if ((sscanf(line, " %31s", time) != 1) || (time[0] == '#'))
+        {
+            continue;
+        }
+
+        if (g_script_len == SIM_SCRIPT_MAX)
+        {
+            fprintf(stderr, "stepper_sim: script longer than %u lines\n", SIM_SCRIPT_MAX);
+            exit(1);
+        }
+
+        cmd = &g_script[g_script_len++];
+        cmd->line = lineno;
+        cmd->relative = (time[0] == '+');
+
+        if (sscanf(line, " %31s %11s%n", time, cmd->cmd, &pos) != 2)
+        {
+            goto bad;
+        }
+        cmd->time = atof(time + cmd->relative);
+
+        for (cmd->nargs=0; cmd->nargs<SIM_SCRIPT_ARGS; cmd->nargs++)
+        {
+            if (sscanf(line + pos, " %lf%n", &cmd->arg[cmd->nargs], &n) != 1)
+            {
+                break;
+            }
+            pos += n;
+        }
+
+        for (i=0; i<sizeof(g_script_cmds)/sizeof(g_script_cmds[0]); i++)
+        {
+            if ((strcmp(cmd->cmd, g_script_cmds[i].name) == 0)
+             && (cmd->nargs == g_script_cmds[i].nargs))
+            {
+                break;
+            }
+        }
+
+        if (i == sizeof(g_script_cmds)/sizeof(g_script_cmds[0]))
+        {
+            goto bad;
+        }
+    }
+
+    return;
+
+bad:
+    fprintf(stderr, "stepper_sim: line %d: bad command: %s", lineno, line);
+    exit(1);
+}
+
+// returns the axis to wait for, -1 to go on
+static int8_t script_run(const sim_cmd_t *cmd)
+{
+    const double *a = cmd->arg;
+    uint8_t i;
+
+    if (strcmp(cmd->cmd, "sg") == 0)
+    {
+        stepper_go(a[0], a[1], a[2], a[3]);
+    }
+    else if (strcmp(cmd->cmd, "setup") == 0)
+    {
+        stepper_setup(a[0], a[1], a[2], a[3], a[4], 1);
+    }
+    else if (strcmp(cmd->cmd, "curve") == 0)
+    {
+        float accel[STEPPER_CURVE_POINTS];
+
+        for (i=0; i<STEPPER_CURVE_POINTS; i++)
+        {
+            accel[i] = a[2 + i];
+        }
+
+        if (stepper_curve(a[0], a[1], accel) != STEPPER_OK)
+        {
+            fprintf(stderr, "stepper_sim: bad curve for axis %d\n", (int)a[0]);
+        }
+    }
+    else if (strcmp(cmd->cmd, "start") == 0)
+    {
+        stepper_start(a[0]);
+    }
+    else if (strcmp(cmd->cmd, "ss") == 0)
+    {
+        stepper_stop(a[0], a[1]);
+    }
+    else if (strcmp(cmd->cmd, "si") == 0)
+    {
+        stepper_idle(a[0]);
+    }
+    else if (strcmp(cmd->cmd, "estop") == 0)
+    {
+        stepper_estop(a[0]);
+    }
+    else if (strcmp(cmd->cmd, "coalesce") == 0)
+    {
+        if (stepper_coalesce_set(a[0]) != STEPPER_OK)
+        {
+            fprintf(stderr, "stepper_sim: coalescing window up to %d us\n", STEPPER_COALESCE_MAX_US);
+        }
+    }
+    else if (strcmp(cmd->cmd, "motor") == 0)
+    {
+        g_motor[(uint8_t)a[0] % STEPPER_MAX].pullout_sps = a[1];
+        g_motor[(uint8_t)a[0] % STEPPER_MAX].pullout_accel = a[2];
+        g_motor[(uint8_t)a[0] % STEPPER_MAX].counts_per_step = a[3];
+    }
+    else if (strcmp(cmd->cmd, "fb") == 0)
+    {
+        stepper_feedback(a[0], a[1], a[2]);
+    }
+    else if (strcmp(cmd->cmd, "trigger") == 0)
+    {
+        if (stepper_trigger(a[0], a[1], a[2], a[3], a[4]) != STEPPER_OK)
+        {
+            fprintf(stderr, "stepper_sim: line %d: trigger refused\n", cmd->line);
+        }
+    }
+    else if (strcmp(cmd->cmd, "tcheck") == 0)
+    {
+        if ((g_tchecks == SIM_TCHECK_MAX)
+         || (stepper_trigger(a[0], a[1], STEPPER_TRIGGER_EVENT, SIM_TCHECK_TAG | g_tchecks, 0) != STEPPER_OK))
+        {
+            fprintf(stderr, "stepper_sim: line %d: trigger refused\n", cmd->line);
+            g_failed = 1;
+        }
+        else
+        {
+            g_tcheck[g_tchecks].line = cmd->line;
+            g_tcheck[g_tchecks].axis = a[0];
+            g_tcheck[g_tchecks].position = a[1];
+            g_tchecks++;
+        }
+    }
+    else if (strcmp(cmd->cmd, "tclear") == 0)
+    {
+        stepper_trigger_clear(a[0]);
+    }
+    else if (strcmp(cmd->cmd, "gear") == 0)
+    {
+        if (stepper_gear(a[0], a[1], a[2], a[3], a[4]) != STEPPER_OK)
+        {
+            fprintf(stderr, "stepper_sim: line %d: gear refused\n", cmd->line);
+        }
+    }
+    else if (strcmp(cmd->cmd, "ungear") == 0)
+    {
+        stepper_gear_release(a[0], a[1]);
+    }
+    else if (strcmp(cmd->cmd, "expect") == 0)
+    {
+        if (stepper_position(a[0]) != (int32_t)a[1])
+        {
+            fprintf(stderr, "stepper_sim: line %d: axis %d at %" PRId32 ", expected %d\n",
+                    cmd->line, (int)a[0], stepper_position(a[0]), (int)a[1]);
+            g_failed = 1;
+        }
+    }
+    else if (strcmp(cmd->cmd, "wait") == 0)
+    {
+        return(((a[0] >= 0) && (a[0] < STEPPER_MAX)) ? (int8_t)a[0] : -1);
+    }
+
+    sim_gpio_flush();
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        trace_velocity(i);
+    }
+
+    return(-1);
+}
+
+static uint8_t sim_axis_busy(int8_t index)
+{
+    return(g_timer[index].pending || (g_timer[index].load != 0));
+}
+
+static uint8_t sim_any_busy(void)
+{
+    int8_t i;
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        if (sim_axis_busy(i))
+        {
+            return(1);
+        }
+    }
+
+    return(0);
+}
+
+static void sim_plan(void)
+{
+    int8_t i;
+
+    g_plan_wake = 0;
+    stepper_plan();
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        trace_velocity(i);
+    }
+}
+
+//*****************************************************************************
+//
+// Event loop.
+//
+//*****************************************************************************
+static void sim_run(uint64_t end)
+{
+    uint64_t next_step, next_cmd, next_plan = 0, last_cmd = 0;
+    int8_t index, wait = -1;
+    int pc = 0;
+
+    for (;;)
+    {
+        next_step = sim_next_step(&index);
+
+        // the done interrupt is below the step timers
+        if (g_done_int && (next_step > g_now))
+        {
+            g_done_int = 0;
+            StepperDoneIntHandler();
+            continue;
+        }
+
+        if ((wait >= 0) && !sim_axis_busy(wait))
+        {
+            wait = -1;
+            last_cmd = g_now;
+        }
+
+        next_cmd = SIM_NEVER;
+        if ((wait < 0) && (pc < g_script_len))
+        {
+            next_cmd = (uint64_t)(g_script[pc].time * g_clock.hz_f) +
+                       (g_script[pc].relative ? last_cmd : 0);
+            if (next_cmd < g_now)
+            {
+                next_cmd = g_now;
+            }
+        }
+
+        // the planner ticks while anything moves
+        if (!sim_any_busy())
+        {
+            next_plan = SIM_NEVER;
+        }
+        else if (next_plan == SIM_NEVER)
+        {
+            next_plan = g_now + STEPPER_PLAN_PERIOD_MS * g_clock.per_ms;
+        }
+
+        if ((next_step <= next_cmd) && (next_step <= next_plan) && (next_step != SIM_NEVER))
+        {
+            if (next_step > end)
+            {
+                break;
+            }
+            g_now = next_step;
+            sim_step_int(index);
+        }
+        else if (next_plan <= next_cmd)
+        {
+            if (next_plan > end)
+            {
+                break;
+            }
+            g_now = next_plan;
+            next_plan += STEPPER_PLAN_PERIOD_MS * g_clock.per_ms;
+            sim_plan();
+        }
+        else if (next_cmd != SIM_NEVER)
+        {
+            if (next_cmd > end)
+            {
+                break;
+            }
+            g_now = last_cmd = next_cmd;
+            wait = script_run(&g_script[pc++]);
+
+            // woken, the planner preempts the script
+            if (g_plan_wake)
+            {
+                sim_plan();
+            }
+        }
+        else
+        {
+            if (wait >= 0)
+            {
+                fprintf(stderr, "stepper_sim: line %d: axis %d never stops\n",
+                        g_script[pc - 1].line, wait);
+            }
+            break;
+        }
+    }
+
+    vcd_time();
+}
+
+int main(int argc, char **argv)
+{
+    const char *out = "stepper.vcd";
+    double max_seconds = 600;
+    unsigned long hz = 66666666;
+    FILE *script = stdin;
+    uint8_t i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:t:c:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'o': out = optarg; break;
+            case 't': max_seconds = atof(optarg); break;
+            case 'c': hz = strtoul(optarg, NULL, 0); break;
+            case 'v': g_verbose = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-o out.vcd] [-t max_seconds] [-c clock_hz] [-v] [script]\n", argv[0]);
+                return(2);
+        }
+    }
+
+    if ((optind < argc) && ((script = fopen(argv[optind], "r")) == NULL))
+    {
+        perror(argv[optind]);
+        return(1);
+    }
+    script_load(script);
+
+    if ((g_vcd = fopen(out, "w")) == NULL)
+    {
+        perror(out);
+        return(1);
+    }
+    setvbuf(g_vcd, NULL, _IOFBF, 1 << 20);
+
+    // as clock.c derives them
+    g_clock.hz = hz;
+    g_clock.hz_f = (float)hz;
+    g_clock.inv_hz_f = 1.0f / g_clock.hz_f;
+    g_clock.per_us = hz / 1000000;
+    g_clock.per_ms = hz / 1000;
+
+    stepper_init(STEPPER_MAX);
+    vcd_header();
+
+    sim_run((uint64_t)(max_seconds * hz));
+
+    fprintf(stderr, "stepper_sim: %.6f s simulated, positions %" PRId32 " %" PRId32 " %" PRId32 " %" PRId32
+            ", %" PRIu64 " step interrupts\n",
+            (double)g_now / hz, g_trace[0].position, g_trace[1].position,
+            g_trace[2].position, g_trace[3].position, g_step_ints);
+    fprintf(stderr, "stepper_sim: rotors %" PRId32 " %" PRId32 " %" PRId32 " %" PRId32
+            ", %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 " steps missed\n",
+            g_motor[0].rotor, g_motor[1].rotor, g_motor[2].rotor, g_motor[3].rotor,
+            g_motor[0].missed, g_motor[1].missed, g_motor[2].missed, g_motor[3].missed);
+
+    // the steps the coils took are the ones the engine counted
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        if (g_trace[i].position != stepper_position(i))
+        {
+            fprintf(stderr, "stepper_sim: axis %u coils at %" PRId32 ", stepper_position() %" PRId32 "\n",
+                    i, g_trace[i].position, stepper_position(i));
+            g_failed = 1;
+        }
+    }
+
+    for (i=0; i<g_tchecks; i++)
+    {
+        if (!g_tcheck[i].fired)
+        {
+            fprintf(stderr, "stepper_sim: line %d: trigger at %" PRId32 " on axis %u never fired\n",
+                    g_tcheck[i].line, g_tcheck[i].position, g_tcheck[i].axis);
+            g_failed = 1;
+        }
+    }
+
+    return(((fclose(g_vcd) == 0) && !g_failed) ? 0 : 1);
+}
@@ -1,481 +1,2291 @@
-//*****************************************************************************
-//
-// stepper.c
-//
-//*****************************************************************************
-
-#include <stdlib.h>
-#include <string.h>
-#include <math.h>
-
-#include <inttypes.h>
-
-#include "FreeRTOS.h"
-#include "semphr.h"
-
-#include "inc/hw_ints.h"
-#include "inc/hw_memmap.h"
-#include "inc/hw_types.h"
-#include "driverlib/debug.h"
-#include "driverlib/fpu.h"
-#include "driverlib/gpio.h"
-#include "driverlib/interrupt.h"
-#include "driverlib/pin_map.h"
-#include "driverlib/rom.h"
-#include "driverlib/sysctl.h"
-#include "driverlib/timer.h"
-#include "utils/uartstdio.h"
-#include "stepper.h"
-#include "isqrt.h"
-
-typedef struct {
-    uint32_t io_peripheral;
-    uint32_t io_port;
-    uint32_t base_pin;
-    uint32_t timer_base;
-    uint32_t timer;
-    uint32_t interrupt;
-} stepper_info_t;
-
-#define STEPPER_MAX 4
-#define FLOAT_ERROR 0.00001 // float math leftover error
-
-#define UARTprintf_float(fv) { double i, f; f=modf((fv), &i); UARTprintf("%c%i.%04i", ((fv)<0?'-':'+'), (int32_t)abs(i), (int32_t)(abs(f*10000.0))); }
-
-static const uint8_t g_pin_mask = 0xf;
-
-static const stepper_info_t g_io[STEPPER_MAX] = {
-    {SYSCTL_PERIPH_GPIOC, GPIO_PORTC_BASE, 4, TIMER0_BASE, TIMER_A, INT_TIMER0A},
-    {SYSCTL_PERIPH_GPIOD, GPIO_PORTD_BASE, 0, TIMER0_BASE, TIMER_B, INT_TIMER0B},
-    {SYSCTL_PERIPH_GPIOA, GPIO_PORTA_BASE, 4, TIMER1_BASE, TIMER_A, INT_TIMER1A},
-    {SYSCTL_PERIPH_GPIOA, GPIO_PORTA_BASE, 0, TIMER1_BASE, TIMER_B, INT_TIMER1B}
-};
-
-typedef struct {
-    uint8_t  phase;       // step phase
-    float    velocity;    // current velocity, STEPS-PER-SECOND
-    uint32_t hwtimer;     // hw timer period
-    uint32_t period;      // period duration
-    uint32_t tick_count;  // period tick count
-    uint32_t step_count;  // step period_count
-    uint32_t ramp_th1;    // ramp threshold 1 helper
-    uint32_t ramp_th2;    // ramp threshold 2 helper
-} stepper_state_t;
-
-typedef struct {
-    float    tvelocity;   // target velocity, STEPS-PER-SECOND
-    float    accel;       // acceleration
-    uint32_t steps;       // total number of steps required
-    uint8_t  sem_pending; // use semaphore to signal sequence end
-} stepper_config_t;
-
-typedef struct {
-    stepper_state_t  state;
-    stepper_config_t config;
-    stepper_config_t user_config;
-    xSemaphoreHandle sem;
-    uint32_t         mailbox;
-} stepper_t;
-
-static stepper_t g_stepper[STEPPER_MAX];
-
-#define PHASE_MAX 8
-
-static const uint8_t g_phase_bits[] = {
-    1, 
-    1|2, 
-    2, 
-    2|4, 
-    4, 
-    4|8, 
-    8,
-    8|1
-};
-
-#define ABS(a) ((a) > 0 ? (a) : -(a))
-#define SIGN(a) ((a) >= 0 ? +1 : -1)
-#define MIN(a, b) ((a) < (b) ? (a) : (b))
-#define MAX(a, b) ((a) > (b) ? (a) : (b))
-
-// stepper parameter calculator
-static inline void stepper_setup_timer(stepper_state_t *state, stepper_config_t *config, const stepper_info_t *io)
-{
-    float period = 0;
-
-    // stop timer if no longer needed
-    if ((config->tvelocity == 0)
-     && (ABS(state->velocity) < 1))
-    {
-      //UARTprintf("stepper_setup_timer: stopped, disabling timer\n");
-      ROM_TimerLoadSet(io->timer_base, io->timer, 0); // stopped, timer off
-      state->velocity = 0;
-
-      return;
-    }
-
-    // velocity jumpstart to 1% if very slow or stopped
-    //if (ABS(state->velocity) <= MAX(1, ABS(0.01 * config->tvelocity)))
-    if (ABS(state->velocity) <= ABS(0.01 * config->tvelocity))
-    {
-        // round the other way since we're accellerating/deaccelerating
-        // start at 1% of target velocity or 1, whichever is more
-        state->velocity  = MAX(1, ABS(0.01 * config->tvelocity)) * SIGN(config->tvelocity - state->velocity);
-    } 
-
-    // convert velocity (STEP-PER-SECOND) to period (CLK-PER-PULSE)
-    if (ABS(state->velocity) > FLOAT_ERROR) // almost zero
-    {
-        period = ABS((float)ROM_SysCtlClockGet() / state->velocity);
-    } else {
-        period = 0;
-        state->velocity = 0;
-    }
-
-    // get int hwtimer first, can't be negative
-    state->hwtimer = MIN(65535, period / ((isqrt(period/65536))));
-
-    // recalculate soft period (float) to minimize error
-    state->period = (uint32_t)period;
-
-    ROM_TimerLoadSet(io->timer_base, io->timer, state->hwtimer);
-
-#if 0
-    UARTprintf("stepper_setup_timer:\n"
-               "    velocity %i SPS, target velocity %i SPS, period %i, hwtimer %i, accel %i, step_count %i\n",
-               (int32_t)state->velocity, (int32_t)config->tvelocity, (int32_t)state->period, state->hwtimer, (int32_t)config->accel, state->step_count);
-#endif
-
-}
-
-int8_t stepper_init(uint8_t n)
-{
-    uint8_t i;
-
-    memset(&g_stepper[0], 0, sizeof(g_stepper)); 
-
-    for (i=0; i<MIN(n, STEPPER_MAX); i++)
-    {
-        ROM_TimerLoadSet(g_io[i].timer_base, g_io[i].timer, 0); // stopped, timer off
-
-        SysCtlPeripheralEnable(g_io[i].io_peripheral);
-        GPIOPinTypeGPIOOutput(g_io[i].io_port, g_pin_mask << g_io[i].base_pin);
-        vSemaphoreCreateBinary(g_stepper[i].sem);
-        xSemaphoreTake(g_stepper[i].sem, portMAX_DELAY);
-
-        UARTprintf("Stepper driver %i initialized\n", i);
-    }
-
-    return(STEPPER_OK);
-}
-
-int8_t stepper_tick(uint8_t index)
-{
-    stepper_config_t *config = &g_stepper[index].config;
-    stepper_state_t *state = &g_stepper[index].state;
-    uint32_t *mailbox = &g_stepper[index].mailbox;
-    xSemaphoreHandle sem = g_stepper[index].sem;
-
-    //UARTprintf("%i", index);
-
-    // copy mailbox data if signalled
-    if (*mailbox == 1)
-    {
-        stepper_config_t *user_config = &g_stepper[index].user_config;
-
-        memcpy(config, user_config, sizeof(*config));
-        *mailbox = 0;
-
-        // kick it ...
-#if 0
-        if ((config->accel == 0)
-         || (state->velocity == 0))
-        {
-            if (config->accel == 0)
-            {
-                state->velocity = config->tvelocity;
-                state->tick_count = state->period;
-            }
-
-            // set up timer delays
-            stepper_setup_timer(state, config, &g_io[index]);
-        }
-#else
-        stepper_setup_timer(state, config, &g_io[index]);
-
-        state->tick_count = state->period;
-#endif
-
-        state->step_count = config->steps;
-        state->ramp_th1 = config->steps >> 1; // ramp threshold 1
-        state->ramp_th2 = (0.5 * config->tvelocity * config->tvelocity) / config->accel; // ramp threshold 2
-#if 0
-        UARTprintf("stepper_tick: @MAILBOX:\n"
-                   "    id %i, velocity %i, delay %i, tick_count %i, step_count %i\n"
-                   "    new values: velocity %i, accel %i, steps %i\n", 
-                   index, (int32_t)state->velocity, (int32_t)state->period, (int32_t)state->tick_count, (int32_t)state->step_count, 
-                   (int32_t)config->tvelocity, (int32_t)config->accel, (int32_t)config->steps);
-#endif
-    }
-
-    if (state->period == 0) // idle but not disabled 
-    {
-        // wait some more
-        return(STEPPER_WAITING);
-    }
-
-    // count ticks
-    state->tick_count += state->hwtimer;
-
-    if (state->tick_count < state->period) // sw period not reached?
-    {
-        // wait some more
-        return(STEPPER_WAITING);
-    }
-
-    // reset the delay counter
-    state->tick_count -= ABS(state->period);
-
-    // are we velocitying up/slowing down?
-    // if so, set up an intermediate velocity until the next cycle
-    if ((config->accel != 0)
-     && (state->velocity != config->tvelocity))
-    {
-        int8_t accel_sign = SIGN(config->tvelocity - state->velocity);
-
-        // accelerate
-        state->velocity += accel_sign * config->accel * (state->period / ((float)ROM_SysCtlClockGet()));
-
-        if (((accel_sign > 0) && (state->velocity >= config->tvelocity))
-         || ((accel_sign < 0) && (state->velocity <= config->tvelocity)))
-        {
-            // velocity reached
-            state->velocity = config->tvelocity;
-            //UARTprintf("stepper id %i at target velocity of %i sps\n", index, (int32_t)config->tvelocity);
-        }
-
-        // set up timer delays
-        stepper_setup_timer(state, config, &g_io[index]);
-    }
-
-    if (state->velocity == 0)                        // stopped?
-    {
-      // wait until we have something to do
-      return(STEPPER_STOPPED);
-    }
-
-    // do the step counting
-    if (state->step_count != 0)
-    {
-    	state->step_count--;
-
-        // start slowing down at some point?
-        if ((state->step_count == state->ramp_th1 && (state->velocity != config->tvelocity)) // ramp threshold 1
-         || (state->step_count == state->ramp_th2)) // ramp threshold 2
-        {
-            // start stopping ...
-            //UARTprintf("slowing down\n");
-            config->tvelocity = 0;
-        }
-
-        if (state->step_count == 0) // stop
-        {
-            signed portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
-
-            //UARTprintf("stopped\n");
-            config->tvelocity = state->velocity = 0;
-
-            // set up timer delays
-            stepper_setup_timer(state, config, &g_io[index]); // final nail in the coffin ...
-
-            // signal waiting task, if any
-            if ((sem != NULL) && (config->sem_pending == true))
-            {
-                xSemaphoreGiveFromISR(sem, &xHigherPriorityTaskWoken);
-                portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
-            }
-        }
-    } 
-
-    // Output the bit sequence.
-    //
-    GPIOPinWrite(g_io[index].io_port, g_pin_mask << g_io[index].base_pin, g_phase_bits[state->phase] << g_io[index].base_pin);
-    //UARTprintf(".");
-
-    // Advance phase
-    if (state->velocity > 0)
-    {
-        state->phase++;
-
-        if (state->phase == PHASE_MAX)
-        {
-            state->phase = 0;
-        }
-    }
-    else if (state->velocity < 0)
-    {
-        if (state->phase == 0)
-        {
-            state->phase = PHASE_MAX;
-        }
-
-        state->phase--;
-    }
-
-    return(STEPPER_MOVING);
-}
-
-// stepper cmd from user
-int8_t stepper_go(uint8_t index, float velocity, float acceleration, int32_t steps)
-{
-    stepper_config_t *config;
-    uint32_t *mailbox;
-    const stepper_info_t *io;
-
-    if (index >= STEPPER_MAX)
-    {
-        return(STEPPER_ERROR);
-    }
-
-    config = &g_stepper[index].user_config;
-    mailbox = &g_stepper[index].mailbox;
-
-   // negative steps => flip velocity
-   if (steps < 0)
-   {
-       steps = -steps;
-       velocity = -velocity;
-   }
-
-    // save parameters
-    config->steps = steps;
-    config->tvelocity = velocity;      // STEP-PER-SECOND
-    config->accel = ABS(acceleration); // SPS^2
-
-    // use semaphore if moving a number of steps
-    if (config->steps != 0)
-    {
-        config->sem_pending = true;
-    } else {
-        config->sem_pending = false;
-    }
-
-    UARTprintf("stepper_go:\n"
-               "    id %i, velocity %i, accel %i, steps %i, sem_pending %i\n", 
-               index, (int32_t)config->tvelocity, (int32_t)config->accel, config->steps,
-               config->sem_pending);
-
-    // kick it if stopped or stopping
-    io = &g_io[index];
-
-    // kickstart ...
-    if (ROM_TimerLoadGet(g_io[index].timer_base, g_io[index].timer) == 0)
-    {
-        // latch in the config
-        *mailbox = 1;
-
-        IntPendSet(io->interrupt);
-    } else {
-        // just latch in the config
-        *mailbox = 1;
-    }
-
-    return(STEPPER_OK);
-}
-
-// stop
-int8_t stepper_stop(uint8_t index, uint8_t hard_stop)
-{
-    if (index >= STEPPER_MAX)
-    {
-        return(STEPPER_ERROR);
-    }
-
-    if (hard_stop == 1)
-    {
-      stepper_go(index, 0, 0, 0);
-    }
-    else
-    {
-      stepper_go(index, 0, g_stepper[index].config.accel, 0);
-    }
-
-    UARTprintf("stepper_stop: index %i\n", index);
-    return(STEPPER_OK);
-}
-
-// turn off stepper drive/park
-int8_t stepper_idle(uint8_t index)
-{
-    if (index >= STEPPER_MAX)
-    {
-        return(STEPPER_ERROR);
-    }
-
-    stepper_stop(index, 1); // stop first
-    GPIOPinWrite(g_io[index].io_port, g_pin_mask << g_io[index].base_pin, 0); // turn off stepper drive
-
-    UARTprintf("stepper_idle: index %i\n", index);
-    return(STEPPER_OK);
-}
-
-// print out status
-int8_t stepper_status(uint8_t index)
-{
-    stepper_config_t config;
-    stepper_state_t state;
-
-    if (index >= STEPPER_MAX)
-    {
-        return(STEPPER_ERROR);
-    }
-
-    config = g_stepper[index].config;
-    state = g_stepper[index].state;
-
-    UARTprintf("stepper_status: velocity %i SPS, target velocity %i SPS, delay %i, hwtimer %i, accel %i, steps %i, step_count %i, tick_count %i, mailbox %i\n",
-    		(int32_t)state.velocity, (int32_t)config.tvelocity, (int32_t)state.period, state.hwtimer, (int32_t)config.accel, config.steps, state.step_count, 
-                (int32_t)state.tick_count, g_stepper[index].mailbox);
-
-    return(STEPPER_OK);
-}
-
-// wait for completion of step sequence
-int8_t stepper_waitfor(uint8_t index)
-{
-    stepper_state_t *state;
-    stepper_config_t *config;
-    xSemaphoreHandle sem;
-
-    if (index >= STEPPER_MAX)
-    {
-        return(STEPPER_ERROR);
-    }
-
-    state = &g_stepper[index].state;
-    config = &g_stepper[index].config;
-    sem = g_stepper[index].sem;
-
-    if (config->sem_pending == true)
-    {
-        UARTprintf("stepper_waitfor: waiting for stepper %i\n", index);
-        xSemaphoreTake(sem, portMAX_DELAY);
-    }
-    else
-    {
-        UARTprintf("stepper_waitfor: NOT waiting for stepper %i\n", index);
-        return(STEPPER_ERROR); // nothing to wait on
-    }
-
-    return(STEPPER_OK);
-}
-
-void stepper_scan(uint8_t index, float velocity, float acceleration, int32_t steps)
-{
-    stepper_go(index, velocity, 0, 0);
-
-    while (1)
-    {
-        stepper_go(index, -velocity, acceleration, steps);
-        stepper_go(index, +velocity, acceleration, steps);
-    }
-}
+//*****************************************************************************
+//
+// stepper.c
+//
+//*****************************************************************************
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <inttypes.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#include "inc/hw_ints.h"
+#include "inc/hw_gpio.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+#include "driverlib/debug.h"
+#include "driverlib/fpu.h"
+#include "driverlib/gpio.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/pin_map.h"
+#include "driverlib/rom.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/timer.h"
+#include "console.h"
+#include "stepper.h"
+#include "shell_task.h"
+#include "logger.h"
+#include "event.h"
+#include "mathk.h"
+#include "ramfunc.h"
+#include "clock.h"
+#include "stepper_task.h"
+#include "encoder.h"
+
+typedef struct {
+    uint32_t io_peripheral;
+    uint32_t io_port;
+    uint32_t base_pin;
+    uint32_t timer_base;
+    uint32_t timer;
+    uint32_t timeout;
+    uint32_t interrupt;
+} stepper_info_t;
+
+#define FLOAT_ERROR 0.00001f // float math leftover error
+
+
+static const uint8_t g_pin_mask = 0xf;
+
+#ifdef BOARD_QEMU
+// QEMU's GPTM only counts in the 32-bit modes, one timer per axis (timer.c)
+static const stepper_info_t g_io[STEPPER_MAX] FASTDATA = {
+    {SYSCTL_PERIPH_GPIOC, GPIO_PORTC_BASE, 4, TIMER0_BASE, TIMER_A, TIMER_TIMA_TIMEOUT, INT_TIMER0A},
+    {SYSCTL_PERIPH_GPIOD, GPIO_PORTD_BASE, 0, TIMER1_BASE, TIMER_A, TIMER_TIMA_TIMEOUT, INT_TIMER1A},
+    {SYSCTL_PERIPH_GPIOA, GPIO_PORTA_BASE, 4, TIMER2_BASE, TIMER_A, TIMER_TIMA_TIMEOUT, INT_TIMER2A},
+    {SYSCTL_PERIPH_GPIOA, GPIO_PORTA_BASE, 0, TIMER3_BASE, TIMER_A, TIMER_TIMA_TIMEOUT, INT_TIMER3A}
+};
+#else
+static const stepper_info_t g_io[STEPPER_MAX] FASTDATA = {
+    {SYSCTL_PERIPH_GPIOC, GPIO_PORTC_BASE, 4, TIMER0_BASE, TIMER_A, TIMER_TIMA_TIMEOUT, INT_TIMER0A},
+    {SYSCTL_PERIPH_GPIOD, GPIO_PORTD_BASE, 0, TIMER0_BASE, TIMER_B, TIMER_TIMB_TIMEOUT, INT_TIMER0B},
+    {SYSCTL_PERIPH_GPIOA, GPIO_PORTA_BASE, 4, TIMER1_BASE, TIMER_A, TIMER_TIMA_TIMEOUT, INT_TIMER1A},
+    {SYSCTL_PERIPH_GPIOA, GPIO_PORTA_BASE, 0, TIMER1_BASE, TIMER_B, TIMER_TIMB_TIMEOUT, INT_TIMER1B}
+};
+#endif
+
+// load the step timer of an axis; the write restarts the count, 0 stops it
+static inline void stepper_timer_load(const stepper_info_t *io, uint32_t load)
+{
+#ifdef BOARD_QEMU
+    // QEMU takes a new load at the next timeout only and reloads a 0 load
+    // without end: restart the timer, or leave it off
+    ROM_TimerDisable(io->timer_base, io->timer);
+    if (load != 0)
+    {
+        ROM_TimerLoadSet(io->timer_base, io->timer, load);
+        ROM_TimerEnable(io->timer_base, io->timer);
+    }
+#else
+    ROM_TimerLoadSet(io->timer_base, io->timer, load);
+#endif
+}
+
+//*****************************************************************************
+//
+// Steps are planned ahead. The STEPPER task (stepper_plan()) runs the profile
+// of every axis - mailbox, ramp, torque curve, step counting - a few ms ahead
+// of time and queues each step in the axis's ring: the coil phase to output,
+// then the hw timer period and how many of them to wait for the next step.
+// The step interrupt only pops the next entry, writes the coils and reloads
+// the timer. The planner owns the head of a ring and the interrupt the tail.
+//
+//*****************************************************************************
+#define STEP_PHASE_M    0x07    // phase to output
+#define STEP_FWD        0x08    // a step forward, phase one on from the last
+#define STEP_BACK       0x10    // a step back, phase one before the last
+#define STEP_NONE       0x20    // no output, the move ran down to 0 SPS
+#define STEP_DONE       0x40    // last step of a counted move
+#define STEP_END        0x80    // timer off after it
+
+#define RING_MASK       (STEPPER_RING_SIZE - 1)
+
+typedef struct {
+    uint16_t hwtimer;     // hw timer period to the next step
+    uint16_t segments;    // hw timer periods to the next step
+    uint8_t  flags;       // STEP_*
+} stepper_step_t;
+
+typedef struct {
+    volatile stepper_step_t step[STEPPER_RING_SIZE];
+    volatile uint8_t head;      // next entry the planner writes
+    volatile uint8_t tail;      // next entry the interrupt pops
+    volatile uint8_t running;   // timer on, entries are consumed
+    uint8_t  last;              // flags of the last entry popped
+    uint8_t  restore;           // timer load stretched by stepper_coalesce()
+    uint16_t segments;          // hw timer periods left in this step
+    uint16_t hwtimer;           // hw timer load
+    uint32_t period;            // this step, cycles
+    uint32_t underruns;         // steps held back, ring empty
+    volatile int32_t position;  // steps output
+} stepper_ring_t;
+
+typedef struct {
+    uint8_t  phase;       // on the coils after the steps planned
+    uint8_t  moving;      // steps planned, no STEP_END yet
+    int32_t  position;    // after the steps planned
+    float    velocity;    // current velocity, STEPS-PER-SECOND
+    uint32_t period;      // period duration, 0 stopped
+    uint32_t residual;    // period cycles the hw timer split left over
+    uint32_t step_count;  // step period_count
+} stepper_state_t;
+
+typedef struct {
+    float    tvelocity;   // target velocity, STEPS-PER-SECOND
+    float    vmove;       // velocity the move asked for
+    float    accel;       // acceleration
+    uint32_t steps;       // total number of steps required
+    uint32_t decel_steps; // remaining step count at which deceleration starts
+    float    curve_scale; // torque curve scale, 0 without a curve
+    float    curve_inv;   // curve points per SPS at that scale
+    uint8_t  sem_pending; // use semaphore to signal sequence end
+} stepper_config_t;
+
+//*****************************************************************************
+//
+// Encoder feedback. Each planner pass compares the steps output with the
+// encoder. Within tolerance the axis is in step, and a lag growing past half
+// of it holds the ramp where it is. Past all of it the steps count as lost:
+// the planned steps are dropped, the velocity halved, the acceleration
+// backed off and a counted move extended (or cut short) by the steps lost,
+// so it still ends where it was sent. The acceleration earns its way back
+// while in step.
+//
+//*****************************************************************************
+#define FEEDBACK_SCALE_MIN          0.125f  // lowest acceleration back-off
+#define FEEDBACK_SCALE_RECOVER      (1.0f / 1024)  // per pass in step
+#define FEEDBACK_TOLERANCE          4       // steps, default
+
+typedef struct {
+    float    steps_per_count;   // 0: open loop
+    uint32_t tolerance;         // steps the rotor may be off
+    int32_t  origin;            // encoder count at slip 0
+    int32_t  slip;              // steps lost so far, taken up
+    float    accel_scale;       // ramp back-off, 1 at full acceleration
+    uint8_t  hold;              // lagging, do not speed up
+    int32_t  error;             // last pass, steps
+    uint32_t lost;              // steps lost, either way
+    uint32_t losses;            // times steps were lost
+} stepper_feedback_t;
+
+//*****************************************************************************
+//
+// Positional triggers. Each axis keeps its triggers sorted by position, and
+// a cursor at the first one above the position output, so the step
+// interrupt compares one entry per step and fires the triggers it lands on,
+// either way, once. VELOCITY triggers act on the planned position instead,
+// so the change comes exactly at the step rather than a planning horizon
+// late. START holds the axes it starts ready planned but idle, the trigger
+// kicks them off. EVENT goes out through the done interrupt.
+//
+//*****************************************************************************
+#define TRIGGER_EVENTS              8       // a power of 2
+
+typedef struct {
+    int32_t  position;    // steps, as stepper_position()
+    uint8_t  action;      // STEPPER_TRIGGER_*
+    uint8_t  armed;       // not fired yet
+    uint16_t arg;         // see stepper_trigger_action_t
+    float    velocity;    // STEPPER_TRIGGER_VELOCITY
+} stepper_trigger_t;
+
+typedef struct {
+    stepper_trigger_t trigger[STEPPER_TRIGGERS];
+    volatile uint8_t  count;
+    volatile uint8_t  cursor;   // triggers at or below the position output
+} stepper_triggers_t;
+
+//*****************************************************************************
+//
+// Electronic gearing. A slave axis has no timer and no profile of its own:
+// every step the step interrupt of its master outputs adds the ratio p/q to
+// the slave's accumulator, and each whole step that builds up goes straight
+// to the slave's coils. The ratio ramps in and out by a fixed amount per
+// master step. |p| <= q, so a slave takes at most one step per master step.
+// The accumulator is fixed point, GEAR_ONE per 1/q step.
+//
+//*****************************************************************************
+#define GEAR_FRAC_BITS              15
+#define GEAR_ONE                    (1 << GEAR_FRAC_BITS)
+
+typedef struct {
+    uint8_t  engaged;     // stepped by master
+    uint8_t  master;
+    uint8_t  releasing;   // let go once the ratio is down to 0
+    uint8_t  phase;       // on the coils
+    int16_t  p;
+    uint16_t q;
+    int32_t  ratio;       // p now, GEAR_ONE units; a step per q of them
+    int32_t  target;      // ratio to ramp to
+    int32_t  ramp;        // ratio change per master step
+    int32_t  acc;         // step fraction, ratio units
+} stepper_gear_t;
+
+typedef struct {
+    stepper_ring_t   ring;
+    stepper_state_t  state;
+    stepper_config_t config;
+    stepper_config_t user_config;
+    stepper_curve_t  curve;
+    stepper_feedback_t feedback;
+    stepper_triggers_t triggers;
+    stepper_gear_t   gear;
+    xSemaphoreHandle sem;
+    uint32_t         mailbox;
+} stepper_t;
+
+static stepper_t g_stepper[STEPPER_MAX];
+
+//*****************************************************************************
+//
+// The step timers run above configMAX_SYSCALL_INTERRUPT_PRIORITY and must not
+// call the kernel. A finished sequence sets its bit here and pends the unused
+// uDMA software vector, whose handler runs at a kernel-safe priority, gives
+// the semaphore and posts EVENT_MOTION_DONE.
+//
+//*****************************************************************************
+#define STEPPER_DONE_INT            INT_UDMA
+#define STEPPER_DONE_INT_PRIORITY   (6 << 5)
+
+static volatile uint32_t g_done_pending;
+
+// EVENT triggers fired, for the done interrupt to post
+static struct
+{
+    uint8_t  index[TRIGGER_EVENTS];
+    uint16_t value[TRIGGER_EVENTS];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+    uint32_t dropped;
+} g_trigger_events;
+
+// axes a START trigger holds, planned but not kicked
+static volatile uint8_t g_start_hold;
+
+// told of every finished sequence from the done interrupt, see
+// stepper_set_done_handler()
+static stepper_done_handler_t g_done_handler;
+
+// slave axes geared to each master
+static volatile uint8_t g_gear_slaves[STEPPER_MAX];
+
+static const uint32_t g_gpio_base[STEPPER_TRIGGER_PORTS] FASTDATA = {
+    GPIO_PORTA_BASE, GPIO_PORTB_BASE, GPIO_PORTC_BASE,
+    GPIO_PORTD_BASE, GPIO_PORTE_BASE, GPIO_PORTF_BASE
+};
+
+static const uint32_t g_gpio_periph[STEPPER_TRIGGER_PORTS] = {
+    SYSCTL_PERIPH_GPIOA, SYSCTL_PERIPH_GPIOB, SYSCTL_PERIPH_GPIOC,
+    SYSCTL_PERIPH_GPIOD, SYSCTL_PERIPH_GPIOE, SYSCTL_PERIPH_GPIOF
+};
+
+// e-stop for the planner to apply, the step interrupts are already told
+static volatile struct
+{
+    uint8_t mask;
+    float   decel;
+} g_estop;
+
+//*****************************************************************************
+//
+// Step coalescing. After its own step, a step interrupt runs the step of any
+// other axis due within the window right away and moves that axis's next
+// timeout to where it would have fallen anyway, so the axis skips the
+// interrupt. The step comes early by at most the window and never by more
+// than 1/8 of the axis's hw timer period; the step rate itself is unchanged.
+// Window 0, the default, turns it off.
+//
+//*****************************************************************************
+#define COALESCE_GUARD              64  // cycles, closer timeouts are left to tail-chain
+
+static uint32_t g_coalesce_us;
+static uint32_t g_coalesce_window;      // cycles
+static uint32_t g_coalesce_steps;       // steps run early
+
+#define PHASE_MAX 8
+
+static const uint8_t g_phase_bits[] FASTDATA = {
+    1, 
+    1|2, 
+    2, 
+    2|4, 
+    4, 
+    4|8, 
+    8,
+    8|1
+};
+
+#define ABS(a) ((a) > 0 ? (a) : -(a))
+#define SIGN(a) ((a) >= 0 ? +1 : -1)
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+// slices of the braking distance integral in stepper_brake_steps()
+#define BRAKE_SLICES 16
+
+// acceleration the curve allows at velocity; scale stretches the curve for
+// a wheel that runs at a fixed fraction of the reference wheel's profile
+static inline float stepper_curve_accel(const stepper_curve_t *curve, float scale, float inv, float velocity)
+{
+    float x = ABS(velocity) * inv;
+    uint32_t i;
+
+    if (x >= (STEPPER_CURVE_POINTS - 1))
+    {
+        return(scale * curve->accel[STEPPER_CURVE_POINTS - 1]);
+    }
+
+    i = (uint32_t)x;
+
+    return(scale * (curve->accel[i] + (x - i) * (curve->accel[i + 1] - curve->accel[i])));
+}
+
+// step period for the velocity, jumpstarting a ramp from standstill;
+// period 0 once stopped
+static void stepper_set_period(stepper_state_t *state, const stepper_config_t *config)
+{
+    // stopped
+    if ((config->tvelocity == 0)
+     && (ABS(state->velocity) < 1))
+    {
+      state->period = 0;
+      state->velocity = 0;
+
+      return;
+    }
+
+    // velocity jumpstart to 1% if very slow or stopped
+    //if (ABS(state->velocity) <= MAX(1, ABS(0.01f * config->tvelocity)))
+    if (ABS(state->velocity) <= ABS(0.01f * config->tvelocity))
+    {
+        // round the other way since we're accellerating/deaccelerating
+        // start at 1% of target velocity or 1, whichever is more
+        state->velocity  = MAX(1, ABS(0.01f * config->tvelocity)) * SIGN(config->tvelocity - state->velocity);
+    } 
+
+    // convert velocity (STEP-PER-SECOND) to period (CLK-PER-PULSE)
+    if (ABS(state->velocity) > FLOAT_ERROR) // almost zero
+    {
+        state->period = (uint32_t)ABS(g_clock.hz_f / state->velocity);
+    } else {
+        state->period = 0;
+        state->velocity = 0;
+    }
+}
+
+int8_t stepper_init(uint8_t n)
+{
+    uint8_t i;
+
+    memset(&g_stepper[0], 0, sizeof(g_stepper)); 
+
+    for (i=0; i<MIN(n, STEPPER_MAX); i++)
+    {
+        stepper_timer_load(&g_io[i], 0); // stopped, timer off
+        g_stepper[i].feedback.accel_scale = 1;
+
+        SysCtlPeripheralEnable(g_io[i].io_peripheral);
+        GPIOPinTypeGPIOOutput(g_io[i].io_port, g_pin_mask << g_io[i].base_pin);
+        vSemaphoreCreateBinary(g_stepper[i].sem);
+        xSemaphoreTake(g_stepper[i].sem, portMAX_DELAY);
+
+        console_printf("Stepper driver %i initialized\n", i);
+    }
+
+    g_done_pending = 0;
+    g_estop.mask = 0;
+    g_start_hold = 0;
+    memset((void *)g_gear_slaves, 0, sizeof(g_gear_slaves));
+    g_trigger_events.head = g_trigger_events.tail = 0;
+    ROM_IntPrioritySet(STEPPER_DONE_INT, STEPPER_DONE_INT_PRIORITY);
+    ROM_IntEnable(STEPPER_DONE_INT);
+
+    return(STEPPER_OK);
+}
+
+void StepperDoneIntHandler(void)
+{
+    signed portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+    tBoolean masked;
+    uint32_t pending;
+    uint8_t index;
+
+    masked = ROM_IntMasterDisable();
+    pending = g_done_pending;
+    g_done_pending = 0;
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+
+    for (index=0; index<STEPPER_MAX; index++)
+    {
+        if ((pending & (1 << index)) == 0)
+        {
+            continue;
+        }
+
+        // only counted moves and e-stopped ones get here
+        if (g_stepper[index].sem != NULL)
+        {
+            xSemaphoreGiveFromISR(g_stepper[index].sem, &xHigherPriorityTaskWoken);
+        }
+
+        event_post_from_isr(EVENT_MOTION_DONE, index, 0);
+    }
+
+    // straight to the waiter, a full event queue drops EVENT_MOTION_DONE
+    if ((pending != 0) && (g_done_handler != NULL))
+    {
+        xHigherPriorityTaskWoken |= g_done_handler(pending);
+    }
+
+    // the step interrupts only ever add at the head
+    while (g_trigger_events.tail != g_trigger_events.head)
+    {
+        index = g_trigger_events.tail & (TRIGGER_EVENTS - 1);
+        event_post_from_isr(EVENT_TRIGGER, g_trigger_events.index[index], g_trigger_events.value[index]);
+        g_trigger_events.tail++;
+    }
+
+    portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+}
+
+// carry out a trigger the step interrupt of axis index landed on
+static RAMFUNC void stepper_trigger_act(uint8_t index, stepper_trigger_t *trigger)
+{
+    stepper_ring_t *ring;
+    uint8_t pins, i;
+
+    // VELOCITY belongs to the planner
+    if (!trigger->armed || (trigger->action == STEPPER_TRIGGER_VELOCITY))
+    {
+        return;
+    }
+
+    trigger->armed = 0;
+
+    switch (trigger->action)
+    {
+        case STEPPER_TRIGGER_GPIO:
+            pins = trigger->arg & 0xff;
+            HWREG(g_gpio_base[trigger->arg >> 8] + GPIO_O_DATA + (pins << 2)) ^= pins;
+            break;
+
+        case STEPPER_TRIGGER_START:
+            g_start_hold &= ~trigger->arg;
+
+            // not planned yet: the next planner pass kicks it
+            for (i=0; i<STEPPER_MAX; i++)
+            {
+                ring = &g_stepper[i].ring;
+
+                if ((trigger->arg & (1 << i)) && !ring->running && (ring->head != ring->tail))
+                {
+                    ring->running = 1;
+                    ROM_IntPendSet(g_io[i].interrupt);
+                }
+            }
+            break;
+
+        case STEPPER_TRIGGER_EVENT:
+            if ((uint8_t)(g_trigger_events.head - g_trigger_events.tail) == TRIGGER_EVENTS)
+            {
+                g_trigger_events.dropped++;
+                break;
+            }
+
+            i = g_trigger_events.head & (TRIGGER_EVENTS - 1);
+            g_trigger_events.index[i] = index;
+            g_trigger_events.value[i] = trigger->arg;
+            g_trigger_events.head++;
+            ROM_IntPendSet(STEPPER_DONE_INT);
+            break;
+    }
+}
+
+// fire the triggers a step of dir lands on
+static RAMFUNC void stepper_trigger_step(uint8_t index, int8_t dir)
+{
+    stepper_triggers_t *triggers = &g_stepper[index].triggers;
+    int32_t position = g_stepper[index].ring.position;
+    uint8_t i;
+
+    if (dir > 0)
+    {
+        while ((triggers->cursor < triggers->count)
+            && (triggers->trigger[triggers->cursor].position == position))
+        {
+            stepper_trigger_act(index, &triggers->trigger[triggers->cursor++]);
+        }
+    }
+    else
+    {
+        while ((triggers->cursor > 0)
+            && (triggers->trigger[triggers->cursor - 1].position > position))
+        {
+            triggers->cursor--;
+        }
+
+        for (i=triggers->cursor; (i > 0) && (triggers->trigger[i - 1].position == position); i--)
+        {
+            stepper_trigger_act(index, &triggers->trigger[i - 1]);
+        }
+    }
+}
+
+// one step of slave axis index, from the step interrupt of its master
+static RAMFUNC void stepper_gear_output(uint8_t index, int8_t dir)
+{
+    stepper_t *stepper = &g_stepper[index];
+    const stepper_info_t *io = &g_io[index];
+
+    stepper->gear.phase = (stepper->gear.phase + dir) & STEP_PHASE_M;
+
+    HWREG(io->io_port + GPIO_O_DATA + ((g_pin_mask << io->base_pin) << 2)) =
+        g_phase_bits[stepper->gear.phase] << io->base_pin;
+
+    stepper->ring.position += dir;
+    stepper->state.position = stepper->ring.position;
+
+    if (stepper->triggers.count != 0)
+    {
+        stepper_trigger_step(index, dir);
+    }
+}
+
+// hand slave axis index back to the planner, which carries on from the
+// phase on its coils; a flush takes it from the last entry popped
+static RAMFUNC void stepper_gear_detach(uint8_t index)
+{
+    stepper_gear_t *gear = &g_stepper[index].gear;
+
+    g_stepper[index].state.phase = gear->phase;
+    g_stepper[index].ring.last = gear->phase;
+    g_gear_slaves[gear->master] &= ~(1 << index);
+    gear->engaged = 0;
+}
+
+// drive the slaves of axis index along with a step of dir
+static RAMFUNC void stepper_gear_step(uint8_t index, int8_t dir)
+{
+    stepper_gear_t *gear;
+    uint8_t slaves = g_gear_slaves[index];
+    int32_t one;
+    uint8_t i;
+
+    for (i=0; slaves != 0; i++, slaves >>= 1)
+    {
+        if ((slaves & 1) == 0)
+        {
+            continue;
+        }
+
+        gear = &g_stepper[i].gear;
+
+        if (gear->ratio != gear->target)
+        {
+            gear->ratio += gear->ramp;
+
+            if ((gear->ramp > 0) ? (gear->ratio > gear->target) : (gear->ratio < gear->target))
+            {
+                gear->ratio = gear->target;
+            }
+        }
+
+        one = (int32_t)gear->q << GEAR_FRAC_BITS;
+        gear->acc += (dir > 0) ? gear->ratio : -gear->ratio;
+
+        if (gear->acc >= one)
+        {
+            gear->acc -= one;
+            stepper_gear_output(i, +1);
+        }
+        else if (gear->acc <= -one)
+        {
+            gear->acc += one;
+            stepper_gear_output(i, -1);
+        }
+
+        // ramped out
+        if (gear->releasing && (gear->ratio == 0))
+        {
+            stepper_gear_detach(i);
+        }
+    }
+}
+
+RAMFUNC int8_t stepper_tick(uint8_t index)
+{
+    stepper_ring_t *ring = &g_stepper[index].ring;
+    const stepper_info_t *io = &g_io[index];
+    uint8_t flags;
+
+    // the timeout just taken was stretched, back to the hw timer period
+    if (ring->restore)
+    {
+        stepper_timer_load(io, ring->hwtimer);
+        ring->restore = 0;
+    }
+
+    // a step split into several hw timer periods
+    if (ring->segments > 1)
+    {
+        ring->segments--;
+        return(STEPPER_WAITING);
+    }
+
+    // planner behind, hold the step until the next timeout
+    if (ring->tail == ring->head)
+    {
+        ring->underruns++;
+        return(STEPPER_WAITING);
+    }
+
+    flags = ring->step[ring->tail & RING_MASK].flags;
+    ring->last = flags;
+
+    // Output the bit sequence.
+    //
+    // (GPIOPinWrite() inline, it lives in flash)
+    if ((flags & STEP_NONE) == 0)
+    {
+        HWREG(io->io_port + GPIO_O_DATA + ((g_pin_mask << io->base_pin) << 2)) =
+            g_phase_bits[flags & STEP_PHASE_M] << io->base_pin;
+    }
+
+    if (flags & STEP_FWD)
+    {
+        ring->position++;
+
+        if (g_gear_slaves[index] != 0)
+        {
+            stepper_gear_step(index, +1);
+        }
+
+        if (g_stepper[index].triggers.count != 0)
+        {
+            stepper_trigger_step(index, +1);
+        }
+    }
+    else if (flags & STEP_BACK)
+    {
+        ring->position--;
+
+        if (g_gear_slaves[index] != 0)
+        {
+            stepper_gear_step(index, -1);
+        }
+
+        if (g_stepper[index].triggers.count != 0)
+        {
+            stepper_trigger_step(index, -1);
+        }
+    }
+
+    // signal waiting task, if any, from the done interrupt
+    if (flags & STEP_DONE)
+    {
+        g_done_pending |= 1 << index;
+        ROM_IntPendSet(STEPPER_DONE_INT);
+    }
+
+    if (flags & STEP_END)
+    {
+        ring->tail++;
+
+        stepper_timer_load(io, 0); // stopped, timer off
+        ring->hwtimer = 0;
+        ring->segments = 0;
+        ring->period = 0;
+
+        // a move queued behind this one starts right away
+        if (ring->tail != ring->head)
+        {
+            ROM_IntPendSet(io->interrupt);
+        }
+        else
+        {
+            ring->running = 0;
+        }
+
+        return(STEPPER_STOPPED);
+    }
+
+    if (ring->step[ring->tail & RING_MASK].hwtimer != ring->hwtimer)
+    {
+        ring->hwtimer = ring->step[ring->tail & RING_MASK].hwtimer;
+        stepper_timer_load(io, ring->hwtimer);
+    }
+
+    ring->segments = ring->step[ring->tail & RING_MASK].segments;
+    ring->period = (uint32_t)ring->hwtimer * ring->segments;
+    ring->tail++;
+
+    return(STEPPER_MOVING);
+}
+
+// run the steps of the other axes due within the coalescing window, from
+// the step interrupt of axis index after its stepper_tick()
+RAMFUNC void stepper_coalesce(uint8_t index)
+{
+    const stepper_info_t *io;
+    stepper_ring_t *ring;
+    uint32_t window, value, load;
+    uint8_t i;
+
+    if (g_coalesce_window == 0)
+    {
+        return;
+    }
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        ring = &g_stepper[i].ring;
+        io = &g_io[i];
+
+        // stepping at its next timeout, and not stopping there
+        if ((i == index)
+         || (ring->hwtimer == 0)
+         || (ring->segments > 1)
+         || (ring->tail == ring->head)
+         || (ring->step[ring->tail & RING_MASK].flags & STEP_END))
+        {
+            continue;
+        }
+
+        window = MIN(g_coalesce_window, (uint32_t)ring->hwtimer >> 3);
+        value = ROM_TimerValueGet(io->timer_base, io->timer);
+
+        if ((value < COALESCE_GUARD) || (value >= window)
+         || (ROM_TimerIntStatus(io->timer_base, false) & io->timeout))
+        {
+            continue;
+        }
+
+        // value + 1 cycles to the timeout, the popped step's period after it
+        load = value + ring->step[ring->tail & RING_MASK].hwtimer + 1;
+        if (load > 0xffff)
+        {
+            continue;
+        }
+
+        // a load write restarts the count, the tick leaves it be
+        stepper_timer_load(io, load);
+        ring->hwtimer = ring->step[ring->tail & RING_MASK].hwtimer;
+        ring->restore = 0;
+
+        stepper_tick(i);
+        g_coalesce_steps++;
+
+        // back to hwtimer at that timeout
+        ring->restore = 1;
+    }
+}
+
+// coalescing window in microseconds, 0 turns it off
+int8_t stepper_coalesce_set(uint32_t window_us)
+{
+    if (window_us > STEPPER_COALESCE_MAX_US)
+    {
+        return(STEPPER_ERROR);
+    }
+
+    g_coalesce_us = window_us;
+    g_coalesce_window = window_us * g_clock.per_us;
+
+    return(STEPPER_OK);
+}
+
+//*****************************************************************************
+//
+// Planner, run by the STEPPER task.
+//
+//*****************************************************************************
+
+// velocity of the step the interrupt is on, 0 when stopped
+static float stepper_live_velocity(const stepper_ring_t *ring)
+{
+    if (ring->period == 0)
+    {
+        return(0);
+    }
+
+    if (ring->last & STEP_FWD)
+    {
+        return(g_clock.hz_f / ring->period);
+    }
+
+    if (ring->last & STEP_BACK)
+    {
+        return(-g_clock.hz_f / ring->period);
+    }
+
+    return(0);
+}
+
+// drop the steps not taken yet and carry on from the last one that was
+static void stepper_plan_flush(uint8_t index)
+{
+    stepper_ring_t *ring = &g_stepper[index].ring;
+    stepper_state_t *state = &g_stepper[index].state;
+    tBoolean masked;
+    uint8_t last;
+
+    masked = ROM_IntMasterDisable();
+    ring->head = ring->tail;
+    last = ring->last;
+    state->moving = ring->running;
+    state->position = ring->position;
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+
+    // the phase the last entry left on the coils
+    state->phase = last & STEP_PHASE_M;
+    state->residual = 0;
+}
+
+// steps left of the counted move in progress: those queued up to its last
+// one, or all queued and those still to plan
+static uint32_t stepper_steps_left(uint8_t index)
+{
+    stepper_ring_t *ring = &g_stepper[index].ring;
+    uint8_t head = ring->head;
+    uint32_t left = 0;
+    uint8_t flags, i;
+
+    for (i=ring->tail; i!=head; i++)
+    {
+        flags = ring->step[i & RING_MASK].flags;
+
+        if ((flags & STEP_NONE) == 0)
+        {
+            left++;
+        }
+
+        if (flags & STEP_DONE)
+        {
+            return(left);
+        }
+    }
+
+    return((g_stepper[index].state.step_count != 0) ? (left + g_stepper[index].state.step_count) : 0);
+}
+
+// compare the steps output with the encoder and take up the steps lost
+static void stepper_plan_feedback(uint8_t index)
+{
+    stepper_feedback_t *fb = &g_stepper[index].feedback;
+    stepper_config_t *config = &g_stepper[index].config;
+    stepper_state_t *state = &g_stepper[index].state;
+    tBoolean masked;
+    int32_t measured, error, lost, left;
+
+    if (fb->steps_per_count == 0)
+    {
+        return;
+    }
+
+    measured = (int32_t)((float)(encoder_count(index) - fb->origin) * fb->steps_per_count);
+    error = g_stepper[index].ring.position - fb->slip - measured;
+
+    // falling further behind, a steady offset is no reason to hold
+    fb->hold = ((uint32_t)ABS(error) > (fb->tolerance >> 1)) && (ABS(error) > ABS(fb->error));
+    fb->error = error;
+
+    // in step: earn the acceleration back
+    if ((uint32_t)ABS(error) <= fb->tolerance)
+    {
+        if (!fb->hold)
+        {
+            fb->accel_scale += (1 - fb->accel_scale) * FEEDBACK_SCALE_RECOVER;
+        }
+        return;
+    }
+
+    // lost: from now on the rotor is where the encoder says
+    lost = error;
+    fb->error = 0;
+    fb->hold = 0;
+    fb->slip += lost;
+    fb->lost += ABS(lost);
+    fb->losses++;
+    fb->accel_scale = MAX(FEEDBACK_SCALE_MIN, fb->accel_scale * 0.5f);
+
+    // what is planned was planned for a rotor in step
+    masked = ROM_IntMasterDisable();
+    left = stepper_steps_left(index);
+    stepper_plan_flush(index);
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+
+    // a counted move makes up the steps lost, or drops the steps gained
+    if (left != 0)
+    {
+        state->step_count = MAX(1, left + lost * SIGN(config->vmove));
+        config->tvelocity = (state->step_count <= config->decel_steps) ?
+                            MAX(1, ABS(0.01f * config->vmove)) * SIGN(config->vmove) : config->vmove;
+    }
+
+    // back to a speed the rotor can follow, a set velocity stays
+    if (config->accel != 0)
+    {
+        state->velocity *= 0.5f;
+    }
+
+    stepper_set_period(state, config);
+
+    if (state->period != 0)
+    {
+        state->moving = 1;
+    }
+
+    LOG_WARN(LOG_STEPPER_LOST, index, lost, state->step_count);
+    event_post(EVENT_STEPS_LOST, index, (uint32_t)lost);
+}
+
+// clear the last step flag of a queued counted move, 1 if there was one
+static uint8_t stepper_ring_undone(stepper_ring_t *ring)
+{
+    uint8_t found = 0;
+    uint8_t i;
+
+    for (i=ring->tail; i!=ring->head; i++)
+    {
+        if (ring->step[i & RING_MASK].flags & STEP_DONE)
+        {
+            ring->step[i & RING_MASK].flags &= ~STEP_DONE;
+            found = 1;
+        }
+    }
+
+    return(found);
+}
+
+// take in the move stepper_start() latched
+static void stepper_plan_latch(uint8_t index)
+{
+    stepper_t *stepper = &g_stepper[index];
+    stepper_state_t *state = &stepper->state;
+    stepper_config_t *config = &stepper->config;
+    tBoolean masked;
+
+    masked = ROM_IntMasterDisable();
+    memcpy(config, &stepper->user_config, sizeof(*config));
+    stepper->mailbox = 0;
+
+    // the end of a move this one replaces no longer counts, and neither
+    // does one no stepper_waitfor() took (proto and script moves)
+    stepper_ring_undone(&stepper->ring);
+    g_done_pending &= ~(1 << index);
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+    xSemaphoreTake(stepper->sem, 0);
+
+    state->step_count = config->steps;
+    config->vmove = config->tvelocity;
+
+    if (config->accel == 0)
+    {
+        // no ramp: the new velocity from the next step on
+        stepper_plan_flush(index);
+        state->velocity = config->tvelocity;
+        stepper_set_period(state, config);
+    }
+    else if (state->period == 0)
+    {
+        stepper_set_period(state, config);
+    }
+
+    if (state->period != 0)
+    {
+        state->moving = 1;
+    }
+}
+
+// apply an e-stop, stepper_estop() already stopped the timers of a hard one
+static void stepper_plan_estop(uint8_t index, float decel)
+{
+    stepper_state_t *state = &g_stepper[index].state;
+    stepper_config_t *config = &g_stepper[index].config;
+
+    stepper_plan_flush(index);
+
+    config->tvelocity = config->vmove = 0;
+    config->accel = ABS(decel);
+    config->sem_pending = false;
+    state->step_count = 0;
+
+    // ramp down from where the axis is, not from where it was planned to be
+    state->velocity = (decel == 0) ? 0 : stepper_live_velocity(&g_stepper[index].ring);
+    stepper_set_period(state, config);
+}
+
+// VELOCITY triggers the planned step lands on, from the next step on
+static void stepper_plan_triggers(uint8_t index)
+{
+    stepper_triggers_t *triggers = &g_stepper[index].triggers;
+    stepper_config_t *config = &g_stepper[index].config;
+    stepper_state_t *state = &g_stepper[index].state;
+    stepper_trigger_t *trigger;
+    uint8_t i;
+
+    for (i=0; i<triggers->count; i++)
+    {
+        trigger = &triggers->trigger[i];
+
+        if (!trigger->armed
+         || (trigger->action != STEPPER_TRIGGER_VELOCITY)
+         || (trigger->position != state->position))
+        {
+            continue;
+        }
+
+        trigger->armed = 0;
+        config->vmove = config->tvelocity = trigger->velocity;
+
+        // a counted move brakes in time for its end at the new velocity
+        if (state->step_count != 0)
+        {
+            config->decel_steps = MIN(state->step_count,
+                                      (uint32_t)stepper_brake_steps(index, trigger->velocity, config->accel, config->curve_scale));
+        }
+
+        if (config->accel == 0)
+        {
+            state->velocity = trigger->velocity;
+            stepper_set_period(state, config);
+        }
+    }
+}
+
+// plan the next step of an axis, 0 when it has none
+static uint8_t stepper_plan_step(uint8_t index, stepper_step_t *step)
+{
+    stepper_config_t *config = &g_stepper[index].config;
+    stepper_state_t *state = &g_stepper[index].state;
+    uint32_t period, segments;
+
+    // are we velocitying up/slowing down?
+    // if so, set up an intermediate velocity until the next step
+    if ((state->period != 0)
+     && (config->accel != 0)
+     && (state->velocity != config->tvelocity))
+    {
+        int8_t accel_sign = SIGN(config->tvelocity - state->velocity);
+        float accel = config->accel * g_stepper[index].feedback.accel_scale;
+
+        // no more than the motor has torque for at this speed; "scv" may
+        // have removed the curve since the move was set up
+        if ((config->curve_scale != 0) && (g_stepper[index].curve.vmax != 0))
+        {
+            accel = MIN(accel, stepper_curve_accel(&g_stepper[index].curve, config->curve_scale,
+                                                   config->curve_inv, state->velocity));
+        }
+
+        // the rotor lags, let it catch up before speeding up further
+        if (g_stepper[index].feedback.hold && (SIGN(state->velocity) == accel_sign))
+        {
+            accel = 0;
+        }
+
+        // accelerate over the period since the last step
+        state->velocity += accel_sign * accel * (state->period * g_clock.inv_hz_f);
+
+        if (((accel_sign > 0) && (state->velocity >= config->tvelocity))
+         || ((accel_sign < 0) && (state->velocity <= config->tvelocity)))
+        {
+            // velocity reached
+            state->velocity = config->tvelocity;
+        }
+
+        stepper_set_period(state, config);
+    }
+
+    if (state->period == 0)                         // stopped?
+    {
+        if (!state->moving)
+        {
+            // wait until we have something to do
+            return(0);
+        }
+
+        // one last entry switches the timer off
+        state->moving = 0;
+        step->hwtimer = 0;
+        step->segments = 0;
+        step->flags = STEP_END | STEP_NONE | state->phase;
+
+        return(1);
+    }
+
+    // Advance phase, the step outputs the phase it moves to
+    if (state->velocity > 0)
+    {
+        state->phase = (state->phase + 1) & STEP_PHASE_M;
+        state->position++;
+        step->flags = STEP_FWD | state->phase;
+    }
+    else if (state->velocity < 0)
+    {
+        state->phase = (state->phase - 1) & STEP_PHASE_M;
+        state->position--;
+        step->flags = STEP_BACK | state->phase;
+    }
+    else
+    {
+        step->flags = state->phase;
+    }
+
+    if (g_stepper[index].triggers.count != 0)
+    {
+        stepper_plan_triggers(index);
+    }
+
+    // do the step counting
+    if (state->step_count != 0)
+    {
+        state->step_count--;
+
+        // brake over the last decel_steps, down to the jumpstart velocity
+        // so the count runs out before the ramp does
+        if (state->step_count <= config->decel_steps)
+        {
+            config->tvelocity = MAX(1, ABS(0.01f * config->vmove)) * SIGN(config->vmove);
+        }
+        else
+        {
+            config->tvelocity = config->vmove;
+        }
+
+        if (state->step_count == 0) // stop
+        {
+            config->tvelocity = state->velocity = 0;
+            state->period = 0;
+            state->moving = 0;
+
+            step->hwtimer = 0;
+            step->segments = 0;
+            step->flags |= STEP_END | (config->sem_pending ? STEP_DONE : 0);
+
+            return(1);
+        }
+    }
+
+    // split the period into as few hw timer periods as fit the 16-bit
+    // timer; what the split leaves over goes to the next step
+    period = state->period + state->residual;
+    segments = (period >> 16) + 1;
+
+    step->hwtimer = period / segments;
+    step->segments = segments;
+    state->residual = period - (step->hwtimer * segments);
+
+    return(1);
+}
+
+// one planner pass: apply an e-stop, latch started moves and top every ring
+// up to STEPPER_PLAN_AHEAD_MS of steps, then start the idle axes that have
+// steps, all at the same instant
+void stepper_plan(void)
+{
+    uint32_t ahead = STEPPER_PLAN_AHEAD_MS * g_clock.per_ms;
+    stepper_step_t step;
+    stepper_ring_t *ring;
+    tBoolean masked;
+    uint8_t estop, level, i;
+    float decel;
+
+    masked = ROM_IntMasterDisable();
+    estop = g_estop.mask;
+    decel = g_estop.decel;
+    g_estop.mask = 0;
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        ring = &g_stepper[i].ring;
+
+        // its master's interrupt steps a slave
+        if (g_stepper[i].gear.engaged)
+        {
+            g_stepper[i].mailbox = 0;
+            continue;
+        }
+
+        if (estop & (1 << i))
+        {
+            stepper_plan_estop(i, decel);
+        }
+
+        stepper_plan_feedback(i);
+
+        if (g_stepper[i].mailbox == 1)
+        {
+            stepper_plan_latch(i);
+        }
+
+        // a ring's worth, or STEPPER_PLAN_AHEAD_MS at the current rate
+        level = (uint8_t)(ring->head - ring->tail);
+
+        while ((level < RING_MASK)
+            && ((level == 0) || (g_stepper[i].state.period <= (ahead / level))))
+        {
+            if (!stepper_plan_step(i, &step))
+            {
+                break;
+            }
+
+            ring->step[ring->head & RING_MASK].hwtimer = step.hwtimer;
+            ring->step[ring->head & RING_MASK].segments = step.segments;
+            ring->step[ring->head & RING_MASK].flags = step.flags;
+            ring->head++;
+            level++;
+        }
+    }
+
+    masked = ROM_IntMasterDisable();
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        ring = &g_stepper[i].ring;
+
+        // kickstart, unless an e-stop came in meanwhile or a trigger will
+        if (!ring->running
+         && (ring->head != ring->tail)
+         && (((g_estop.mask | g_start_hold) & (1 << i)) == 0))
+        {
+            ring->running = 1;
+            ROM_IntPendSet(g_io[i].interrupt);
+        }
+    }
+
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+}
+
+// stepper cmd from user
+int8_t stepper_go(uint8_t index, float velocity, float acceleration, int32_t steps)
+{
+    uint32_t decel_steps = 0;
+
+    if (index >= STEPPER_MAX)
+    {
+        return(STEPPER_ERROR);
+    }
+
+    // decelerate over the braking distance, or from half way through the
+    // move if cruise is never reached
+    if (acceleration != 0)
+    {
+        velocity = MIN(ABS(velocity), stepper_top_sps(index)) * SIGN(velocity);
+        decel_steps = MIN((uint32_t)ABS(steps) >> 1,
+                          stepper_brake_steps(index, velocity, acceleration, 1));
+    }
+
+    if (stepper_setup(index, velocity, acceleration, steps, decel_steps, 1) != STEPPER_OK)
+    {
+        return(STEPPER_ERROR);
+    }
+
+    return(stepper_start(1 << index));
+}
+
+// stage a move without starting it, see stepper_start(); curve_scale
+// applies the torque curve scaled by it (1 for a move of its own)
+int8_t stepper_setup(uint8_t index, float velocity, float acceleration, int32_t steps, uint32_t decel_steps, float curve_scale)
+{
+    stepper_config_t *config;
+    stepper_curve_t *curve;
+
+    // a slave moves with its master only
+    if ((index >= STEPPER_MAX) || g_stepper[index].gear.engaged)
+    {
+        return(STEPPER_ERROR);
+    }
+
+    config = &g_stepper[index].user_config;
+    curve = &g_stepper[index].curve;
+
+    config->curve_scale = 0;
+    config->curve_inv = 0;
+
+    if ((curve->vmax != 0) && (curve_scale != 0))
+    {
+        velocity = MIN(ABS(velocity), curve->vmax) * SIGN(velocity);
+
+        config->curve_scale = ABS(curve_scale);
+        config->curve_inv = curve->inv_step / config->curve_scale;
+    }
+
+   // negative steps => flip velocity
+   if (steps < 0)
+   {
+       steps = -steps;
+       velocity = -velocity;
+   }
+
+    // save parameters
+    config->steps = steps;
+    config->tvelocity = velocity;      // STEP-PER-SECOND
+    config->accel = ABS(acceleration); // SPS^2
+    config->decel_steps = decel_steps; // STEPS left when braking starts
+
+    // use semaphore if moving a number of steps
+    if (config->steps != 0)
+    {
+        config->sem_pending = true;
+    } else {
+        config->sem_pending = false;
+    }
+
+    LOG_INFO(LOG_STEPPER_SETUP, index, logger_float(config->tvelocity), logger_float(config->accel),
+             config->steps, config->decel_steps, config->sem_pending);
+
+    return(STEPPER_OK);
+}
+
+// axes in mask whose staged move ends on a step count, the ones a done
+// event will follow once started
+uint8_t stepper_counted(uint8_t mask)
+{
+    uint8_t counted = 0;
+    uint8_t i;
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        if ((mask & (1 << i)) && g_stepper[i].user_config.sem_pending)
+        {
+            counted |= 1 << i;
+        }
+    }
+
+    return(counted);
+}
+
+// latch the staged configs of all steppers in mask at the same instant
+int8_t stepper_start(uint8_t mask)
+{
+    tBoolean masked;
+    uint8_t i;
+
+    // the planner takes every mailbox in one pass
+    masked = ROM_IntMasterDisable();
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        if (mask & (1 << i))
+        {
+            g_stepper[i].mailbox = 1;
+        }
+    }
+
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+
+    // plan and kickstart them now rather than at the next tick
+    stepper_task_wake();
+
+    return(STEPPER_OK);
+}
+
+// curve points per SPS of a move on a curve that changed under it
+static void stepper_curve_rescale(stepper_config_t *config, const stepper_curve_t *curve)
+{
+    if (config->curve_scale != 0)
+    {
+        config->curve_inv = curve->inv_step / config->curve_scale;
+    }
+}
+
+// set the torque curve of an axis, vmax 0 removes it
+int8_t stepper_curve(uint8_t index, float vmax, const float *accel)
+{
+    stepper_curve_t curve;
+    unsigned long mask;
+    uint8_t i;
+
+    if (index >= STEPPER_MAX)
+    {
+        return(STEPPER_ERROR);
+    }
+
+    memset(&curve, 0, sizeof(curve));
+
+    if (vmax != 0)
+    {
+        for (i=0; i<STEPPER_CURVE_POINTS; i++)
+        {
+            // the ramp would stall below vmax
+            if (accel[i] <= 0)
+            {
+                return(STEPPER_ERROR);
+            }
+
+            curve.accel[i] = accel[i];
+        }
+
+        curve.vmax = ABS(vmax);
+        curve.inv_step = (STEPPER_CURVE_POINTS - 1) / curve.vmax;
+    }
+
+    // the planner task reads it mid ramp and stepper_setup() stages moves on
+    // it; masking the kernel interrupts keeps both out, the step interrupts
+    // never look at it and keep running
+    mask = portSET_INTERRUPT_MASK_FROM_ISR();
+    g_stepper[index].curve = curve;
+
+    // the move under way, and the one staged, follow the new curve
+    stepper_curve_rescale(&g_stepper[index].config, &curve);
+    stepper_curve_rescale(&g_stepper[index].user_config, &curve);
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+
+    return(STEPPER_OK);
+}
+
+// top speed of an axis, unlimited without a curve
+float stepper_top_sps(uint8_t index)
+{
+    if ((index >= STEPPER_MAX) || (g_stepper[index].curve.vmax == 0))
+    {
+        return(HUGE_VALF);
+    }
+
+    return(g_stepper[index].curve.vmax);
+}
+
+// steps to brake from velocity to a stop at up to acceleration, following
+// the torque curve scaled by curve_scale
+float stepper_brake_steps(uint8_t index, float velocity, float acceleration, float curve_scale)
+{
+    const stepper_curve_t *curve;
+    float v, dv, accel, inv;
+    float steps = 0;
+    uint8_t i;
+
+    velocity = ABS(velocity);
+    acceleration = ABS(acceleration);
+    curve_scale = ABS(curve_scale);
+
+    if ((index >= STEPPER_MAX) || (acceleration == 0))
+    {
+        return(0);
+    }
+
+    curve = &g_stepper[index].curve;
+
+    if ((curve->vmax == 0) || (curve_scale == 0))
+    {
+        return((0.5f * velocity * velocity) / acceleration);
+    }
+
+    // sum of v dv / a(v), midpoint rule
+    inv = curve->inv_step / curve_scale;
+    dv = velocity * (1.0f / BRAKE_SLICES);
+
+    for (i=0, v=0.5f*dv; i<BRAKE_SLICES; i++, v+=dv)
+    {
+        accel = MIN(acceleration, stepper_curve_accel(curve, curve_scale, inv, v));
+        steps += (v * dv) / accel;
+    }
+
+    return(steps);
+}
+
+// close the loop of an axis over its encoder (see encoder_attach()),
+// counts_per_step 0 opens it; tolerance 0 takes the default
+int8_t stepper_feedback(uint8_t index, float counts_per_step, uint32_t tolerance)
+{
+    stepper_feedback_t *fb;
+    tBoolean masked;
+
+    if (index >= STEPPER_MAX)
+    {
+        return(STEPPER_ERROR);
+    }
+
+    fb = &g_stepper[index].feedback;
+
+    // the planner samples it at the same time as the position
+    masked = ROM_IntMasterDisable();
+
+    fb->steps_per_count = (counts_per_step != 0) ? (1 / counts_per_step) : 0;
+    fb->tolerance = (tolerance != 0) ? tolerance : FEEDBACK_TOLERANCE;
+    fb->origin = encoder_count(index);
+    fb->slip = g_stepper[index].ring.position;
+    fb->accel_scale = 1;
+    fb->hold = 0;
+    fb->error = 0;
+
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+
+    return(STEPPER_OK);
+}
+
+// ratio change per master step to get to the target in ramp_steps
+static void stepper_gear_ramp(stepper_gear_t *gear, uint32_t ramp_steps)
+{
+    int32_t delta = gear->target - gear->ratio;
+
+    if ((ramp_steps == 0) || (delta == 0))
+    {
+        gear->ratio = gear->target;
+        gear->ramp = 0;
+        return;
+    }
+
+    gear->ramp = delta / (int32_t)MIN(ramp_steps, (uint32_t)INT32_MAX);
+
+    if (gear->ramp == 0)
+    {
+        gear->ramp = SIGN(delta);
+    }
+}
+
+// pins of trigger port a GPIO trigger must leave alone: the coils of every
+// axis, UART0 (PA0/PA1) and the inputs of the encoders attached
+static uint8_t stepper_trigger_pins_taken(uint8_t port)
+{
+    uint8_t pins;
+    uint8_t i;
+
+    pins = encoder_pins(g_gpio_base[port]);
+
+    if (g_gpio_base[port] == GPIO_PORTA_BASE)
+    {
+        pins |= GPIO_PIN_0 | GPIO_PIN_1;
+    }
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        if (g_io[i].io_port == g_gpio_base[port])
+        {
+            pins |= g_pin_mask << g_io[i].base_pin;
+        }
+    }
+
+    return(pins);
+}
+
+// act when axis index reaches position (see stepper_position()), either
+// way, once; arg and velocity as stepper_trigger_action_t says. Triggers
+// that fired make room for new ones. A START
+// trigger takes the moves its axes have staged with stepper_setup() now and
+// holds them, planned, until it fires.
+int8_t stepper_trigger(uint8_t index, int32_t position, uint8_t action, uint16_t arg, float velocity)
+{
+    stepper_triggers_t *triggers;
+    stepper_trigger_t trigger;
+    tBoolean masked;
+    uint8_t i, j;
+
+    if ((index >= STEPPER_MAX) || (action >= STEPPER_TRIGGER_MAX))
+    {
+        return(STEPPER_ERROR);
+    }
+
+    triggers = &g_stepper[index].triggers;
+
+    if (action == STEPPER_TRIGGER_GPIO)
+    {
+        if (((arg >> 8) >= STEPPER_TRIGGER_PORTS) || ((arg & 0xff) == 0)
+         || (arg & stepper_trigger_pins_taken(arg >> 8)))
+        {
+            return(STEPPER_ERROR);
+        }
+
+        SysCtlPeripheralEnable(g_gpio_periph[arg >> 8]);
+        GPIOPinTypeGPIOOutput(g_gpio_base[arg >> 8], arg & 0xff);
+    }
+
+    if (action == STEPPER_TRIGGER_START)
+    {
+        arg &= (1 << STEPPER_MAX) - 1;
+
+        // only axes at rest can wait for it
+        for (i=0; i<STEPPER_MAX; i++)
+        {
+            if ((arg & (1 << i))
+             && ((i == index) || g_stepper[i].ring.running || (g_stepper[i].state.period != 0)))
+            {
+                return(STEPPER_ERROR);
+            }
+        }
+    }
+
+    trigger.position = position;
+    trigger.action = action;
+    trigger.armed = 1;
+    trigger.arg = arg;
+    trigger.velocity = velocity;
+
+    masked = ROM_IntMasterDisable();
+
+    // make room from the triggers that fired
+    for (i=0, j=0; i<triggers->count; i++)
+    {
+        if (triggers->trigger[i].armed)
+        {
+            triggers->trigger[j++] = triggers->trigger[i];
+        }
+        else if (i < triggers->cursor)
+        {
+            triggers->cursor--;
+        }
+    }
+    triggers->count = j;
+
+    if (triggers->count == STEPPER_TRIGGERS)
+    {
+        if (!masked)
+        {
+            ROM_IntMasterEnable();
+        }
+
+        return(STEPPER_ERROR);
+    }
+
+    // in order, after those at the same position
+    for (i=triggers->count; (i > 0) && (triggers->trigger[i - 1].position > position); i--)
+    {
+        triggers->trigger[i] = triggers->trigger[i - 1];
+    }
+    triggers->trigger[i] = trigger;
+    triggers->count++;
+
+    if (triggers->cursor > i)
+    {
+        triggers->cursor++;
+    }
+    else if (position <= g_stepper[index].ring.position)
+    {
+        triggers->cursor++;
+    }
+
+    if (action == STEPPER_TRIGGER_START)
+    {
+        g_start_hold |= arg;
+
+        for (i=0; i<STEPPER_MAX; i++)
+        {
+            if (arg & (1 << i))
+            {
+                g_stepper[i].mailbox = 1;
+            }
+        }
+    }
+
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+
+    if (action == STEPPER_TRIGGER_START)
+    {
+        stepper_task_wake();
+    }
+
+    return(STEPPER_OK);
+}
+
+// drop every trigger of axis index, and the moves its START triggers hold
+int8_t stepper_trigger_clear(uint8_t index)
+{
+    stepper_triggers_t *triggers;
+    stepper_ring_t *ring;
+    tBoolean masked;
+    uint8_t hold = 0;
+    uint8_t i;
+
+    if (index >= STEPPER_MAX)
+    {
+        return(STEPPER_ERROR);
+    }
+
+    triggers = &g_stepper[index].triggers;
+
+    masked = ROM_IntMasterDisable();
+
+    for (i=0; i<triggers->count; i++)
+    {
+        if (triggers->trigger[i].armed && (triggers->trigger[i].action == STEPPER_TRIGGER_START))
+        {
+            hold |= triggers->trigger[i].arg & g_start_hold;
+        }
+    }
+
+    triggers->count = 0;
+    triggers->cursor = 0;
+
+    // not kicked, the interrupt does not own any of it
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        if (hold & (1 << i))
+        {
+            ring = &g_stepper[i].ring;
+            ring->tail = ring->head;
+            g_stepper[i].mailbox = 0;
+            g_stepper[i].state.step_count = 0;
+            g_stepper[i].state.period = 0;
+            g_stepper[i].state.velocity = 0;
+            g_stepper[i].state.moving = 0;
+            g_stepper[i].state.position = ring->position;
+            g_stepper[i].config.tvelocity = g_stepper[i].config.vmove = 0;
+        }
+    }
+
+    g_start_hold &= ~hold;
+
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+
+    return(STEPPER_OK);
+}
+
+// steps output since power up, forward counting up
+int32_t stepper_position(uint8_t index)
+{
+    return((index < STEPPER_MAX) ? g_stepper[index].ring.position : 0);
+}
+
+// gear axis slave to master at p/q steps per master step, |p| <= q,
+// ramping the ratio in over ramp_steps of the master. The slave must be at
+// rest; a slave already geared to master ramps to the new ratio.
+int8_t stepper_gear(uint8_t slave, uint8_t master, int16_t p, uint16_t q, uint32_t ramp_steps)
+{
+    stepper_gear_t *gear;
+    const stepper_info_t *io;
+    tBoolean masked;
+    uint8_t coils;
+
+    if ((slave >= STEPPER_MAX) || (master >= STEPPER_MAX) || (slave == master)
+     || (p == 0) || (q == 0) || (q > INT16_MAX) || (ABS(p) > q))
+    {
+        return(STEPPER_ERROR);
+    }
+
+    gear = &g_stepper[slave].gear;
+
+    // no chains
+    if (g_stepper[master].gear.engaged || (g_gear_slaves[slave] != 0))
+    {
+        return(STEPPER_ERROR);
+    }
+
+    if (gear->engaged)
+    {
+        if (gear->master != master)
+        {
+            return(STEPPER_ERROR);
+        }
+    }
+    else if (g_stepper[slave].ring.running
+          || (g_stepper[slave].ring.head != g_stepper[slave].ring.tail)
+          || (g_stepper[slave].state.period != 0)
+          || (g_stepper[slave].mailbox != 0))
+    {
+        return(STEPPER_ERROR);
+    }
+
+    masked = ROM_IntMasterDisable();
+
+    if (!gear->engaged)
+    {
+        // take up the phase the coils hold, or the planner's if they are off
+        io = &g_io[slave];
+        coils = (HWREG(io->io_port + GPIO_O_DATA + ((g_pin_mask << io->base_pin) << 2)) >> io->base_pin) & g_pin_mask;
+
+        for (gear->phase=0; gear->phase<8; gear->phase++)
+        {
+            if (g_phase_bits[gear->phase] == coils)
+            {
+                break;
+            }
+        }
+
+        if (gear->phase == 8)
+        {
+            gear->phase = g_stepper[slave].state.phase;
+        }
+
+        gear->master = master;
+        gear->ratio = 0;
+        gear->acc = 0;
+    }
+
+    if (gear->q != q)
+    {
+        gear->ratio = (int32_t)((int64_t)gear->ratio * q / MAX(gear->q, 1));
+        gear->acc = 0;
+    }
+
+    gear->p = p;
+    gear->q = q;
+    gear->target = (int32_t)p << GEAR_FRAC_BITS;
+    gear->releasing = 0;
+    stepper_gear_ramp(gear, ramp_steps);
+
+    gear->engaged = 1;
+    g_gear_slaves[master] |= 1 << slave;
+
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+
+    return(STEPPER_OK);
+}
+
+// let slave go, ramping the ratio out over ramp_steps of its master
+int8_t stepper_gear_release(uint8_t slave, uint32_t ramp_steps)
+{
+    stepper_gear_t *gear;
+    tBoolean masked;
+
+    if (slave >= STEPPER_MAX)
+    {
+        return(STEPPER_ERROR);
+    }
+
+    gear = &g_stepper[slave].gear;
+
+    masked = ROM_IntMasterDisable();
+
+    if (gear->engaged)
+    {
+        gear->target = 0;
+        gear->releasing = 1;
+        stepper_gear_ramp(gear, ramp_steps);
+
+        if (gear->ratio == 0)
+        {
+            stepper_gear_detach(slave);
+        }
+    }
+
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+
+    return(STEPPER_OK);
+}
+
+// stop
+int8_t stepper_stop(uint8_t index, uint8_t hard_stop)
+{
+    if (index >= STEPPER_MAX)
+    {
+        return(STEPPER_ERROR);
+    }
+
+    if (hard_stop == 1)
+    {
+      stepper_go(index, 0, 0, 0);
+    }
+    else
+    {
+      stepper_go(index, 0, g_stepper[index].config.accel, 0);
+    }
+
+    LOG_INFO(LOG_STEPPER_STOP, index);
+    return(STEPPER_OK);
+}
+
+// emergency stop of every axis, callable from any context including
+// interrupts above configMAX_SYSCALL_INTERRUPT_PRIORITY: no kernel calls,
+// no logging. decel == 0 stops dead here and now, otherwise the planner
+// ramps down at decel SPS^2 from its next pass on.
+void stepper_estop(float decel)
+{
+    stepper_config_t *config;
+    stepper_state_t *state;
+    stepper_ring_t *ring;
+    tBoolean masked;
+    uint8_t i;
+
+    masked = ROM_IntMasterDisable();
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        config = &g_stepper[i].config;
+        state = &g_stepper[i].state;
+        ring = &g_stepper[i].ring;
+
+        // drop any move not latched yet
+        g_stepper[i].mailbox = 0;
+
+        // release the waiters of an interrupted sequence
+        if (stepper_ring_undone(ring)
+         || ((config->sem_pending == true) && (state->step_count != 0)))
+        {
+            g_done_pending |= 1 << i;
+        }
+
+        if (decel == 0)
+        {
+            stepper_timer_load(&g_io[i], 0); // stopped, timer off
+            ring->tail = ring->head;
+            ring->running = 0;
+            ring->restore = 0;
+            ring->segments = 0;
+            ring->hwtimer = 0;
+            ring->period = 0;
+        }
+    }
+
+    // held moves are dropped with the rest
+    g_start_hold = 0;
+
+    g_estop.decel = decel;
+    g_estop.mask = (1 << STEPPER_MAX) - 1;
+
+    if (g_done_pending != 0)
+    {
+        ROM_IntPendSet(STEPPER_DONE_INT);
+    }
+
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+}
+
+// the system clock moved from old_hz to g_clock.hz, keep every axis at its
+// velocity; called by clock_set() with interrupts masked
+void stepper_reclock(uint32_t old_hz)
+{
+    stepper_state_t *state;
+    stepper_ring_t *ring;
+    uint32_t period, segments;
+    uint8_t i, j;
+
+    g_coalesce_window = g_coalesce_us * g_clock.per_us;
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        state = &g_stepper[i].state;
+        ring = &g_stepper[i].ring;
+
+        // planned steps keep their duration
+        for (j=ring->tail; j!=ring->head; j++)
+        {
+            period = ((uint64_t)ring->step[j & RING_MASK].hwtimer * ring->step[j & RING_MASK].segments * g_clock.hz) / old_hz;
+            segments = (period >> 16) + 1;
+
+            ring->step[j & RING_MASK].hwtimer = period / segments;
+            ring->step[j & RING_MASK].segments = segments;
+        }
+
+        // the step in progress as near as the 16-bit timer goes
+        if (ring->hwtimer != 0)
+        {
+            ring->hwtimer = mathk_usat16(((uint64_t)ring->hwtimer * g_clock.hz) / old_hz);
+            ring->period = (uint32_t)ring->hwtimer * ring->segments;
+            stepper_timer_load(&g_io[i], ring->hwtimer);
+        }
+
+        state->period = ((uint64_t)state->period * g_clock.hz) / old_hz;
+        state->residual = 0;
+    }
+}
+
+int8_t stepper_idle(uint8_t index)
+{
+    if (index >= STEPPER_MAX)
+    {
+        return(STEPPER_ERROR);
+    }
+
+    stepper_gear_release(index, 0);
+    stepper_stop(index, 1); // stop first
+    GPIOPinWrite(g_io[index].io_port, g_pin_mask << g_io[index].base_pin, 0); // turn off stepper drive
+
+    LOG_INFO(LOG_STEPPER_IDLE, index);
+    return(STEPPER_OK);
+}
+
+// print out status
+int8_t stepper_status(uint8_t index)
+{
+    stepper_config_t config;
+    stepper_state_t state;
+    stepper_snapshot_t snap;
+    stepper_ring_t *ring;
+    uint8_t i;
+
+    if (index >= STEPPER_MAX)
+    {
+        return(STEPPER_ERROR);
+    }
+
+    config = g_stepper[index].config;
+    state = g_stepper[index].state;
+    ring = &g_stepper[index].ring;
+    stepper_snapshot(index, &snap);
+
+    console_printf("stepper_status: velocity %.2f SPS, target velocity %.2f SPS, accel %.2f, steps %i, step_count %i, mailbox %i, position %i\n"
+                   "    planned: velocity %.2f SPS, delay %i, step_count %i, queued %i, underruns %u\n",
+                   snap.velocity, config.tvelocity, config.accel, config.steps, snap.step_count, g_stepper[index].mailbox, ring->position,
+                   state.velocity, (int32_t)state.period, state.step_count, (uint8_t)(ring->head - ring->tail), ring->underruns);
+
+    if (g_stepper[index].feedback.steps_per_count != 0)
+    {
+        const stepper_feedback_t *fb = &g_stepper[index].feedback;
+
+        console_printf("    feedback: position %i, error %i, tolerance %u, lost %u in %u, accel x%.3f\n",
+                       ring->position - fb->slip, fb->error, fb->tolerance, fb->lost, fb->losses, fb->accel_scale);
+    }
+
+    if (g_stepper[index].gear.engaged)
+    {
+        const stepper_gear_t *gear = &g_stepper[index].gear;
+
+        console_printf("    gear: master %i, ratio %i/%u, now %.3f%s\n", gear->master, gear->p, gear->q,
+                       (float)gear->ratio / ((int32_t)gear->q << GEAR_FRAC_BITS), gear->releasing ? ", releasing" : "");
+    }
+
+    for (i=0; i<g_stepper[index].triggers.count; i++)
+    {
+        const stepper_trigger_t *trigger = &g_stepper[index].triggers.trigger[i];
+
+        console_printf("    trigger: position %i, action %i, arg 0x%x, velocity %.2f%s\n", trigger->position,
+                       trigger->action, trigger->arg, trigger->velocity, trigger->armed ? "" : ", fired");
+    }
+
+    if (g_stepper[index].curve.vmax != 0)
+    {
+        const stepper_curve_t *curve = &g_stepper[index].curve;
+
+        console_printf("    curve: vmax %.0f SPS, accel %.0f %.0f %.0f %.0f %.0f %.0f SPS^2\n", curve->vmax,
+                       curve->accel[0], curve->accel[1], curve->accel[2], curve->accel[3], curve->accel[4], curve->accel[5]);
+    }
+
+    return(STEPPER_OK);
+}
+
+// consistent copy of the live state, for telemetry and host links
+int8_t stepper_snapshot(uint8_t index, stepper_snapshot_t *snap)
+{
+    tBoolean masked;
+
+    if (index >= STEPPER_MAX)
+    {
+        return(STEPPER_ERROR);
+    }
+
+    // the queue is read as the step interrupt leaves it
+    snap->step_count = stepper_steps_left(index);
+
+    masked = ROM_IntMasterDisable();
+
+    snap->velocity = stepper_live_velocity(&g_stepper[index].ring);
+    snap->tvelocity = g_stepper[index].config.tvelocity;
+
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+
+    return(STEPPER_OK);
+}
+
+// all STEPPER_MAX axes sampled at the same instant
+void stepper_snapshot_all(stepper_snapshot_t *snap)
+{
+    tBoolean masked;
+    uint8_t i;
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        snap[i].step_count = stepper_steps_left(i);
+    }
+
+    masked = ROM_IntMasterDisable();
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        snap[i].velocity = stepper_live_velocity(&g_stepper[i].ring);
+        snap[i].tvelocity = g_stepper[i].config.tvelocity;
+    }
+
+    if (!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+}
+
+// called from the done interrupt with the mask of the axes whose counted
+// or e-stopped sequence ended, returns pdTRUE if it woke a task; set once,
+// before the scheduler starts
+void stepper_set_done_handler(stepper_done_handler_t handler)
+{
+    g_done_handler = handler;
+}
+
+// mask of the axes stepping, or with a move planned or posted
+uint8_t stepper_busy(void)
+{
+    uint8_t mask = 0;
+    uint8_t i;
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        if (g_stepper[i].ring.running || g_stepper[i].state.moving || (g_stepper[i].mailbox != 0)
+         || g_stepper[i].gear.engaged)
+        {
+            mask |= 1 << i;
+        }
+    }
+
+    return(mask);
+}
+
+// wait for completion of step sequence
+int8_t stepper_waitfor(uint8_t index)
+{
+    stepper_state_t *state;
+    stepper_config_t *config;
+    xSemaphoreHandle sem;
+
+    if (index >= STEPPER_MAX)
+    {
+        return(STEPPER_ERROR);
+    }
+
+    state = &g_stepper[index].state;
+    config = &g_stepper[index].config;
+    sem = g_stepper[index].sem;
+
+    if (config->sem_pending == true)
+    {
+        LOG_DEBUG(LOG_STEPPER_WAITFOR, index);
+        xSemaphoreTake(sem, portMAX_DELAY);
+    }
+    else
+    {
+        LOG_WARN(LOG_STEPPER_NOWAIT, index);
+        return(STEPPER_ERROR); // nothing to wait on
+    }
+
+    return(STEPPER_OK);
+}
+
+//*****************************************************************************
+//
+// Shell commands.
+//
+//*****************************************************************************
+static void stepper_cmd_go(const shell_arg_t *arg)
+{
+    stepper_go(arg[0].i, arg[1].f, arg[2].f, arg[3].i);
+}
+
+static void stepper_cmd_idle(const shell_arg_t *arg)
+{
+    stepper_idle(arg[0].i);
+}
+
+static void stepper_cmd_stop(const shell_arg_t *arg)
+{
+    stepper_stop(arg[0].i, arg[1].i);
+}
+
+static void stepper_cmd_status(const shell_arg_t *arg)
+{
+    stepper_status(arg[0].i);
+}
+
+static void stepper_cmd_coalesce(const shell_arg_t *arg)
+{
+    if (stepper_coalesce_set(arg[0].i) != STEPPER_OK)
+    {
+        console_printf("stepper_coalesce: window up to %i us\n", STEPPER_COALESCE_MAX_US);
+    }
+
+    console_printf("stepper_coalesce: window %i us, %u steps run early\n", g_coalesce_us, g_coalesce_steps);
+}
+
+static void stepper_cmd_feedback(const shell_arg_t *arg)
+{
+    if (stepper_feedback(arg[0].i, arg[1].f, arg[2].i) != STEPPER_OK)
+    {
+        console_printf("stepper_feedback: bad axis\n");
+    }
+}
+
+static void stepper_cmd_trigger(const shell_arg_t *arg)
+{
+    if (stepper_trigger(arg[0].i, arg[1].i, arg[2].i, arg[3].i, arg[4].f) != STEPPER_OK)
+    {
+        console_printf("stepper_trigger: bad action or arg, pins taken, table full, or START axis busy\n");
+    }
+}
+
+static void stepper_cmd_trigger_clear(const shell_arg_t *arg)
+{
+    stepper_trigger_clear(arg[0].i);
+}
+
+static void stepper_cmd_gear(const shell_arg_t *arg)
+{
+    if (stepper_gear(arg[0].i, arg[1].i, arg[2].i, arg[3].i, arg[4].i) != STEPPER_OK)
+    {
+        console_printf("stepper_gear: bad ratio, slave busy or geared elsewhere\n");
+    }
+}
+
+static void stepper_cmd_gear_release(const shell_arg_t *arg)
+{
+    stepper_gear_release(arg[0].i, arg[1].i);
+}
+
+static void stepper_cmd_curve(const shell_arg_t *arg)
+{
+    float accel[STEPPER_CURVE_POINTS];
+    uint8_t i;
+
+    for (i=0; i<STEPPER_CURVE_POINTS; i++)
+    {
+        accel[i] = arg[2 + i].f;
+    }
+
+    if (stepper_curve(arg[0].i, arg[1].f, accel) != STEPPER_OK)
+    {
+        console_printf("stepper_curve: every accel must be > 0\n");
+    }
+}
+
+SHELL_COMMAND(sg, "sg", "if|fi", "(stepper go) sid, sps, a, st", stepper_cmd_go);
+SHELL_COMMAND(si, "si", "i", "(stepper idle) sid", stepper_cmd_idle);
+SHELL_COMMAND(ss, "ss", "i|i", "(stepper stop) sid, hard_stop_flag", stepper_cmd_stop);
+SHELL_COMMAND(sst, "sst", "i", "(stepper status) sid", stepper_cmd_status);
+SHELL_COMMAND(scv, "scv", "if|ffffff", "(stepper curve) sid, vmax, a0..a5 (vmax 0: off)", stepper_cmd_curve);
+SHELL_COMMAND(sfb, "sfb", "if|i", "(stepper feedback) sid, counts/step (0 off), tolerance", stepper_cmd_feedback);
+SHELL_COMMAND(stg, "stg", "iiii|f", "(stepper trigger) sid, position, action 0 gpio 1 start 2 velocity 3 event, arg, sps", stepper_cmd_trigger);
+SHELL_COMMAND(stc, "stc", "i", "(stepper trigger clear) sid", stepper_cmd_trigger_clear);
+SHELL_COMMAND(sgr, "sgr", "iiii|i", "(stepper gear) slave sid, master sid, p, q, ramp steps", stepper_cmd_gear);
+SHELL_COMMAND(sgx, "sgx", "i|i", "(stepper gear release) slave sid, ramp steps", stepper_cmd_gear_release);
+SHELL_COMMAND(sco, "sco", "i", "(stepper coalescing) window_us, 0 off", stepper_cmd_coalesce);
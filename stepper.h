@@ -1,34 +1,114 @@
-//*****************************************************************************
-//
-// stepper.h - Prototypes for the stepper code
-//
-//*****************************************************************************
-
-#ifndef __STEPPER_H__
-#define __STEPPER_H__
-
-typedef enum
-{
-  STEPPER_WAITING = -2,
-  STEPPER_ERROR = -1,
-  STEPPER_OK,
-  STEPPER_STOPPED,
-  STEPPER_MOVING,
-  STEPPER_IDLE
-} stepper_status_t;
-
-//*****************************************************************************
-//
-// Prototypes for the STEPPER
-//
-//*****************************************************************************
-int8_t stepper_init(uint8_t n);
-int8_t stepper_tick(uint8_t index);
-int8_t stepper_go(uint8_t index, float velocity, float acceleration, int32_t steps);
-int8_t stepper_stop(uint8_t index, uint8_t hard_stop);
-int8_t stepper_idle(uint8_t index);
-int8_t stepper_waitfor(uint8_t index);
-int8_t stepper_status(uint8_t index);
-void stepper_scan(uint8_t index, float velocity, float acceleration, int32_t steps);
-
-#endif // __STEPPER_H__
+//*****************************************************************************
+//
+// stepper.h - Prototypes for the stepper code
+//
+//*****************************************************************************
+
+#ifndef __STEPPER_H__
+#define __STEPPER_H__
+
+#define STEPPER_MAX 4
+
+// torque curve points, evenly spaced from standstill to the top speed
+#define STEPPER_CURVE_POINTS 6
+
+// largest step coalescing window, the step jitter it may add
+#define STEPPER_COALESCE_MAX_US 25
+
+// steps planned per axis ahead of the step interrupt (a power of 2), and
+// how far ahead, and how often, the STEPPER task plans them
+#define STEPPER_RING_SIZE 32
+#define STEPPER_PLAN_AHEAD_MS 4
+#define STEPPER_PLAN_PERIOD_MS 1
+
+// positional triggers per axis, and the GPIO ports (A..F) they can drive
+#define STEPPER_TRIGGERS 8
+#define STEPPER_TRIGGER_PORTS 6
+
+typedef enum
+{
+  STEPPER_WAITING = -2,
+  STEPPER_ERROR = -1,
+  STEPPER_OK,
+  STEPPER_STOPPED,
+  STEPPER_MOVING,
+  STEPPER_IDLE
+} stepper_status_t;
+
+typedef struct
+{
+  float    velocity;    // current velocity, STEPS-PER-SECOND
+  float    tvelocity;   // target velocity, STEPS-PER-SECOND
+  uint32_t step_count;  // steps left in the current move
+} stepper_snapshot_t;
+
+//*****************************************************************************
+//
+// Torque/speed curve of an axis: the most acceleration the motor can take,
+// SPS^2, at velocities 0, vmax / 5, ... vmax, interpolated in between. The
+// ramp never exceeds the curve (nor the acceleration a move asks for) and
+// moves are capped at vmax. vmax 0 leaves the axis on constant acceleration
+// with no cap.
+//
+//*****************************************************************************
+typedef struct
+{
+  float vmax;                           // top speed, STEPS-PER-SECOND
+  float inv_step;                       // curve points per SPS
+  float accel[STEPPER_CURVE_POINTS];    // SPS^2
+} stepper_curve_t;
+
+// told of finished sequences, from an interrupt at a kernel-safe priority
+typedef long (*stepper_done_handler_t)(uint8_t mask);
+
+//*****************************************************************************
+//
+// What a positional trigger does when its axis gets there (stepper_trigger())
+//
+//*****************************************************************************
+typedef enum
+{
+  STEPPER_TRIGGER_GPIO,       // arg: port << 8 | pins, toggles the pins; not
+                              // the coils', UART0's or an encoder's
+  STEPPER_TRIGGER_START,      // arg: axis mask, starts their staged moves
+  STEPPER_TRIGGER_VELOCITY,   // velocity: new move velocity of this axis
+  STEPPER_TRIGGER_EVENT,      // arg: posted as the value of EVENT_TRIGGER
+  STEPPER_TRIGGER_MAX
+} stepper_trigger_action_t;
+
+//*****************************************************************************
+//
+// Prototypes for the STEPPER
+//
+//*****************************************************************************
+int8_t stepper_init(uint8_t n);
+int8_t stepper_tick(uint8_t index);
+void stepper_coalesce(uint8_t index);
+int8_t stepper_coalesce_set(uint32_t window_us);
+void StepperDoneIntHandler(void);
+void stepper_plan(void);
+int8_t stepper_go(uint8_t index, float velocity, float acceleration, int32_t steps);
+int8_t stepper_setup(uint8_t index, float velocity, float acceleration, int32_t steps, uint32_t decel_steps, float curve_scale);
+uint8_t stepper_counted(uint8_t mask);
+int8_t stepper_start(uint8_t mask);
+int8_t stepper_stop(uint8_t index, uint8_t hard_stop);
+void stepper_estop(float decel);
+void stepper_reclock(uint32_t old_hz);
+int8_t stepper_idle(uint8_t index);
+int8_t stepper_waitfor(uint8_t index);
+int8_t stepper_status(uint8_t index);
+int8_t stepper_snapshot(uint8_t index, stepper_snapshot_t *snap);
+void stepper_snapshot_all(stepper_snapshot_t *snap);
+void stepper_set_done_handler(stepper_done_handler_t handler);
+uint8_t stepper_busy(void);
+int8_t stepper_curve(uint8_t index, float vmax, const float *accel);
+int8_t stepper_feedback(uint8_t index, float counts_per_step, uint32_t tolerance);
+int8_t stepper_trigger(uint8_t index, int32_t position, uint8_t action, uint16_t arg, float velocity);
+int8_t stepper_trigger_clear(uint8_t index);
+int32_t stepper_position(uint8_t index);
+int8_t stepper_gear(uint8_t slave, uint8_t master, int16_t p, uint16_t q, uint32_t ramp_steps);
+int8_t stepper_gear_release(uint8_t slave, uint32_t ramp_steps);
+float stepper_top_sps(uint8_t index);
+float stepper_brake_steps(uint8_t index, float velocity, float acceleration, float curve_scale);
+
+#endif // __STEPPER_H__
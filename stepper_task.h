@@ -1,17 +1,18 @@
-//*****************************************************************************
-//
-// led_task.h - Prototypes for the STEPPER task.
-//
-//*****************************************************************************
-
-#ifndef __STEPPER_TASK_H__
-#define __STEPPER_TASK_H__
-
-//*****************************************************************************
-//
-// Prototypes for the STEPPER task.
-//
-//*****************************************************************************
-extern unsigned long STEPPERTaskInit(void);
-
-#endif // __STEPPER_TASK_H__
+//*****************************************************************************
+//
+// stepper_task.h - Prototypes for the STEPPER planner task
+//
+//*****************************************************************************
+
+#ifndef __STEPPER_TASK_H__
+#define __STEPPER_TASK_H__
+
+//*****************************************************************************
+//
+// Prototypes for the STEPPER task
+//
+//*****************************************************************************
+unsigned long stepperTaskInit(void);
+void stepper_task_wake(void);
+
+#endif // __STEPPER_TASK_H__
@@ -1,179 +1,281 @@
-//*****************************************************************************
-//
-// switch_task.c - A simple switch task to process the buttons.
-//
-//*****************************************************************************
-
-#include "inc/hw_memmap.h"
-#include "inc/hw_types.h"
-#include "inc/hw_gpio.h"
-#include "driverlib/sysctl.h"
-#include "driverlib/gpio.h"
-#include "driverlib/rom.h"
-#include "drivers/buttons.h"
-#include "utils/uartstdio.h"
-#include "switch_task.h"
-#include "led_task.h"
-#include "priorities.h"
-#include "FreeRTOS.h"
-#include "task.h"
-#include "queue.h"
-#include "semphr.h"
-
-//*****************************************************************************
-//
-// The stack size for the display task.
-//
-//*****************************************************************************
-#define SWITCHTASKSTACKSIZE        128         // Stack size in words
-
-extern xQueueHandle g_pLEDQueue;
-extern xQueueHandle g_pSTEPPERQueue;
-extern xSemaphoreHandle g_pUARTSemaphore;
-
-//*****************************************************************************
-//
-// This task reads the buttons' state and passes this information to LEDTask.
-//
-//*****************************************************************************
-static void
-SwitchTask(void *pvParameters)
-{
-    portTickType ulLastTime;
-    unsigned long ulSwitchDelay = 25;
-    unsigned char ucCurButtonState, ucPrevButtonState;
-    unsigned char ucMessage;
-
-    ucCurButtonState = ucPrevButtonState = 0;
-
-    //
-    // Get the current tick count.
-    //
-    ulLastTime = xTaskGetTickCount();
-
-    //
-    // Loop forever.
-    //
-    while(1)
-    {
-        //
-        // Poll the debounced state of the buttons.
-        //
-        ucCurButtonState = ButtonsPoll(0, 0);
-
-        //
-        // Check if previous debounced state is equal to the current state.
-        //
-        if(ucCurButtonState != ucPrevButtonState)
-        {
-            ucPrevButtonState = ucCurButtonState;
-
-            //
-            // Check to make sure the change in state is due to button press
-            // and not due to button release.
-            //
-            if((ucCurButtonState & ALL_BUTTONS) != 0)
-            {
-                if((ucCurButtonState & ALL_BUTTONS) == LEFT_BUTTON)
-                {
-                    ucMessage = LEFT_BUTTON;
-
-                    //
-                    // Guard UART from concurrent access.
-                    //
-                    xSemaphoreTake(g_pUARTSemaphore, portMAX_DELAY);
-                    UARTprintf("Left Button is pressed.\n");
-                    xSemaphoreGive(g_pUARTSemaphore);
-                }
-                else if((ucCurButtonState & ALL_BUTTONS) == RIGHT_BUTTON)
-                {
-                    ucMessage = RIGHT_BUTTON;
-
-                    //
-                    // Guard UART from concurrent access.
-                    //
-                    xSemaphoreTake(g_pUARTSemaphore, portMAX_DELAY);
-                    UARTprintf("Right Button is pressed.\n");
-                    xSemaphoreGive(g_pUARTSemaphore);
-                }
-
-#if 0
-                //
-                // Pass the value of the button pressed to LEDTask.
-                //
-                if(xQueueSend(g_pLEDQueue, &ucMessage, portMAX_DELAY) !=
-                   pdPASS)
-                {
-                    //
-                    // Error. The queue should never be full. If so print the
-                    // error message on UART and wait for ever.
-                    //
-                    UARTprintf("\nQueue full. This should never happen.\n");
-                    while(1)
-                    {
-                    }
-                }
-#endif
-#if 0
-                //
-                // Pass the value of the button pressed to STEPPERTask.
-                //
-                if(xQueueSend(g_pSTEPPERQueue, &ucMessage, portMAX_DELAY) !=
-                   pdPASS)
-                {
-                    //
-                    // Error. The queue should never be full. If so print the
-                    // error message on UART and wait for ever.
-                    //
-                    UARTprintf("\nQueue full. This should never happen.\n");
-                    while(1)
-                    {
-                    }
-                }
-#endif
-            }
-        }
-
-        //
-        // Wait for the required amount of time to check back.
-        //
-        vTaskDelayUntil(&ulLastTime, ulSwitchDelay / portTICK_RATE_MS);
-    }
-}
-
-//*****************************************************************************
-//
-// Initializes the switch task.
-//
-//*****************************************************************************
-unsigned long
-SwitchTaskInit(void)
-{
-    //
-    // Unlock the GPIO LOCK register for Right button to work.
-    //
-    HWREG(GPIO_PORTF_BASE + GPIO_O_LOCK) = GPIO_LOCK_KEY_DD;
-    HWREG(GPIO_PORTF_BASE + GPIO_O_CR) = 0xFF;
-
-    //
-    // Initialize the buttons
-    //
-    ButtonsInit();
-
-    //
-    // Create the switch task.
-    //
-    if(xTaskCreate(SwitchTask, (signed portCHAR *)"Switch",
-                   SWITCHTASKSTACKSIZE, NULL, tskIDLE_PRIORITY +
-                   PRIORITY_SWITCH_TASK, NULL) != pdTRUE)
-    {
-        return(1);
-    }
-
-    UARTprintf("Switch task initialized\n");
-
-    //
-    // Success.
-    //
-    return(0);
-}
+//*****************************************************************************
+//
+// switch_task.c - Interrupt driven buttons and emergency stop.
+//
+//*****************************************************************************
+
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+#include "inc/hw_gpio.h"
+#include "inc/hw_ints.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/gpio.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/rom.h"
+#include "driverlib/timer.h"
+#include "drivers/buttons.h"
+
+#include <inttypes.h>
+
+#include "console.h"
+#include "switch_task.h"
+#include "stepper.h"
+#include "shell_task.h"
+#include "cpuload.h"
+#include "event.h"
+#include "clock.h"
+
+//*****************************************************************************
+//
+// The first edge of a press is acted on at once, then the pins are masked and
+// a one-shot timer samples the settled state once the contacts stop bouncing.
+// The edge interrupt shares the top priority of the step timers so the
+// emergency stop can't be held off by anything but a step in progress; the
+// debounce timer runs at a kernel-safe priority to post EVENT_BUTTON.
+//
+//*****************************************************************************
+#define SWITCH_DEBOUNCE_MS          20
+#define SWITCH_DEBOUNCE_PRIORITY    (6 << 5)
+
+#ifdef BOARD_QEMU
+// Timer2 steps axis 2 there (timer.c) and emulated buttons do not bounce:
+// the edge interrupt settles a press itself, at a kernel-safe priority
+#define SWITCH_INT_PRIORITY         SWITCH_DEBOUNCE_PRIORITY
+#else
+#define SWITCH_INT_PRIORITY         (0 << 5)
+#endif
+
+#define SWITCH_ESTOP_DECEL          4000.0f     // SPS^2
+
+typedef enum
+{
+  SWITCH_ESTOP_OFF,
+  SWITCH_ESTOP_RAMP,                // ramp down at the e-stop deceleration
+  SWITCH_ESTOP_HARD,                // stop dead
+  SWITCH_ESTOP_MAX
+} switch_estop_t;
+
+typedef struct {
+    volatile uint8_t action;        // switch_estop_t
+    volatile uint8_t buttons;       // buttons that trigger it
+    volatile float   decel;
+    uint8_t          state;         // debounced, 1 = pressed
+    uint8_t          fired;         // e-stop since the last debounce
+    uint32_t         count;
+} switch_t;
+
+static switch_t g_switch = {
+    SWITCH_ESTOP_RAMP, RIGHT_BUTTON, SWITCH_ESTOP_DECEL, 0, 0, 0
+};
+
+static const char * const g_estop_name[SWITCH_ESTOP_MAX] = { "off", "ramp", "hard" };
+
+static unsigned char
+SwitchRead(void)
+{
+    // the buttons pull the pins low
+    return(~ROM_GPIOPinRead(GPIO_PORTF_BASE, ALL_BUTTONS) & ALL_BUTTONS);
+}
+
+//
+// Post the settled presses to the EVENT task and re-arm the edges.
+//
+static void
+SwitchSettle(void)
+{
+    unsigned char ucCurButtonState, ucPressed;
+
+    ucCurButtonState = SwitchRead();
+    ucPressed = ucCurButtonState & ~g_switch.state;
+    g_switch.state = ucCurButtonState;
+
+    if(ucPressed & LEFT_BUTTON)
+    {
+        event_post_from_isr(EVENT_BUTTON, LEFT_BUTTON, g_switch.fired);
+    }
+    if(ucPressed & RIGHT_BUTTON)
+    {
+        event_post_from_isr(EVENT_BUTTON, RIGHT_BUTTON, g_switch.fired);
+    }
+    g_switch.fired = 0;
+
+    //
+    // Drop the edges seen while masked, the state above is what counts.
+    //
+    ROM_GPIOPinIntClear(GPIO_PORTF_BASE, ALL_BUTTONS);
+    ROM_GPIOPinIntEnable(GPIO_PORTF_BASE, ALL_BUTTONS);
+}
+
+//*****************************************************************************
+//
+// Port F edge interrupt. No kernel calls allowed at this priority.
+//
+//*****************************************************************************
+void
+SwitchIntHandler(void)
+{
+    unsigned char ucPressed;
+
+    CPULOAD_ISR_ENTER(CPULOAD_ISR_BUTTONS);
+
+    ROM_GPIOPinIntClear(GPIO_PORTF_BASE, ROM_GPIOPinIntStatus(GPIO_PORTF_BASE, true));
+
+    //
+    // A button that is down now and was up when last settled is a new press,
+    // a release bounce reads the other way round.
+    //
+    ucPressed = SwitchRead() & ~g_switch.state;
+
+    if((ucPressed & g_switch.buttons) && (g_switch.action != SWITCH_ESTOP_OFF))
+    {
+        stepper_estop((g_switch.action == SWITCH_ESTOP_HARD) ? 0 : g_switch.decel);
+        g_switch.fired = 1;
+        g_switch.count++;
+    }
+
+#ifdef BOARD_QEMU
+    SwitchSettle();
+#else
+    //
+    // Ignore the bounces until the debounce timer fires.
+    //
+    ROM_GPIOPinIntDisable(GPIO_PORTF_BASE, ALL_BUTTONS);
+    ROM_TimerLoadSet(TIMER2_BASE, TIMER_A,
+                     g_clock.per_ms * SWITCH_DEBOUNCE_MS);
+    ROM_TimerEnable(TIMER2_BASE, TIMER_A);
+#endif
+
+    CPULOAD_ISR_EXIT(CPULOAD_ISR_BUTTONS);
+}
+
+#ifndef BOARD_QEMU
+//*****************************************************************************
+//
+// Debounce timeout, posts the settled presses to the EVENT task.
+//
+//*****************************************************************************
+void
+SwitchDebounceIntHandler(void)
+{
+    CPULOAD_ISR_ENTER(CPULOAD_ISR_DEBOUNCE);
+
+    ROM_TimerIntClear(TIMER2_BASE, TIMER_TIMA_TIMEOUT);
+
+    SwitchSettle();
+
+    CPULOAD_ISR_EXIT(CPULOAD_ISR_DEBOUNCE);
+}
+#endif
+
+static void
+SwitchButton(const event_t *event)
+{
+    if(event->arg == LEFT_BUTTON)
+    {
+        console_printf("Left Button is pressed.\n");
+    }
+    else if(event->arg == RIGHT_BUTTON)
+    {
+        console_printf("Right Button is pressed.\n");
+    }
+
+    if(event->value)
+    {
+        console_printf("Emergency stop (%s).\n", g_estop_name[g_switch.action]);
+    }
+}
+
+//*****************************************************************************
+//
+// Initializes the switches.
+//
+//*****************************************************************************
+unsigned long
+SwitchInit(void)
+{
+    //
+    // Unlock the GPIO LOCK register for Right button to work.
+    //
+    HWREG(GPIO_PORTF_BASE + GPIO_O_LOCK) = GPIO_LOCK_KEY_DD;
+    HWREG(GPIO_PORTF_BASE + GPIO_O_CR) = 0xFF;
+
+    //
+    // Initialize the buttons
+    //
+    ButtonsInit();
+
+    if(event_register(EVENT_BUTTON, SwitchButton) != 0)
+    {
+        return(1);
+    }
+
+#ifndef BOARD_QEMU
+    //
+    // One-shot debounce timer.
+    //
+    ROM_SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER2);
+    ROM_TimerConfigure(TIMER2_BASE, TIMER_CFG_ONE_SHOT);
+    ROM_TimerIntEnable(TIMER2_BASE, TIMER_TIMA_TIMEOUT);
+    ROM_IntPrioritySet(INT_TIMER2A, SWITCH_DEBOUNCE_PRIORITY);
+    ROM_IntEnable(INT_TIMER2A);
+#endif
+
+    //
+    // Both edges, a release re-arms the press detection.
+    //
+    g_switch.state = SwitchRead();
+    ROM_GPIOIntTypeSet(GPIO_PORTF_BASE, ALL_BUTTONS, GPIO_BOTH_EDGES);
+    ROM_GPIOPinIntClear(GPIO_PORTF_BASE, ALL_BUTTONS);
+    ROM_GPIOPinIntEnable(GPIO_PORTF_BASE, ALL_BUTTONS);
+    ROM_IntPrioritySet(INT_GPIOF, SWITCH_INT_PRIORITY);
+    ROM_IntEnable(INT_GPIOF);
+
+    console_printf("Switch initialized\n");
+
+    //
+    // Success.
+    //
+    return(0);
+}
+
+//*****************************************************************************
+//
+// Shell commands.
+//
+//*****************************************************************************
+static void
+SwitchCmdEstop(const shell_arg_t *arg)
+{
+    tBoolean masked;
+
+    if((arg[0].i < 0) || (arg[0].i >= SWITCH_ESTOP_MAX) ||
+       (arg[1].i & ~3) || (arg[2].f < 0))
+    {
+        console_printf("estop: bad argument\n");
+        return;
+    }
+
+    masked = ROM_IntMasterDisable();
+    g_switch.action = arg[0].i;
+    if(arg[1].i)
+    {
+        g_switch.buttons = ((arg[1].i & 1) ? LEFT_BUTTON : 0) |
+                           ((arg[1].i & 2) ? RIGHT_BUTTON : 0);
+    }
+    if(arg[2].f > 0)
+    {
+        g_switch.decel = arg[2].f;
+    }
+    if(!masked)
+    {
+        ROM_IntMasterEnable();
+    }
+
+    console_printf("estop: %s on %s%s, decel %.0f sps^2, fired %u times\n",
+                   g_estop_name[g_switch.action],
+                   (g_switch.buttons & LEFT_BUTTON) ? "left " : "",
+                   (g_switch.buttons & RIGHT_BUTTON) ? "right" : "",
+                   g_switch.decel, g_switch.count);
+}
+
+SHELL_COMMAND(estop, "estop", "i|if", "<0 off|1 ramp|2 hard> [buttons 1 left|2 right|3 both] [decel sps^2]", SwitchCmdEstop);
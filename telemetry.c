@@ -0,0 +1,203 @@
+//*****************************************************************************
+//
+// telemetry.c - Periodic binary motion telemetry
+//
+//*****************************************************************************
+
+#include <string.h>
+
+#include <inttypes.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "inc/hw_nvic.h"
+#include "inc/hw_types.h"
+#include "console.h"
+#include "shell_task.h"
+#include "priorities.h"
+#include "membudget.h"
+#include "stepper.h"
+#include "platform.h"
+#include "proto.h"
+#include "telemetry.h"
+
+//*****************************************************************************
+//
+// The stack size for the TELEMETRY task.
+//
+//*****************************************************************************
+#define TELEMETRYTASKSTACKSIZE  160         // Stack size in words
+
+MEMBUDGET_STACK(g_telemetry_stack, TELEMETRYTASKSTACKSIZE);
+
+#define TELEMETRY_PAYLOAD       (8 + (STEPPER_MAX * 12) + 8)
+
+// COBS adds one byte per 254, plus type, seq, crc and both delimiters
+#define TELEMETRY_FRAME         (TELEMETRY_PAYLOAD + 8)
+
+typedef struct {
+    volatile uint16_t rate;             // Hz, 0 when stopped
+    xSemaphoreHandle  wake;             // given when the rate changes
+    uint32_t          seq;
+    uint32_t          frames;
+    uint32_t          skipped;          // no room in the TX ring
+} telemetry_t;
+
+static telemetry_t g_telemetry;
+
+// microseconds, from the tick count and the SysTick down counter
+static uint32_t telemetry_timestamp(void)
+{
+    unsigned long period = HWREG(NVIC_ST_RELOAD) + 1;
+    unsigned long current;
+    portTickType tick;
+
+    do
+    {
+        tick = xTaskGetTickCount();
+        current = HWREG(NVIC_ST_CURRENT);
+    } while (tick != xTaskGetTickCount());
+
+    return((tick * (1000000 / configTICK_RATE_HZ)) +
+           (((period - current) * (1000000 / configTICK_RATE_HZ)) / period));
+}
+
+static void telemetry_put(uint8_t **p, const void *value)
+{
+    memcpy(*p, value, 4);
+    *p += 4;
+}
+
+static void telemetry_sample(void)
+{
+    stepper_snapshot_t axes[STEPPER_MAX];
+    platform_snapshot_t platform;
+    uint8_t payload[TELEMETRY_PAYLOAD];
+    uint8_t *p = payload;
+    uint32_t timestamp;
+    uint8_t i;
+
+    timestamp = telemetry_timestamp();
+    stepper_snapshot_all(axes);
+    platform_snapshot(axes, &platform);
+
+    telemetry_put(&p, &g_telemetry.seq);
+    telemetry_put(&p, &timestamp);
+
+    for (i=0; i<STEPPER_MAX; i++)
+    {
+        telemetry_put(&p, &axes[i].velocity);
+        telemetry_put(&p, &axes[i].tvelocity);
+        telemetry_put(&p, &axes[i].step_count);
+    }
+
+    telemetry_put(&p, &platform.velocity);
+    telemetry_put(&p, &platform.angular_velocity);
+
+    if (console_tx_free() >= TELEMETRY_FRAME)
+    {
+        proto_send(PROTO_MSG_TELEMETRY, (uint8_t)g_telemetry.seq, payload, sizeof(payload));
+        g_telemetry.frames++;
+    }
+    else
+    {
+        g_telemetry.skipped++;
+    }
+
+    g_telemetry.seq++;
+}
+
+static void
+telemetryTask(void *pvParameters)
+{
+    portTickType ulWakeTime;
+    uint16_t rate;
+
+    while(1)
+    {
+        rate = g_telemetry.rate;
+
+        if (rate == 0)
+        {
+            xSemaphoreTake(g_telemetry.wake, portMAX_DELAY);
+            ulWakeTime = xTaskGetTickCount();
+            continue;
+        }
+
+        telemetry_sample();
+
+        //
+        // Fixed rate, the period is rounded to whole ticks.
+        //
+        vTaskDelayUntil(&ulWakeTime, (configTICK_RATE_HZ + (rate / 2)) / rate);
+
+        xSemaphoreTake(g_telemetry.wake, 0);
+    }
+}
+
+// 0 stops, otherwise clamped to TELEMETRY_MIN_RATE..TELEMETRY_MAX_RATE
+int8_t telemetry_rate(uint16_t rate)
+{
+    if ((rate != 0) && (rate < TELEMETRY_MIN_RATE))
+    {
+        rate = TELEMETRY_MIN_RATE;
+    }
+
+    if (rate > TELEMETRY_MAX_RATE)
+    {
+        rate = TELEMETRY_MAX_RATE;
+    }
+
+    g_telemetry.rate = rate;
+    xSemaphoreGive(g_telemetry.wake);
+
+    return(0);
+}
+
+//*****************************************************************************
+//
+// Initializes the TELEMETRY task, the stream starts stopped.
+//
+//*****************************************************************************
+unsigned long
+telemetryTaskInit(void)
+{
+    vSemaphoreCreateBinary(g_telemetry.wake);
+    xSemaphoreTake(g_telemetry.wake, 0);
+
+    //
+    // Create the TELEMETRY task.
+    //
+    if(MEMBUDGET_TASK_CREATE(telemetryTask, "TLM", g_telemetry_stack, PRIORITY_TELEMETRY_TASK) != pdTRUE)
+    {
+        return(1);
+    }
+
+    console_printf("Telemetry task init.\n");
+
+    //
+    // Success.
+    //
+    return(0);
+}
+
+//*****************************************************************************
+//
+// Shell commands.
+//
+//*****************************************************************************
+static void telemetry_cmd_rate(const shell_arg_t *arg)
+{
+    telemetry_rate(arg[0].i);
+}
+
+static void telemetry_cmd_status(const shell_arg_t *arg)
+{
+    console_printf("telemetry_status: rate %u Hz, seq %u, frames %u, skipped %u\n",
+                   g_telemetry.rate, g_telemetry.seq, g_telemetry.frames, g_telemetry.skipped);
+}
+
+SHELL_COMMAND(tm, "tm", "i", "(telemetry) rate_hz, 0 stops", telemetry_cmd_rate);
+SHELL_COMMAND(tst, "tst", "", "(telemetry status)", telemetry_cmd_status);
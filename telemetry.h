@@ -0,0 +1,30 @@
+//*****************************************************************************
+//
+// telemetry.h - Periodic binary motion telemetry
+//
+// Sent as PROTO_MSG_TELEMETRY frames (see proto.h), payload little endian:
+//
+//   u32 seq, u32 timestamp_us,
+//   STEPPER_MAX x { f32 velocity, f32 tvelocity, u32 step_count },
+//   f32 platform velocity (m/s), f32 platform angular velocity (rot/s)
+//
+// A frame that does not fit in the console TX ring is skipped, not waited
+// for; the host sees the gap in seq.
+//
+//*****************************************************************************
+
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#define TELEMETRY_MIN_RATE      10          // Hz
+#define TELEMETRY_MAX_RATE      500         // Hz
+
+//*****************************************************************************
+//
+// Prototypes for the TELEMETRY
+//
+//*****************************************************************************
+unsigned long telemetryTaskInit(void);
+int8_t telemetry_rate(uint16_t rate);
+
+#endif // __TELEMETRY_H__
@@ -0,0 +1,245 @@
+//*****************************************************************************
+//
+// mathk_test.c - Host property tests and micro-benchmark of mathk.c
+//
+// Usage: mathk_test [-x]
+//
+// Checks mathk_isqrt() for floor(sqrt(x)), mathk_recip_div() for n / d over
+// every divisor class and the Q16.16 and saturating helpers against 64-bit
+// reference arithmetic. -x runs mathk_isqrt() over all 2^32 inputs instead
+// of every 97th. Ends with a table of ns per call next to the plain C
+// operations they replace; "mbench" measures cycles on the target.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "mathk.h"
+
+#define TEST_RANDOM             20000000
+#define TEST_REPORT             5
+
+static uint32_t g_seed = 12345;
+static unsigned long g_failed;
+
+// mathk.c's "mbench" shell command links against these
+void console_printf(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+uint32_t cpuload_cycles(void)
+{
+    return(0);
+}
+
+static uint32_t test_rand(void)
+{
+    g_seed ^= g_seed << 13;
+    g_seed ^= g_seed >> 17;
+    g_seed ^= g_seed << 5;
+
+    return(g_seed);
+}
+
+static void test_fail(const char *what, uint32_t a, uint32_t b, uint32_t got)
+{
+    if (g_failed++ < TEST_REPORT)
+    {
+        printf("FAIL %s 0x%08" PRIx32 " 0x%08" PRIx32 ": 0x%08" PRIx32 "\n", what, a, b, got);
+    }
+}
+
+static void test_isqrt(uint32_t stride)
+{
+    uint64_t x;
+    uint32_t r;
+
+    for (x = 0; x <= UINT32_MAX; x += stride)
+    {
+        r = mathk_isqrt((uint32_t)x);
+
+        if (((uint64_t)r * r > x) || ((uint64_t)(r + 1) * (r + 1) <= x))
+        {
+            test_fail("isqrt", (uint32_t)x, 0, r);
+        }
+    }
+
+    // both ends of every root bit
+    for (r = 1; r < 65536; r <<= 1)
+    {
+        if ((mathk_isqrt(r * r) != r) || (mathk_isqrt(r * r - 1) != r - 1))
+        {
+            test_fail("isqrt", r * r, 0, mathk_isqrt(r * r));
+        }
+    }
+
+    if (mathk_isqrt(UINT32_MAX) != 65535)
+    {
+        test_fail("isqrt", UINT32_MAX, 0, mathk_isqrt(UINT32_MAX));
+    }
+}
+
+static void test_recip_check(uint32_t n, uint32_t d)
+{
+    mathk_recip_t recip;
+    uint32_t q;
+
+    mathk_recip_init(&recip, d);
+    q = mathk_recip_div(&recip, n);
+
+    if (q != n / d)
+    {
+        test_fail("recip_div", n, d, q);
+    }
+}
+
+static void test_recip(void)
+{
+    static const uint32_t n_edges[] = { 0, 1, 2, 0x7fffffff, 0x80000000, 0xfffffffe, 0xffffffff };
+    uint32_t d, i;
+    long n;
+
+    // divisors of every size, numerators of every size
+    for (n = 0; n < TEST_RANDOM; n++)
+    {
+        d = test_rand() >> (test_rand() % 32);
+        test_recip_check(test_rand() >> (test_rand() % 32), d ? d : 1);
+    }
+
+    // powers of two and their neighbours, against the numerator edges
+    for (i = 0; i < 32; i++)
+    {
+        for (n = 0; n < (long)(sizeof(n_edges) / sizeof(n_edges[0])); n++)
+        {
+            test_recip_check(n_edges[n], 1UL << i);
+            test_recip_check(n_edges[n], (1UL << i) + 1);
+            if (i > 1)
+            {
+                test_recip_check(n_edges[n], (1UL << i) - 1);
+            }
+        }
+    }
+
+    // every 16-bit divisor, a timer period
+    for (d = 1; d < 65536; d++)
+    {
+        test_recip_check(UINT32_MAX, d);
+        test_recip_check(test_rand(), d);
+    }
+}
+
+static int32_t test_sat32(int64_t a)
+{
+    return((a > INT32_MAX) ? INT32_MAX : (a < INT32_MIN) ? INT32_MIN : (int32_t)a);
+}
+
+static void test_fixed(void)
+{
+    int32_t a, b, want;
+    long n;
+
+    for (n = 0; n < TEST_RANDOM; n++)
+    {
+        a = (int32_t)test_rand() >> (test_rand() % 32);
+        b = (int32_t)test_rand() >> (test_rand() % 32);
+
+        // arithmetic shift of the 64-bit product floors, as documented
+        want = test_sat32(((int64_t)a * b) >> 16);
+        if (mathk_q16_mul(a, b) != want)
+        {
+            test_fail("q16_mul", a, b, mathk_q16_mul(a, b));
+        }
+
+        want = (b == 0) ? ((a < 0) ? INT32_MIN : INT32_MAX) : test_sat32(((int64_t)a * 65536) / b);
+        if (mathk_q16_div(a, b) != want)
+        {
+            test_fail("q16_div", a, b, mathk_q16_div(a, b));
+        }
+
+        if (mathk_qadd(a, b) != test_sat32((int64_t)a + b))
+        {
+            test_fail("qadd", a, b, mathk_qadd(a, b));
+        }
+
+        if (mathk_usat16(a) != (uint32_t)((a < 0) ? 0 : (a > 65535) ? 65535 : a))
+        {
+            test_fail("usat16", a, 0, mathk_usat16(a));
+        }
+
+        if (mathk_ssat16(a) != ((a < -32768) ? -32768 : (a > 32767) ? 32767 : a))
+        {
+            test_fail("ssat16", a, 0, mathk_ssat16(a));
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Benchmark.
+//
+//*****************************************************************************
+#define BENCH_CALLS             10000000
+
+static double bench_ns(struct timespec *t0)
+{
+    struct timespec t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    return(((t1.tv_sec - t0->tv_sec) * 1e9 + (t1.tv_nsec - t0->tv_nsec)) / BENCH_CALLS);
+}
+
+#define BENCH(name, expr)                                                   \
+    do {                                                                    \
+        seed = 1;                                                           \
+        clock_gettime(CLOCK_MONOTONIC, &t0);                                \
+        for (n = 0; n < BENCH_CALLS; n++)                                   \
+        {                                                                   \
+            seed = (seed * 1664525) + 1013904223;                           \
+            sink += (expr);                                                 \
+        }                                                                   \
+        printf("%-24s %8.2f\n", name, bench_ns(&t0));                       \
+    } while (0)
+
+static void bench(void)
+{
+    volatile uint32_t sink = 0;
+    volatile uint32_t divisor = 66666;
+    mathk_recip_t recip;
+    struct timespec t0;
+    uint32_t seed;
+    long n;
+
+    mathk_recip_init(&recip, divisor);
+
+    printf("%-24s %8s\n", "ns per call", "");
+    BENCH("mathk_isqrt", mathk_isqrt(seed));
+    BENCH("(uint32_t)sqrt", (uint32_t)sqrt((double)seed));
+    BENCH("mathk_recip_div", mathk_recip_div(&recip, seed));
+    BENCH("x / d", seed / divisor);
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t exhaustive = (argc > 1) && (strcmp(argv[1], "-x") == 0);
+
+    test_isqrt(exhaustive ? 1 : 97);
+    test_recip();
+    test_fixed();
+
+    printf("mathk_test: %lu failures\n", g_failed);
+
+    bench();
+
+    return(g_failed ? 1 : 0);
+}
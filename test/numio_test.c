@@ -0,0 +1,285 @@
+//*****************************************************************************
+//
+// numio_test.c - Host round-trip tests and micro-benchmark of numio.c
+//
+// Usage: numio_test [-x]
+//
+// Checks numio_strtof() against the C library's correctly rounded strtof()
+// on random decimal strings, that every float tried survives a "%.9g" round
+// trip through it, numio_ftoa() against printf("%.*f") (exact, round half
+// even) and numio_qtoa()/numio_strtoq() round trips. -x runs the float
+// round trip over every normal float instead of a sample. Ends with a table
+// of ns per call next to the C library.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <float.h>
+#include <math.h>
+#include <time.h>
+
+#include "numio.h"
+
+#define TEST_RANDOM             3000000
+#define TEST_REPORT             5
+
+static uint32_t g_seed = 12345;
+static unsigned long g_failed;
+
+static uint32_t test_rand(void)
+{
+    g_seed ^= g_seed << 13;
+    g_seed ^= g_seed >> 17;
+    g_seed ^= g_seed << 5;
+
+    return(g_seed);
+}
+
+static void test_fail(const char *what, const char *input, float got, float want)
+{
+    if (g_failed++ < TEST_REPORT)
+    {
+        printf("FAIL %s \"%s\": %.9g, want %.9g\n", what, input, got, want);
+    }
+}
+
+static uint8_t test_same(float a, float b)
+{
+    return(memcmp(&a, &b, sizeof(a)) == 0);
+}
+
+// libc strtof() with subnormals flushed, as numio_strtof() does
+static float test_strtof_ref(const char *str)
+{
+    float value = strtof(str, NULL);
+
+    return((fabsf(value) < FLT_MIN) ? copysignf(0.0f, value) : value);
+}
+
+//*****************************************************************************
+//
+// Parsing.
+//
+//*****************************************************************************
+static void test_strtof_random(void)
+{
+    char buf[64];
+    float got, want;
+    uint8_t digits, i;
+    long n;
+    int p;
+
+    for (n = 0; n < TEST_RANDOM; n++)
+    {
+        p = 0;
+        digits = 1 + (test_rand() % 19);
+
+        if (test_rand() & 1)
+        {
+            buf[p++] = '-';
+        }
+
+        for (i = 0; i < digits; i++)
+        {
+            buf[p++] = '0' + (test_rand() % 10);
+            if ((i == digits / 2) && (test_rand() & 1))
+            {
+                buf[p++] = '.';
+            }
+        }
+
+        // the whole float range, and past both ends of it
+        p += sprintf(buf + p, "e%d", (int)(test_rand() % 100) - 60);
+
+        got = numio_strtof(buf, NULL);
+        want = test_strtof_ref(buf);
+
+        if (!test_same(got, want))
+        {
+            test_fail("strtof", buf, got, want);
+        }
+    }
+}
+
+static void test_strtof_edges(void)
+{
+    static const char *edges[] = {
+        "3.4028235e38", "3.40282347e38", "3.40282357e38", "3.4028236e38",
+        "1.17549435e-38", "1.1754942e-38", "1.17549421e-38", "0.1", "1e10",
+        "16777217", "16777219", "9007199254740993", "1e39", "1e-39",
+        "0.000000000000000000000000000000000000011754943508222875",
+        "123456789012345678901234567890"
+    };
+    float got, want;
+    uint8_t i;
+
+    for (i = 0; i < sizeof(edges) / sizeof(edges[0]); i++)
+    {
+        got = numio_strtof(edges[i], NULL);
+        want = test_strtof_ref(edges[i]);
+
+        if (!test_same(got, want))
+        {
+            test_fail("strtof", edges[i], got, want);
+        }
+    }
+}
+
+// every stride-th positive normal float prints and parses back to itself
+static void test_strtof_roundtrip(uint32_t stride)
+{
+    char buf[32];
+    uint32_t bits;
+    float value;
+
+    for (bits = 0x00800000; bits < 0x7f800000; bits += stride)
+    {
+        memcpy(&value, &bits, sizeof(value));
+        snprintf(buf, sizeof(buf), "%.9g", value);
+
+        if (!test_same(numio_strtof(buf, NULL), value))
+        {
+            test_fail("round trip", buf, numio_strtof(buf, NULL), value);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Formatting.
+//
+//*****************************************************************************
+static void test_ftoa(void)
+{
+    char got[NUMIO_BUFSIZE], want[64];
+    uint32_t bits;
+    uint8_t decimals;
+    float value;
+    long n;
+
+    for (n = 0; n < TEST_RANDOM; n++)
+    {
+        bits = test_rand();
+        memcpy(&value, &bits, sizeof(value));
+
+        if (isnan(value) || isinf(value))
+        {
+            continue;
+        }
+
+        decimals = test_rand() % (NUMIO_MAX_DECIMALS + 1);
+        numio_ftoa(got, value, decimals, 0);
+        snprintf(want, sizeof(want), "%.*f", decimals, (double)value);
+
+        if (strcmp(got, want) != 0)
+        {
+            if (g_failed++ < TEST_REPORT)
+            {
+                printf("FAIL ftoa %08" PRIx32 " %u: %s, want %s\n", bits, decimals, got, want);
+            }
+        }
+    }
+}
+
+// with at most 29 fraction bits nine decimals tell every value apart
+static void test_qtoa_roundtrip(void)
+{
+    char buf[NUMIO_BUFSIZE];
+    uint8_t frac_bits;
+    int32_t value, back;
+    long n;
+
+    for (n = 0; n < TEST_RANDOM; n++)
+    {
+        value = (int32_t)test_rand();
+        frac_bits = test_rand() % 30;
+
+        numio_qtoa(buf, value, frac_bits, NUMIO_MAX_DECIMALS, 0);
+        back = numio_strtoq(buf, NULL, frac_bits);
+
+        if (back != value)
+        {
+            if (g_failed++ < TEST_REPORT)
+            {
+                printf("FAIL qtoa/strtoq %" PRId32 " q%u \"%s\": %" PRId32 "\n", value, frac_bits, buf, back);
+            }
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Benchmark.
+//
+//*****************************************************************************
+#define BENCH_CALLS             1000000
+
+static double bench_ns(struct timespec *t0)
+{
+    struct timespec t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    return(((t1.tv_sec - t0->tv_sec) * 1e9 + (t1.tv_nsec - t0->tv_nsec)) / BENCH_CALLS);
+}
+
+static void bench(void)
+{
+    static const char *inputs[] = { "1500", "-0.25", "3.14159265", "4000.5", "1e-3", "123456.789" };
+    volatile float sink = 0;
+    struct timespec t0;
+    char buf[64];
+    long n;
+
+    printf("%-24s %8s\n", "ns per call", "");
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (n = 0; n < BENCH_CALLS; n++)
+    {
+        sink += numio_strtof(inputs[n % 6], NULL);
+    }
+    printf("%-24s %8.1f\n", "numio_strtof", bench_ns(&t0));
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (n = 0; n < BENCH_CALLS; n++)
+    {
+        sink += strtof(inputs[n % 6], NULL);
+    }
+    printf("%-24s %8.1f\n", "strtof", bench_ns(&t0));
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (n = 0; n < BENCH_CALLS; n++)
+    {
+        numio_ftoa(buf, (float)n * 0.37f, 2, 0);
+    }
+    printf("%-24s %8.1f\n", "numio_ftoa %.2f", bench_ns(&t0));
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (n = 0; n < BENCH_CALLS; n++)
+    {
+        snprintf(buf, sizeof(buf), "%.2f", (double)((float)n * 0.37f));
+    }
+    printf("%-24s %8.1f\n", "snprintf %.2f", bench_ns(&t0));
+
+    (void)sink;
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t exhaustive = (argc > 1) && (strcmp(argv[1], "-x") == 0);
+
+    test_strtof_edges();
+    test_strtof_random();
+    test_strtof_roundtrip(exhaustive ? 1 : 251);
+    test_ftoa();
+    test_qtoa_roundtrip();
+
+    printf("numio_test: %lu failures\n", g_failed);
+
+    bench();
+
+    return(g_failed ? 1 : 0);
+}
@@ -1,17 +1,17 @@
-//*****************************************************************************
-//
-// timers.h - Prototypes for the timer code
-//
-//*****************************************************************************
-
-#ifndef __TIMER_H__
-#define __TIMER_H__
-
-//*****************************************************************************
-//
-// Prototypes for the TIMER code.
-//
-//*****************************************************************************
-uint8_t timer_init(void);
-
-#endif // __TIMER_H__
+//*****************************************************************************
+//
+// timers.h - Prototypes for the timer code
+//
+//*****************************************************************************
+
+#ifndef __TIMER_H__
+#define __TIMER_H__
+
+//*****************************************************************************
+//
+// Prototypes for the TIMER code.
+//
+//*****************************************************************************
+uint8_t timer_init(void);
+
+#endif // __TIMER_H__
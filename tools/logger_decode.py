@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+#
+# logger_decode.py - Decode binary log frames from a LOGGER_BINARY build.
+#
+# Usage: logger_decode.py [capture-file]   (reads stdin when omitted)
+#
+# Frame layout (see logger.c): 0xa5, id, nargs, seq[4], args[4 * nargs],
+# xor of everything after the sync byte. Bytes outside frames (shell
+# output) are passed through unchanged.
+#
+
+import os
+import re
+import struct
+import sys
+
+SYNC = 0xa5
+MAX_ARGS = 6
+FMT_FILE = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'logger_fmt.h')
+
+
+def load_formats(path):
+    text = open(path).read()
+    return [bytes(m.group(1), 'ascii').decode('unicode_escape')
+            for m in re.finditer(r'^LOGGER_FMT\(\s*\w+\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)', text, re.M)]
+
+
+def render(fmt, args):
+    it = iter(args)
+
+    def conv(m):
+        width, spec = m.group(1), m.group(2)
+        if spec == '%':
+            return '%'
+        try:
+            word = next(it)
+        except StopIteration:
+            return '?'
+        if spec == 'f':
+            return '%+.4f' % struct.unpack('<f', struct.pack('<I', word))[0]
+        if spec in 'di':
+            word = struct.unpack('<i', struct.pack('<I', word))[0]
+        if spec == 'c':
+            return chr(word & 0xff)
+        if spec == 's':
+            return '<str@0x%08x>' % word
+        return ('%' + width + spec) % word
+
+    return re.sub(r'%([0-9]*)([cdiuxXsf%])', conv, fmt)
+
+
+def decode(data, formats, out):
+    i = 0
+    last_seq = None
+    while i < len(data):
+        if data[i] != SYNC or i + 8 > len(data):
+            out.write(chr(data[i]))
+            i += 1
+            continue
+        ident, nargs = data[i + 1], data[i + 2]
+        end = i + 7 + 4 * nargs
+        if ident >= len(formats) or nargs > MAX_ARGS or end >= len(data):
+            out.write(chr(data[i]))
+            i += 1
+            continue
+        chk = 0
+        for b in data[i + 1:end]:
+            chk ^= b
+        if chk != data[end]:
+            out.write(chr(data[i]))
+            i += 1
+            continue
+        seq = struct.unpack_from('<I', data, i + 3)[0]
+        args = struct.unpack_from('<%dI' % nargs, data, i + 7)
+        if last_seq is not None and seq != last_seq + 1:
+            out.write('[logger: %d messages lost]\n' % (seq - last_seq - 1))
+        last_seq = seq
+        out.write(render(formats[ident], args))
+        i = end + 1
+
+
+def main():
+    formats = load_formats(FMT_FILE)
+    src = open(sys.argv[1], 'rb') if len(sys.argv) > 1 else sys.stdin.buffer
+    decode(src.read(), formats, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()
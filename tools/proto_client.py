@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+#
+# proto_client.py - Host side of the binary framed protocol (see proto.h).
+#
+# Usage: proto_client.py <serial-device> [rate-hz] [count]
+#
+# Switches the shell into binary mode with "bin", then streams STATUS
+# requests at the given rate and reports round trip time and lost replies.
+# Needs pyserial.
+#
+
+import struct
+import sys
+import time
+
+MSG_PING, MSG_STEPPER_GO, MSG_PLATFORM_GO, MSG_STOP, MSG_STATUS, MSG_EXIT, MSG_TELEMETRY_RATE = range(1, 8)
+MSG_ACK, MSG_NAK, MSG_STATUS_REPLY, MSG_TELEMETRY = 0x80, 0x81, 0x82, 0x83
+
+
+def crc16(data):
+    crc = 0xffff
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xffff
+    return crc
+
+
+def cobs_encode(data):
+    out = bytearray([0])
+    code_idx, code = 0, 1
+    for b in data:
+        if b == 0:
+            out[code_idx] = code
+            code_idx = len(out)
+            out.append(0)
+            code = 1
+        else:
+            out.append(b)
+            code += 1
+    out[code_idx] = code
+    return bytes(out)
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        i += 1
+        if code == 0 or i + code - 1 > len(data):
+            return None
+        out += data[i:i + code - 1]
+        i += code - 1
+        if code < 0xff and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class Proto:
+    def __init__(self, port):
+        self.port = port
+        self.seq = 0
+        self.buf = bytearray()
+
+    def send(self, msg, payload=b''):
+        self.seq = (self.seq + 1) & 0xff
+        raw = bytes([msg, self.seq]) + payload
+        raw += struct.pack('<H', crc16(raw))
+        self.port.write(b'\0' + cobs_encode(raw) + b'\0')
+        return self.seq
+
+    def recv(self, timeout=0.1):
+        end = time.monotonic() + timeout
+        while time.monotonic() < end:
+            while b'\0' in self.buf:
+                frame, _, self.buf = self.buf.partition(b'\0')
+                raw = cobs_decode(bytes(frame)) if frame else None
+                if raw and len(raw) >= 4 and crc16(raw[:-2]) == struct.unpack('<H', raw[-2:])[0]:
+                    return raw[0], raw[1], raw[2:-2]
+            self.buf += self.port.read(self.port.in_waiting or 1)
+        return None
+
+    def stepper_go(self, index, sps, accel, steps):
+        return self.send(MSG_STEPPER_GO, struct.pack('<Bffi', index, sps, accel, steps))
+
+    def platform_go(self, v, a, w, d):
+        return self.send(MSG_PLATFORM_GO, struct.pack('<ffff', v, a, w, d))
+
+    def stop(self, mask, hard=0):
+        return self.send(MSG_STOP, struct.pack('<BB', mask, hard))
+
+    def status(self, index):
+        return self.send(MSG_STATUS, struct.pack('<B', index))
+
+    def telemetry_rate(self, rate):
+        return self.send(MSG_TELEMETRY_RATE, struct.pack('<H', rate))
+
+
+def main():
+    dev = sys.argv[1]
+    rate = float(sys.argv[2]) if len(sys.argv) > 2 else 100.0
+    count = int(sys.argv[3]) if len(sys.argv) > 3 else 1000
+
+    import serial
+
+    port = serial.Serial(dev, 115200, timeout=0)
+    port.write(b'bin\r')
+    time.sleep(0.1)
+    port.reset_input_buffer()
+
+    p = Proto(port)
+    lost, rtt = 0, []
+    for n in range(count):
+        t0 = time.monotonic()
+        seq = p.status(n & 3)
+        reply = p.recv()
+        if reply is None or reply[1] != seq:
+            lost += 1
+        else:
+            rtt.append(time.monotonic() - t0)
+            if reply[0] == MSG_STATUS_REPLY:
+                idx, vel, tvel, count_ = struct.unpack('<BffI', reply[2])
+        time.sleep(max(0.0, 1.0 / rate - (time.monotonic() - t0)))
+
+    p.send(MSG_EXIT)
+    if rtt:
+        rtt.sort()
+        print('replies %d lost %d rtt min %.2fms median %.2fms max %.2fms' %
+              (len(rtt), lost, rtt[0] * 1e3, rtt[len(rtt) // 2] * 1e3, rtt[-1] * 1e3))
+    else:
+        print('no replies, lost %d' % lost)
+
+
+if __name__ == '__main__':
+    main()
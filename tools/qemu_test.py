@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+#
+# qemu_test.py - Scripted scenarios against the firmware running under QEMU.
+#
+# Usage: qemu_test.py [--qemu "qemu-system-arm -M lm3s6965evb ..."] gcc/out.axf
+#
+# Boots a BOARD=qemu image (see qemu/rom_shim.h) with the UART on stdio and
+# the pl061_update trace event logged, so every write of a GPIO data register
+# is visible. Each scenario sends shell lines and waits for regular
+# expressions on the UART; the motion scenario then counts the phase changes
+# of every 4-bit coil group in the trace and checks them against the steps
+# commanded. The axes step from one 32-bit timer each there, Timer0-3, as
+# QEMU's GPTM does not run the 16-bit pairs. Needs QEMU 6.1 or later built
+# with the log trace backend.
+#
+
+import argparse
+import os
+import re
+import shlex
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+PROMPT = r'shell# '
+PHASES = (1, 3, 2, 6, 4, 12, 8, 9)     # g_phase_bits
+TRACE = re.compile(r'pl061_update\s+(\S+)\s+GPIODIR\s+0x([0-9a-f]+)\s+GPIODATA\s+0x([0-9a-f]+)')
+
+
+class Target:
+    def __init__(self, qemu, image, trace_log):
+        cmd = shlex.split(qemu) + ['-serial', 'stdio', '-kernel', image,
+                                   '-trace', 'pl061_update', '-D', trace_log]
+        self.proc = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                                     stderr=subprocess.STDOUT)
+        self.out = ''
+        self.pos = 0
+        self.lock = threading.Lock()
+        threading.Thread(target=self._reader, daemon=True).start()
+
+    def _reader(self):
+        for chunk in iter(lambda: self.proc.stdout.read1(4096), b''):
+            with self.lock:
+                self.out += chunk.decode('ascii', 'replace')
+
+    def expect(self, pattern, timeout=5.0):
+        # match past what earlier expects consumed
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            with self.lock:
+                m = re.compile(pattern).search(self.out, self.pos)
+            if m:
+                self.pos = m.end()
+                return m
+            if self.proc.poll() is not None:
+                break
+            time.sleep(0.02)
+        raise AssertionError('expected %r, got:\n%s' % (pattern, self.out[self.pos:][-2000:]))
+
+    def send(self, line):
+        self.proc.stdin.write((line + '\r').encode('ascii'))
+        self.proc.stdin.flush()
+
+    def command(self, line, pattern, timeout=5.0):
+        self.send(line)
+        m = self.expect(pattern, timeout)
+        self.expect(PROMPT, timeout)
+        return m
+
+    def close(self):
+        self.proc.kill()
+        self.proc.wait()
+
+
+def coil_changes(trace_log):
+    # phase changes per (gpio port, nibble); each step writes the next phase.
+    # Groups that drop back to 0 (the LED on port F) are not coils.
+    last, changes, other = {}, {}, set()
+    with open(trace_log) as f:
+        for line in f:
+            m = TRACE.search(line)
+            if not m:
+                continue
+            port, data = m.group(1), int(m.group(3), 16)
+            for nibble in (0, 1):
+                key = (port, nibble)
+                value = (data >> (4 * nibble)) & 0xf
+                if key in last and last[key] != value:
+                    changes[key] = changes.get(key, 0) + 1
+                    if value not in PHASES:
+                        other.add(key)
+                last[key] = value
+    return dict((k, v) for k, v in changes.items() if k not in other)
+
+
+def scenario_boot(t):
+    t.expect(r'Going multitasking\.', 10)
+    t.expect(PROMPT, 10)
+
+
+def scenario_shell(t):
+    t.command('help', r'Command List:')
+    t.command('est', r'event_status: handlers \d+, dispatched \d+')
+    t.command('nosuchcmd', r'.')
+
+
+def scenario_scheduler(t):
+    # telemetry and logger tasks are scheduled, SysTick drives the delays
+    t.command('tm 50', r'.')
+    time.sleep(0.5)
+    m = t.command('tst', r'frames (\d+)')
+    assert int(m.group(1)) > 0, 'no telemetry frames sent'
+    t.command('tm 0', r'.')
+
+
+def scenario_motion(t, trace_log):
+    # distinct step counts tell the axes apart in the trace
+    steps = {0: 24, 1: 40, 2: 56, 3: 72}
+    for sid, n in steps.items():
+        t.command('sg %d 400 4000 %d' % (sid, n), r'.')
+    for sid, n in steps.items():
+        deadline = time.time() + 10
+        while True:
+            m = t.command('sst %d' % sid, r'step_count (\d+), mailbox \d+, position (-?\d+)')
+            if int(m.group(1)) == 0:
+                break
+            assert time.time() < deadline, 'axis %d did not finish' % sid
+            time.sleep(0.2)
+        assert int(m.group(2)) == n, 'axis %d at position %s, commanded %d' % (sid, m.group(2), n)
+
+    changes = coil_changes(trace_log)
+    counted = sorted(v for v in changes.values() if v)
+    assert counted == sorted(steps.values()), \
+        'coil phase changes %s, commanded %s' % (changes, steps)
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument('--qemu', default='qemu-system-arm -M lm3s6965evb -display none')
+    ap.add_argument('image')
+    args = ap.parse_args()
+
+    fd, trace_log = tempfile.mkstemp(suffix='.log')
+    os.close(fd)
+    t = Target(args.qemu, args.image, trace_log)
+
+    scenarios = [
+        ('boot', lambda: scenario_boot(t)),
+        ('shell', lambda: scenario_shell(t)),
+        ('scheduler', lambda: scenario_scheduler(t)),
+        ('motion', lambda: scenario_motion(t, trace_log)),
+    ]
+
+    failed = 0
+    try:
+        for name, run in scenarios:
+            try:
+                run()
+                print('PASS %s' % name)
+            except AssertionError as e:
+                failed += 1
+                print('FAIL %s: %s' % (name, e))
+                if name == 'boot':
+                    break
+    finally:
+        t.close()
+        os.unlink(trace_log)
+
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+#
+# ram_report.py - SRAM use per subsystem from the GNU ld map file.
+#
+# Usage: ram_report.py gcc/out.map
+#
+# Every input section placed in SRAM (.data, .bss, COMMON, .stack.*) is
+# charged to a subsystem by object file; task stacks are listed one by one
+# under "stacks" by their MEMBUDGET_STACK() name. RAMFUNC code and FASTDATA
+# tables (see ramfunc.h) are charged to their subsystem like any other data
+# and their total is shown separately.
+#
+
+import re
+import sys
+
+SRAM_START = 0x20000000
+SRAM_SIZE = 0x8000
+
+SUBSYSTEMS = [
+    ('motion', ['stepper', 'stepper_task', 'encoder', 'platform', 'timer', 'mathk']),
+    ('shell', ['shell_task']),
+    ('console', ['console', 'numio']),
+    ('host link', ['proto', 'telemetry', 'script']),
+    ('diagnostics', ['logger', 'cpuload', 'membudget']),
+    ('clock', ['clock']),
+    ('ui', ['led_task', 'switch_task', 'buttons']),
+    ('rtos heap', ['heap_2']),
+    ('rtos kernel', ['tasks', 'queue', 'list', 'port']),
+    ('startup + main stack', ['startup_gcc', 'main']),
+]
+
+ENTRY = re.compile(r'^\s*(\.\S+|COMMON)?\s*(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(\S+)\s*$')
+
+
+def subsystem(obj):
+    name = re.sub(r'\.o\)?$', '', obj.split('/')[-1].split('(')[-1])
+    for sub, members in SUBSYSTEMS:
+        if name in members:
+            return sub
+    return 'libraries' if '.a' in obj else 'other (%s)' % name
+
+
+def main():
+    totals = {}
+    stacks = []
+    ramfunc = 0
+    section = None
+
+    for line in open(sys.argv[1]):
+        # long section names put the address on the next line
+        m = re.match(r'^\s(\.\S+|COMMON)\s*$', line)
+        if m:
+            section = m.group(1)
+            continue
+
+        m = ENTRY.match(line)
+        if not m:
+            section = None
+            continue
+
+        name = m.group(1) or section
+        section = None
+        addr, size, obj = int(m.group(2), 16), int(m.group(3), 16), m.group(4)
+
+        if size == 0 or not (SRAM_START <= addr < SRAM_START + SRAM_SIZE) or name is None:
+            continue
+
+        if name.startswith('.stack.'):
+            stacks.append((name[len('.stack.'):], size))
+            totals['stacks'] = totals.get('stacks', 0) + size
+        else:
+            sub = subsystem(obj)
+            totals[sub] = totals.get(sub, 0) + size
+            if name.startswith(('.ramfunc.', '.fastdata.')):
+                ramfunc += size
+
+    used = sum(totals.values())
+    for sub, size in sorted(totals.items(), key=lambda t: -t[1]):
+        print('%-24s %6d' % (sub, size))
+        if sub == 'stacks':
+            for name, ssize in stacks:
+                print('  %-22s %6d' % (name, ssize))
+    print('%-24s %6d' % ('total', used))
+    print('%-24s %6d' % ('  of which ramfunc', ramfunc))
+    print('%-24s %6d' % ('free', SRAM_SIZE - used))
+
+
+if __name__ == '__main__':
+    main()
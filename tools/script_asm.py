@@ -0,0 +1,212 @@
+#!/usr/bin/env python3
+#
+# script_asm.py - Assembler and uploader for motion scripts (see script.h).
+#
+# Usage: script_asm.py source.msc [-o out.bin]
+#        script_asm.py source.msc --port /dev/ttyACM0 --slot N [--run]
+#
+# One instruction per line, '#' starts a comment, "name:" defines a label.
+# N operands are numbers or variables v0..v15; axes are a comma separated
+# list of stepper indices.
+#
+#   go <axis> <sps N> <accel N> <steps N>    stepper_go(), does not wait
+#   platform <v N> <a N> <w N> <d N>         platform_start()
+#   wait <axes>                              until their moves are done
+#   delay <ms N>
+#   stop <axes> [hard]
+#   set|add|mul <var> <N>
+#   loop <var> <label>                       jump while --var > 0
+#   jump <label>
+#   jnz <var> <label>
+#   end
+#
+# Uploading switches the shell into binary mode, stages the code, stores it
+# in the slot and, with --run, starts it. Needs pyserial.
+#
+
+import argparse
+import os
+import struct
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from proto_client import Proto, crc16, MSG_ACK, MSG_EXIT  # noqa: E402
+
+MSG_SCRIPT_DATA, MSG_SCRIPT_STORE, MSG_SCRIPT_RUN = 0x08, 0x09, 0x0a
+
+# name: (opcode, layout) with 'm' mode byte, 'a' axis, 'x' axis mask,
+# 'b' u8, 'v' variable, 'N' number or variable, 'o' jump offset
+OPS = {
+    'end':      (0x00, ''),
+    'go':       (0x01, 'maNNN'),
+    'platform': (0x02, 'mNNNN'),
+    'wait':     (0x03, 'x'),
+    'delay':    (0x04, 'mN'),
+    'stop':     (0x05, 'xb'),
+    'set':      (0x06, 'mvN'),
+    'add':      (0x07, 'mvN'),
+    'mul':      (0x08, 'mvN'),
+    'loop':     (0x09, 'vo'),
+    'jump':     (0x0a, 'o'),
+    'jnz':      (0x0b, 'vo'),
+}
+
+MAX_CODE = 1024 - 8
+CHUNK = 62
+
+
+class AsmError(Exception):
+    pass
+
+
+def variable(tok):
+    if tok[:1] != 'v' or not tok[1:].isdigit() or int(tok[1:]) >= 16:
+        raise AsmError('bad variable %r' % tok)
+    return int(tok[1:])
+
+
+def axis(tok):
+    if not tok.isdigit() or int(tok) >= 4:
+        raise AsmError('bad axis %r' % tok)
+    return int(tok)
+
+
+def axes(tok):
+    mask = 0
+    for a in tok.split(','):
+        mask |= 1 << axis(a)
+    return mask
+
+
+def encode(name, args, labels, pc):
+    op, layout = OPS[name]
+    fields = layout.replace('m', '')
+    if name == 'stop' and len(args) == 1:
+        args = args + ['0']
+    if len(args) != len(fields):
+        raise AsmError('%s takes %d operands' % (name, len(fields)))
+
+    out = bytearray([op])
+    mode, nth, body = 0, 0, bytearray()
+    for kind, tok in zip(fields, args):
+        if kind == 'N':
+            if tok[:1] == 'v':
+                mode |= 1 << nth
+                body.append(variable(tok))
+            else:
+                body += struct.pack('<f', float(tok))
+            nth += 1
+        elif kind == 'a':
+            body.append(axis(tok))
+        elif kind == 'x':
+            body.append(axes(tok))
+        elif kind == 'b':
+            body.append({'hard': 1, '1': 1, '0': 0}[tok])
+        elif kind == 'v':
+            body.append(variable(tok))
+        elif kind == 'o':
+            # relative to the end of this instruction, patched in pass 2
+            body += b'\0\0'
+    if 'm' in layout:
+        out.append(mode)
+    out += body
+
+    if 'o' in fields and labels is not None:
+        target = labels.get(args[-1])
+        if target is None:
+            raise AsmError('unknown label %r' % args[-1])
+        out[-2:] = struct.pack('<h', target - (pc + len(out)))
+    return bytes(out)
+
+
+def assemble(text):
+    lines = []
+    for n, line in enumerate(text.splitlines(), 1):
+        line = line.split('#', 1)[0].strip()
+        while ':' in line:
+            label, line = line.split(':', 1)
+            lines.append((n, label.strip() + ':', []))
+            line = line.strip()
+        if line:
+            tok = line.split()
+            lines.append((n, tok[0].lower(), tok[1:]))
+
+    # pass 1 sizes and labels, pass 2 code
+    labels, code, last = {}, b'', None
+    for pass_labels in (None, labels):
+        code = b''
+        for n, name, args in lines:
+            try:
+                if name.endswith(':'):
+                    labels[name[:-1]] = len(code)
+                elif name in OPS:
+                    code += encode(name, args, pass_labels, len(code))
+                    last = name
+                else:
+                    raise AsmError('unknown instruction %r' % name)
+            except (AsmError, ValueError, KeyError) as e:
+                raise AsmError('line %d: %s' % (n, e))
+
+    # the firmware refuses code that can run off its end
+    if last not in ('end', 'jump'):
+        code += bytes([OPS['end'][0]])
+    if len(code) > MAX_CODE:
+        raise AsmError('%d bytes, a slot holds %d' % (len(code), MAX_CODE))
+    return code
+
+
+def command(p, msg, payload):
+    seq = p.send(msg, payload)
+    end = time.monotonic() + 2.0
+    while time.monotonic() < end:
+        reply = p.recv()
+        if reply and reply[0] == MSG_ACK and reply[1] == seq:
+            if reply[2][1] != 0:
+                raise SystemExit('message 0x%02x failed, result %d' %
+                                 (msg, struct.unpack('<b', reply[2][1:2])[0]))
+            return
+    raise SystemExit('message 0x%02x not acknowledged' % msg)
+
+
+def upload(dev, slot, code, run):
+    import serial
+
+    port = serial.Serial(dev, 115200, timeout=0)
+    port.write(b'bin\r')
+    time.sleep(0.1)
+    port.reset_input_buffer()
+
+    p = Proto(port)
+    for off in range(0, len(code), CHUNK):
+        command(p, MSG_SCRIPT_DATA, struct.pack('<H', off) + code[off:off + CHUNK])
+    command(p, MSG_SCRIPT_STORE, struct.pack('<BHH', slot, len(code), crc16(code)))
+    if run:
+        command(p, MSG_SCRIPT_RUN, struct.pack('<B', slot))
+    p.send(MSG_EXIT)
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument('source')
+    ap.add_argument('-o', '--output')
+    ap.add_argument('--port')
+    ap.add_argument('--slot', type=int, default=0)
+    ap.add_argument('--run', action='store_true')
+    args = ap.parse_args()
+
+    try:
+        code = assemble(open(args.source).read())
+    except AsmError as e:
+        raise SystemExit('%s: %s' % (args.source, e))
+
+    print('%d bytes, crc16 0x%04x' % (len(code), crc16(code)))
+
+    if args.output:
+        open(args.output, 'wb').write(code)
+    if args.port:
+        upload(args.port, args.slot, code, args.run)
+
+
+if __name__ == '__main__':
+    main()
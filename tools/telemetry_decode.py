@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+#
+# telemetry_decode.py - Turn telemetry frames into CSV.
+#
+# Usage: telemetry_decode.py <capture-file|serial-device> [rate-hz]
+#
+# With a serial device the stream is started at rate-hz (default 100) with
+# the shell "tm" command and stopped again on Ctrl-C. Frames are the
+# PROTO_MSG_TELEMETRY layout from telemetry.h; anything else on the line
+# (shell text, other frames) is skipped. Dropped frames show up as gaps in
+# seq and are counted on stderr.
+#
+
+import os
+import stat
+import struct
+import sys
+
+from proto_client import MSG_TELEMETRY, cobs_decode, crc16
+
+STEPPER_MAX = 4
+PAYLOAD = struct.Struct('<II' + 'ffI' * STEPPER_MAX + 'ff')
+
+
+def header():
+    cols = ['seq', 'time_s']
+    for i in range(STEPPER_MAX):
+        cols += ['v%d' % i, 'tv%d' % i, 'steps%d' % i]
+    return ','.join(cols + ['platform_v', 'platform_w'])
+
+
+def frames(chunks):
+    buf = bytearray()
+    for chunk in chunks:
+        buf += chunk
+        while b'\0' in buf:
+            frame, _, buf = buf.partition(b'\0')
+            raw = cobs_decode(bytes(frame)) if frame else None
+            if not raw or len(raw) < 4 or crc16(raw[:-2]) != struct.unpack('<H', raw[-2:])[0]:
+                continue
+            if raw[0] == MSG_TELEMETRY and len(raw) - 4 == PAYLOAD.size:
+                yield PAYLOAD.unpack(raw[2:-2])
+
+
+def main():
+    path = sys.argv[1]
+    port = None
+
+    if stat.S_ISCHR(os.stat(path).st_mode):
+        import serial
+        port = serial.Serial(path, 115200, timeout=0.1)
+        port.write(b'tm %d\r' % (int(sys.argv[2]) if len(sys.argv) > 2 else 100))
+        chunks = iter(lambda: port.read(512), None)
+    else:
+        f = open(path, 'rb')
+        chunks = iter(lambda: f.read(4096), b'')
+
+    print(header())
+    last_seq, t0, t_wrap, t_last, lost = None, None, 0, 0, 0
+    try:
+        for values in frames(chunks):
+            seq, ts = values[0], values[1]
+            if last_seq is not None and seq != (last_seq + 1) & 0xffffffff:
+                lost += (seq - last_seq - 1) & 0xffffffff
+            last_seq = seq
+            # the microsecond timestamp wraps every ~71 minutes
+            if ts < t_last:
+                t_wrap += 1 << 32
+            t_last = ts
+            if t0 is None:
+                t0 = ts
+            t = (ts + t_wrap - t0) / 1e6
+            print(','.join([str(seq), '%.6f' % t] + ['%g' % v for v in values[2:]]))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if port:
+            port.write(b'\0tm 0\r')
+        sys.stderr.write('lost %d frames\n' % lost)
+
+
+if __name__ == '__main__':
+    main()